@@ -0,0 +1,208 @@
+// Receive buffer pool benchmark: runs the real verbs copy path (IbvRxTransport) over the ibverbs mock,
+// once with the default copy-path receive queue and once with the --pool-kb buffer pool.
+// Only built with -DUSE_IBV_MOCK=ON. IBV_MOCK_FILL=1 is set so the mock writes whole frames into the receive
+// buffers like a NIC's DMA; --gbps sets IBV_MOCK_PPS. At an unlimited rate the CQ is always backed up and the pool
+// posts its burst reserve as well.
+// Reports copy throughput and, when perf events are available, PERF_COUNT_HW_CACHE_MISSES per KB received
+// (last-level cache misses as counted by the CPU, not a DRAM traffic measurement).
+// The mock's counters printed at exit include no_wr_drops: packets that found no posted WR (burst tolerance).
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "ibv_utils.h"
+#include "ibv_transport.h"
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 缓存缺失计数（perf_event_open 不可用时返回 -1，只报吞吐）
+static int open_cache_misses()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void print_helper()
+{
+    printf("Demo_pool_bench: verbs copy path over the ibverbs mock, with and without the receive buffer pool\n");
+    printf("    --pkt_size, packet size in bytes copied into the ring (default: 8192)\n");
+    printf("    --send_n, packets per batch, the default receive queue is send_n * 4 WRs (default: 2048)\n");
+    printf("    --pool-kb, buffer pool working set to compare against (default: 2048)\n");
+    printf("    --pool-burst, buffers held back for bursts in pool mode (default: 256)\n");
+    printf("    --block-mb, ring block size the packets are copied into (default: 256)\n");
+    printf("    --seconds, run time per configuration (default: 2)\n");
+    printf("    --gbps, packet rate of the mock in Gbps of pkt_size packets (default: 0 = as fast as WRs are posted)\n");
+}
+
+struct BenchResult
+{
+    double gbps;
+    double misses_per_kb;   // <0：perf 事件不可用
+};
+
+// 与 RoCEv2Dada 的接收端相同地建 QP、内部缓冲（slot 为 pkt_size + PKT_HEAD_LEN）和 flow 规则，投递全部 WR，
+// 然后用 IbvRxTransport::Recv 把包拷进 ring block
+static int run(unsigned int pkt_size, unsigned int send_n, unsigned int work_num, unsigned int pool_wr,
+               char * ring, uint64_t ring_pkts, double seconds, int perf_fd, BenchResult * out)
+{
+    struct ibv_utils_res res;
+    memset(&res, 0, sizeof(res));
+    res.mcast_fd = -1;
+    if (open_ib_device(0, &res) < 0) return -1;
+    res.recv_nsge = 1;
+    res.send_nsge = 1;
+    res.pkt_size = pkt_size;
+    res.poll_n = 16;
+    if (pool_wr && res.poll_n > pool_wr) res.poll_n = pool_wr;
+    int ret = -2;
+    uint32_t buf_size = (pkt_size + PKT_HEAD_LEN) * work_num;
+    if (create_ib_res(&res, 0, (int)work_num) < 0 || init_ib_res(&res) < 0) goto done;
+    res.mem_buf = (unsigned char *)malloc(buf_size);
+    if (!res.mem_buf || register_memory(&res, res.mem_buf, buf_size, pkt_size + PKT_HEAD_LEN) < 0) goto done;
+    if (create_flow(&res, &res.pkt_info) < 0) goto done;
+    for (unsigned int i = 0; i < work_num; i++) {
+        res.recv_wr->wr_id = i;
+        res.recv_wr->sg_list = &res.sge[i * res.recv_nsge];
+        res.recv_wr->num_sge = res.recv_nsge;
+        res.recv_wr->next = NULL;
+        if (ibv_post_recv(res.qp, res.recv_wr, &res.bad_recv_wr)) goto done;
+    }
+    {
+        IbvRxTransport transport(&res, pkt_size, 0, pool_wr);
+        // 预热：第一轮把所有缓冲走一遍，缓冲池模式下接收队列收敛到工作集
+        uint64_t w = 0, warm = (uint64_t)work_num * 2;
+        while (w < warm) {
+            int n = transport.Recv(ring + (w % ring_pkts) * pkt_size, (unsigned int)(ring_pkts - w % ring_pkts < send_n ? ring_pkts - w % ring_pkts : send_n));
+            if (n < 0) goto done;
+            w += (uint64_t)n;
+        }
+        if (perf_fd >= 0) {
+            ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        uint64_t t0 = now_ns(), t = t0, pkts = 0;
+        while (t - t0 < (uint64_t)(seconds * 1e9)) {
+            for (int i = 0; i < 64; i++) {
+                uint64_t pos = w % ring_pkts;
+                int n = transport.Recv(ring + pos * pkt_size, (unsigned int)(ring_pkts - pos < send_n ? ring_pkts - pos : send_n));
+                if (n < 0) goto done;
+                w += (uint64_t)n;
+                pkts += (uint64_t)n;
+            }
+            t = now_ns();
+        }
+        uint64_t misses = 0;
+        if (perf_fd >= 0) {
+            ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(perf_fd, &misses, sizeof(misses)) != sizeof(misses)) misses = 0;
+        }
+        double bytes = (double)pkts * pkt_size;
+        out->gbps = bytes * 8 / ((t - t0) / 1e9) / 1e9;
+        out->misses_per_kb = perf_fd >= 0 && bytes > 0 ? misses / (bytes / 1024) : -1;
+    }
+    ret = 0;
+done:
+    if (ret < 0) fprintf(stderr, "Error: failed to set up or run the receiver (%u WRs)\n", work_num);
+    destroy_ib_res(&res);
+    free(res.mem_buf);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int pkt_size = 8192;
+    unsigned int send_n = 2048;
+    unsigned int pool_kb = 2048;
+    unsigned int pool_burst = 256;
+    uint64_t block_bytes = 256ull << 20;
+    double seconds = 2.0;
+    double gbps = 0;
+    struct option long_options[] = {
+        {.name = "pkt_size", .has_arg = required_argument, .val = 256},
+        {.name = "send_n", .has_arg = required_argument, .val = 257},
+        {.name = "pool-kb", .has_arg = required_argument, .val = 258},
+        {.name = "pool-burst", .has_arg = required_argument, .val = 259},
+        {.name = "block-mb", .has_arg = required_argument, .val = 260},
+        {.name = "seconds", .has_arg = required_argument, .val = 261},
+        {.name = "gbps", .has_arg = required_argument, .val = 262},
+        {.name = "help", .has_arg = no_argument, .val = 'h'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 256: pkt_size = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 257: send_n = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 258: pool_kb = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 259: pool_burst = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 260: block_bytes = strtoull(optarg, NULL, 10) << 20; break;
+            case 261: seconds = atof(optarg); break;
+            case 262: gbps = atof(optarg); break;
+            default: print_helper(); return c == 'h' ? 0 : -1;
+        }
+    }
+    if (pkt_size == 0 || send_n == 0 || pool_kb == 0 || block_bytes < (uint64_t)pkt_size * send_n) { print_helper(); return -1; }
+    // mock 在第一次打开设备时读取环境变量
+    setenv("IBV_MOCK_FILL", "1", 0);
+    if (gbps > 0) {
+        char pps[32];
+        snprintf(pps, sizeof(pps), "%.0f", gbps * 1e9 / 8 / pkt_size);
+        setenv("IBV_MOCK_PPS", pps, 1);
+    }
+
+    // 与 RoCEv2Dada 相同的队列深度：默认拷贝路径 send_n * 4（最多 8192），缓冲池为工作集 + 突发储备
+    unsigned int slot = pkt_size + PKT_HEAD_LEN;
+    unsigned int def_num = send_n < 2048 ? send_n * 4 : 8192;
+    unsigned int pool = (unsigned int)((uint64_t)pool_kb * 1024 / slot);
+    if (pool == 0) pool = 1;
+    if (pool > 4096) pool = 4096;
+    if (pool + pool_burst > 8192) pool_burst = 8192 - pool;
+
+    uint64_t ring_pkts = block_bytes / pkt_size;
+    char *ring = (char *)aligned_alloc(4096, (ring_pkts * pkt_size + 4095) / 4096 * 4096);
+    if (!ring) { fprintf(stderr, "Error: failed to allocate %lu MB ring block\n", (unsigned long)(block_bytes >> 20)); return -1; }
+    memset(ring, 0, ring_pkts * pkt_size);
+    int perf_fd = open_cache_misses();
+    if (perf_fd < 0) printf("[Bench] perf events unavailable, reporting throughput only\n");
+
+    BenchResult base, pooled;
+    if (run(pkt_size, send_n, def_num, 0, ring, ring_pkts, seconds, perf_fd, &base) < 0) return -1;
+    if (run(pkt_size, send_n, pool + pool_burst, pool, ring, ring_pkts, seconds, perf_fd, &pooled) < 0) return -1;
+
+    printf("[Bench] pkt_size=%u, slot=%u bytes, send_n=%u, ring block=%lu MB, %.1f s per run\n",
+           pkt_size, slot, send_n, (unsigned long)(block_bytes >> 20), seconds);
+    printf("%-16s %8s %8s %12s %12s %16s\n", "receiver", "posted", "reserve", "working set", "Gbps", "cache miss/KB");
+    const char *names[2] = {"default queue", "--pool-kb"};
+    unsigned int posted[2] = {def_num, pool};
+    unsigned int reserve[2] = {0, pool_burst};
+    BenchResult *r[2] = {&base, &pooled};
+    for (int i = 0; i < 2; i++) {
+        char miss[32];
+        if (r[i]->misses_per_kb >= 0) snprintf(miss, sizeof(miss), "%.2f", r[i]->misses_per_kb);
+        else snprintf(miss, sizeof(miss), "-");
+        printf("%-16s %8u %8u %9.1f MB %12.2f %16s\n", names[i], posted[i], reserve[i], (double)posted[i] * slot / 1048576.0,
+               r[i]->gbps, miss);
+    }
+    if (perf_fd >= 0) close(perf_fd);
+    free(ring);
+    return 0;
+}
@@ -14,6 +14,10 @@
 #include "RoCEv2Dada.h"
 #include "psrdada_ringbuf.h"
 #include "ibv_utils.h"
+#include "ibv_rc.h"
+#include "rx_stream.h"
+#include "rx_numa.h"
+#include "dada_header.h"
 
 #define PSRDADA_BUFFER_KEY 0xdada
 #define PKT_DATA_SIZE 8192
@@ -26,6 +30,18 @@ static uint32_t g_send_n = 64;
 static uint64_t g_current_block_remaining_writes = 0;  // 当前block剩余可写入次数
 static uint64_t g_bytes_per_write = 0;  // 每次写入的字节数
 static uint64_t g_block_size = 0;  // 完整block的大小（固定值）
+static unsigned int g_nstreams = 1;  // 接收的流数，第 i 路使用 dport + i 和 key + i
+static PsrdadaRingBuf *g_stream_rings[RX_MAX_STREAMS];  // 第 1..n-1 路的 ring
+static bool g_split_header = false;  // 包头与载荷分开，ring 中只有载荷
+static uint64_t g_hdr_next_seq = UINT64_MAX;  // 下一个期望的包序号
+static uint64_t g_hdr_missing = 0;  // 按包头序号统计的缺包数
+static uint64_t g_lost_slots = 0;  // 丢失位图中累计的丢包槽位
+static uint64_t g_lossy_blocks = 0;  // 有丢包的 block 数
+static bool g_stream_fill = false;  // 批次跨 block 边界，block 不必是批次的整数倍
+static bool g_callback_loop = false;  // 拷贝路径保留每批调用回调的通用循环
+static bool g_compact = false;  // 变长帧首尾相接写入 block
+static uint64_t g_compact_frames = 0;  // 已提交 block 中的帧数
+static uint64_t g_compact_bytes = 0;   // 已提交 block 中的帧字节数
 
 void signal_handler(int sig) {
     printf("\nReceived signal %d, exiting gracefully...\n", sig);
@@ -68,7 +84,7 @@ char* GetBuffPtr(long int& buf_size) {
             printf(" (exact fit)\n");
         }
         fflush(stdout);
-    } else if (remainder > 0) {
+    } else if (remainder > 0 && !g_stream_fill) {
         fprintf(stderr, "[WARN] Block size not exact multiple, %lu bytes wasted per block\n", remainder);
     }
     
@@ -121,6 +137,44 @@ bool IsBlockFull() {
     return g_current_block_remaining_writes == 0;
 }
 
+// DirectToRing 流水线：查看当前 block 之后第 ahead 个 block，读端尚未清空时返回 NULL
+char* PeekBuffPtr(unsigned int ahead, long int& buf_size) {
+    char *ptr = g_ringbuf ? g_ringbuf->PeekWriteBuffer(ahead) : NULL;
+    buf_size = ptr ? (long int)g_block_size : 0;
+    return ptr;
+}
+
+// DirectToRing 分块注册：当前 block 之后第 ahead 个 block 的 MR，整块注册时返回 NULL
+struct ibv_mr* GetBlockMrPtr(unsigned int ahead) {
+    return g_ringbuf ? g_ringbuf->GetBlockMr(ahead) : NULL;
+}
+
+// split_header：block 提交前收到其包头数组，载荷已不带包头，只能在这里按序号统计缺包
+int HeaderSendBuffPtr(const char *hdr, uint64_t npkts) {
+    for (uint64_t i = 0; i < npkts; i++) {
+        uint64_t seq = pkt_seq_get(hdr + i * PKT_HEAD_LEN);
+        if (g_hdr_next_seq != UINT64_MAX && seq > g_hdr_next_seq) g_hdr_missing += seq - g_hdr_next_seq;
+        if (g_hdr_next_seq == UINT64_MAX || seq >= g_hdr_next_seq) g_hdr_next_seq = seq + 1;
+    }
+    return 0;
+}
+
+// seq_place/多源拼帧：block 提交前收到其丢失位图，丢失的槽位已经清零
+int LossSendPtr(const uint64_t *loss, uint64_t nslots) {
+    uint64_t lost = 0;
+    for (uint64_t w = 0; w < (nslots + 63) / 64; w++) lost += __builtin_popcountll(loss[w]);
+    g_lost_slots += lost;
+    if (lost > 0) g_lossy_blocks++;
+    return 0;
+}
+
+// compact：block 提交前收到其帧索引，统计帧长和 block 利用率
+int FrameIndexSendPtr(const RoCEv2Dada::FrameIndex *index, uint64_t nframes) {
+    g_compact_frames += nframes;
+    if (nframes > 0) g_compact_bytes += index[nframes - 1].offset + index[nframes - 1].len;
+    return 0;
+}
+
 int SendBuffPtr(void) {
     if (!g_ringbuf) {
         fprintf(stderr, "[ERROR] g_ringbuf is NULL!\n");
@@ -155,10 +209,48 @@ int SendBuffPtr(void) {
         double fill_percent = total > 0 ? (double)used * 100.0 / total : 0.0;
         printf("[Progress] Blocks written: %lu | Ring buffer: %.1f%% full (%lu/%lu MB)\n", 
                total_blocks, fill_percent, used / 1024 / 1024, total / 1024 / 1024);
+        if (g_split_header) printf("[Progress] Missing packets by header sequence: %lu\n", g_hdr_missing);
+        if (g_lost_slots > 0) printf("[Progress] Lost slots (zero-filled): %lu in %lu blocks\n", g_lost_slots, g_lossy_blocks);
+        if (g_compact && g_compact_frames > 0) {
+            printf("[Progress] Compacted frames: %lu, mean %.0f bytes, block fill %.1f%%\n", g_compact_frames,
+                   (double)g_compact_bytes / g_compact_frames, (double)g_compact_bytes * 100.0 / (total_blocks * g_block_size));
+        }
     }
     return 0;
 }
 
+// 第 1..n-1 路流的 ring 回调：block 整块写满后提交，不使用第 0 路的 block 计数全局变量
+static char* StreamGetBuffPtr(PsrdadaRingBuf *ring, long int &buf_size) {
+    uint64_t bytes = ring->GetBlockSize();
+    char *ptr = ring->GetWriteBuffer(bytes);
+    buf_size = ptr ? (long int)bytes : 0;
+    return ptr;
+}
+
+// ring 满时返回 NULL，多流接收线程跳过这一路，不在 GetWriteBuffer 中阻塞
+static char* StreamPeekBuffPtr(PsrdadaRingBuf *ring, unsigned int ahead, long int &buf_size) {
+    char *ptr = ring->PeekWriteBuffer(ahead);
+    buf_size = ptr ? (long int)ring->GetBlockSize() : 0;
+    return ptr;
+}
+
+static int StreamSendBuffPtr(PsrdadaRingBuf *ring) {
+    if (ring->MarkWritten(ring->GetBlockSize()) < 0) {
+        fprintf(stderr, "[ERROR] MarkWritten() failed!\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void close_stream_rings() {
+    for (unsigned int i = 1; i < g_nstreams; i++) {
+        if (!g_stream_rings[i]) continue;
+        g_stream_rings[i]->SendEODAndDisconnect();
+        delete g_stream_rings[i];
+        g_stream_rings[i] = NULL;
+    }
+}
+
 void print_helper() {
     printf("Usage:\n");
     printf("    ./Demo_psrdada_online [options]\n");
@@ -173,6 +265,40 @@ void print_helper() {
     printf("    --pkt_size, packet size including header (default: %d)\n", PKT_DATA_SIZE);
     printf("    --send_n, batch size (default: 64)\n");
     printf("    --nsge, scatter/gather entries per work request (default: 4)\n");
+    printf("    --poll-n, completions taken per ibv_poll_cq call, capped at the receive queue depth (default: 8)\n");
+    printf("    --pool-kb, verbs copy path: keep only this many KB of buffers posted so DMA writes stay in the LLC (DDIO), copy packets out as they complete (default: 0 = off)\n");
+    printf("    --pool-burst, with --pool-kb: extra receive buffers held back and posted only while the CQ backs up (default: 256)\n");
+    printf("    --idle-us, verbs: busy-poll while traffic flows, sleep on the CQ completion channel after this many idle microseconds (default: 0 = always spin)\n");
+    printf("    --numa-node, NUMA node for the receive thread, internal buffers and ring: N | auto (the NIC's node from sysfs) | off (default: auto)\n");
+    printf("    --rt-prio, run the receive thread SCHED_FIFO at this priority, needs -c and CAP_SYS_NICE or an rtprio limit (default: 0 = normal scheduling)\n");
+    printf("    --mlock, mlockall the process before receiving starts so the receive path never page-faults\n");
+    printf("    --callback-loop, verbs copy path: keep the per-batch callback loop instead of the loop specialised for pkt_size/send_n\n");
+    printf("    --transport, receive backend: verbs | udp | xdp | dpdk | pcap | rc (default: verbs)\n");
+    printf("    --gro, enable UDP_GRO for the udp transport\n");
+    printf("    --ifname, network interface for the xdp transport\n");
+    printf("    --queue, RX queue for the xdp transport (default: 0)\n");
+    printf("    --xdp-skb, run the xdp transport in generic/SKB mode (veth, no driver support)\n");
+    printf("    --dpdk-eal, EAL arguments for the dpdk transport, e.g. \"-l 0-2 --vdev=net_pcap0,rx_pcap=in.pcap\"\n");
+    printf("    --dpdk-port, DPDK port id (default: 0)\n");
+    printf("    --dpdk-queues, DPDK RX queues, one worker lcore each (default: 1)\n");
+    printf("    --pcap, pcap/pcapng capture to replay with the pcap transport\n");
+    printf("    --replay, replay speed: original | max | <Gbps> (default: max)\n");
+    printf("    --loop, restart the capture when it ends\n");
+    printf("    --rc-port, TCP port the rc transport waits on for Demo_rc_sender (default: %d)\n", RC_DEFAULT_PORT);
+    printf("    --gid-index, GID index for the rc transport on RoCE (default: 0)\n");
+    printf("    --mcast-if, local interface IP for joining when --dip is a multicast group (default: by route)\n");
+    printf("    --nqp, receive shards (verbs QPs / udp sockets), shard i takes --sport + i, one thread per shard from -c (default: 1)\n");
+    printf("    --devices, aggregate several RDMA devices into one ring, e.g. \"0,1\"; packets are ordered and de-duplicated by sequence number\n");
+    printf("    --sources, assemble several boards into fixed block regions, e.g. \"10.0.0.11:60000,10.0.0.12:60000\"; source i fills region i, ordered by sequence number\n");
+    printf("    --source-id, select the region by a 16-bit big-endian board/antenna id in the packet header instead: \"offset,count\", e.g. \"50,16\"\n");
+    printf("    --direct-depth, DirectToRing: ring blocks with receive WRs posted ahead of time, 1..3 (default: 2)\n");
+    printf("    --split-header, DirectToRing: scatter the %d-byte packet header aside so blocks hold payload only (needs --nsge >= 2)\n", PKT_HEAD_LEN);
+    printf("    --seq-place, verbs copy path: place each packet by its header sequence number, zero-fill lost slots\n");
+    printf("    --stream-fill, fill blocks as a continuous byte stream: a batch that does not fit continues at the head of the next block\n");
+    printf("    --ants, keep only antennas \"first:count\" of each packet (geometry from --dump-header); DirectToRing drops the rest at DMA time when --nsge allows\n");
+    printf("    --chans, keep only samples/channels \"first:count\" of each antenna, combined with --ants (default: all)\n");
+    printf("    --compact, verbs copy path: pack variable-length frames (up to --pkt_size bytes) back-to-back by received length\n");
+    printf("    --streams, receive N flows in one process (verbs, udp): stream i listens on --dport + i and writes ring --key + i (default: 1)\n");
     printf("    --key, psrdada buffer key in hex (default: 0x%x)\n", PSRDADA_BUFFER_KEY);
     printf("    --gpu, GPU device ID (default: 0)\n");
     printf("    --cpu, CPU ID for thread affinity (default: -1)\n");
@@ -184,6 +310,54 @@ void print_helper() {
     printf("    --file-bytes, output file size in bytes (for reference, not used internally)\n");
 }
 
+// 按头文件模板的包几何设置子集抽取，并写出描述抽取后数据的头文件（NANT、PKT_NSAMP、PKT_DATA、BYTES_PER_SECOND）
+static int setup_subset(RoCEv2Dada::RdmaParam &param, char *header_path, size_t header_path_len) {
+    dada_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if (read_dada_header_from_file(header_path, &hdr) < 0 || hdr.nant <= 0 || hdr.pkt_nsamp <= 0
+        || hdr.pkt_npol <= 0 || hdr.pkt_nbit <= 0) {
+        fprintf(stderr, "Error: --ants/--chans need NANT, PKT_NSAMP, PKT_NPOL and PKT_NBIT in %s\n", header_path);
+        return -1;
+    }
+    param.nant = (unsigned int)hdr.nant;
+    param.pkt_nsamp = (unsigned int)hdr.pkt_nsamp;
+    param.sample_bytes = (unsigned int)(hdr.pkt_npol * hdr.pkt_nbit);
+    if (param.ant_count == 0) { param.ant_first = 0; param.ant_count = param.nant; }
+    if (param.chan_count == 0) { param.chan_first = 0; param.chan_count = param.pkt_nsamp; }
+    if (param.ant_first + param.ant_count > param.nant || param.chan_first + param.chan_count > param.pkt_nsamp) {
+        fprintf(stderr, "Error: --ants %u:%u / --chans %u:%u outside the %u antennas x %u channels of %s\n",
+                param.ant_first, param.ant_count, param.chan_first, param.chan_count, param.nant, param.pkt_nsamp, header_path);
+        return -1;
+    }
+    uint32_t in_data = (uint32_t)(param.nant * param.pkt_nsamp * param.sample_bytes);
+    uint32_t out_data = param.ant_count * param.chan_count * param.sample_bytes;
+    hdr.bytes_per_second = (int)((double)hdr.bytes_per_second * (PKT_HEAD_LEN + out_data) / (PKT_HEAD_LEN + in_data));
+    hdr.nant = (int)param.ant_count;
+    hdr.pkt_nsamp = (int)param.chan_count;
+    hdr.pkt_data = (int)out_data;
+    char out_path[256];
+    snprintf(out_path, sizeof(out_path), "/tmp/rdma_dada_subset_%d.header", (int)getpid());
+    if (write_dada_header_to_file(hdr, out_path) != 0) {
+        fprintf(stderr, "Error: failed to write subset header %s\n", out_path);
+        return -1;
+    }
+    printf("[Main] Subset header written to %s\n", out_path);
+    strncpy(header_path, out_path, header_path_len - 1);
+    header_path[header_path_len - 1] = '\0';
+    return 0;
+}
+
+static const char *transport_name(int transport) {
+    switch (transport) {
+        case RX_TRANSPORT_UDP: return "udp";
+        case RX_TRANSPORT_XDP: return "xdp";
+        case RX_TRANSPORT_DPDK: return "dpdk";
+        case RX_TRANSPORT_PCAP: return "pcap";
+        case RX_TRANSPORT_RC: return "rc";
+        default: return "verbs";
+    }
+}
+
 static int parse_args(RoCEv2Dada::RdmaParam &param, key_t &psrdada_key,
                       uint64_t &nbufs, uint64_t &file_bytes,
                       char *dump_dir, size_t dump_dir_len,
@@ -206,6 +380,40 @@ static int parse_args(RoCEv2Dada::RdmaParam &param, key_t &psrdada_key,
         {.name = "file-bytes", .has_arg = required_argument, .val = 270},
         {.name = "debug", .has_arg = no_argument, .val = 271},
         {.name = "nsge", .has_arg = required_argument, .val = 272},
+        {.name = "transport", .has_arg = required_argument, .val = 273},
+        {.name = "gro", .has_arg = no_argument, .val = 274},
+        {.name = "ifname", .has_arg = required_argument, .val = 275},
+        {.name = "queue", .has_arg = required_argument, .val = 276},
+        {.name = "xdp-skb", .has_arg = no_argument, .val = 277},
+        {.name = "dpdk-eal", .has_arg = required_argument, .val = 278},
+        {.name = "dpdk-port", .has_arg = required_argument, .val = 279},
+        {.name = "dpdk-queues", .has_arg = required_argument, .val = 280},
+        {.name = "pcap", .has_arg = required_argument, .val = 281},
+        {.name = "replay", .has_arg = required_argument, .val = 282},
+        {.name = "loop", .has_arg = no_argument, .val = 283},
+        {.name = "rc-port", .has_arg = required_argument, .val = 284},
+        {.name = "gid-index", .has_arg = required_argument, .val = 285},
+        {.name = "mcast-if", .has_arg = required_argument, .val = 286},
+        {.name = "nqp", .has_arg = required_argument, .val = 287},
+        {.name = "devices", .has_arg = required_argument, .val = 288},
+        {.name = "streams", .has_arg = required_argument, .val = 289},
+        {.name = "sources", .has_arg = required_argument, .val = 290},
+        {.name = "source-id", .has_arg = required_argument, .val = 291},
+        {.name = "direct-depth", .has_arg = required_argument, .val = 292},
+        {.name = "split-header", .has_arg = no_argument, .val = 293},
+        {.name = "compact", .has_arg = no_argument, .val = 294},
+        {.name = "stream-fill", .has_arg = no_argument, .val = 295},
+        {.name = "seq-place", .has_arg = no_argument, .val = 296},
+        {.name = "ants", .has_arg = required_argument, .val = 297},
+        {.name = "chans", .has_arg = required_argument, .val = 298},
+        {.name = "poll-n", .has_arg = required_argument, .val = 299},
+        {.name = "idle-us", .has_arg = required_argument, .val = 300},
+        {.name = "pool-kb", .has_arg = required_argument, .val = 301},
+        {.name = "pool-burst", .has_arg = required_argument, .val = 302},
+        {.name = "numa-node", .has_arg = required_argument, .val = 303},
+        {.name = "rt-prio", .has_arg = required_argument, .val = 304},
+        {.name = "mlock", .has_arg = no_argument, .val = 305},
+        {.name = "callback-loop", .has_arg = no_argument, .val = 306},
         {.name = "gpu", .has_arg = required_argument, .val = 'g'},
         {.name = "cpu", .has_arg = required_argument, .val = 'c'},
         {.name = "device", .has_arg = required_argument, .val = 'd'},
@@ -220,8 +428,51 @@ static int parse_args(RoCEv2Dada::RdmaParam &param, key_t &psrdada_key,
     param.RdmaDirectGpu = 0;
     param.send_n = 64;
     param.DirectToRing = 0;  // Will be enabled by SetDirectMr() if single MR is available
+    param.direct_depth = 2;
+    param.split_header = false;
+    param.compact = false;
+    param.stream_fill = false;
+    param.seq_place = false;
+    param.nant = 0;
+    param.pkt_nsamp = 0;
+    param.sample_bytes = 0;
+    param.ant_first = 0;
+    param.ant_count = 0;
+    param.chan_first = 0;
+    param.chan_count = 0;
     param.DirectMr = NULL;
+    param.Ring = NULL;
     param.nsge = 4;
+    param.poll_n = 8;
+    param.idle_us = 0;
+    param.pool_kb = 0;
+    param.pool_burst = 0;
+    param.numa_node = RX_NUMA_AUTO;
+    param.rt_priority = 0;
+    param.mlock_all = false;
+    param.transport = RX_TRANSPORT_VERBS;
+    param.udp_gro = false;
+    param.IfName[0] = '\0';
+    param.rx_queue = 0;
+    param.xdp_skb_mode = false;
+    param.DpdkEal[0] = '\0';
+    param.dpdk_port = 0;
+    param.dpdk_queues = 1;
+    param.PcapFile[0] = '\0';
+    param.replay_mode = PCAP_REPLAY_MAX;
+    param.replay_gbps = 0.0;
+    param.replay_loop = false;
+    param.rc_port = RC_DEFAULT_PORT;
+    param.gid_index = 0;
+    param.RingBlockBytes = 0;
+    param.McastIf[0] = '\0';
+    param.nshards = 1;
+    param.Devices[0] = '\0';
+    param.Sources[0] = '\0';
+    param.source_id_offset = 0;
+    param.nsources = 0;
+    param.RingBase = NULL;
+    param.RingBytes = 0;
     psrdada_key = PSRDADA_BUFFER_KEY;
     nbufs = 8;
     while (1) {
@@ -243,6 +494,74 @@ static int parse_args(RoCEv2Dada::RdmaParam &param, key_t &psrdada_key,
             case 270: file_bytes = strtoull(optarg, NULL, 10); break;
             case 271: g_debug_mode = true; break;
             case 272: param.nsge = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 299: param.poll_n = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 300: param.idle_us = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 301: param.pool_kb = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 302: param.pool_burst = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 303:
+                if (strcmp(optarg, "auto") == 0) param.numa_node = RX_NUMA_AUTO;
+                else if (strcmp(optarg, "off") == 0) param.numa_node = RX_NUMA_OFF;
+                else param.numa_node = atoi(optarg);
+                break;
+            case 304: param.rt_priority = atoi(optarg); break;
+            case 305: param.mlock_all = true; break;
+            case 306: g_callback_loop = true; break;
+            case 273:
+                if (strcmp(optarg, "verbs") == 0) param.transport = RX_TRANSPORT_VERBS;
+                else if (strcmp(optarg, "udp") == 0) param.transport = RX_TRANSPORT_UDP;
+                else if (strcmp(optarg, "xdp") == 0) param.transport = RX_TRANSPORT_XDP;
+                else if (strcmp(optarg, "dpdk") == 0) param.transport = RX_TRANSPORT_DPDK;
+                else if (strcmp(optarg, "pcap") == 0) param.transport = RX_TRANSPORT_PCAP;
+                else if (strcmp(optarg, "rc") == 0) param.transport = RX_TRANSPORT_RC;
+                else { fprintf(stderr, "Error: unknown transport '%s'\n", optarg); print_helper(); return -1; }
+                break;
+            case 274: param.udp_gro = true; break;
+            case 275: strncpy(param.IfName, optarg, sizeof(param.IfName) - 1); param.IfName[sizeof(param.IfName) - 1] = '\0'; break;
+            case 276: param.rx_queue = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 277: param.xdp_skb_mode = true; break;
+            case 278: strncpy(param.DpdkEal, optarg, sizeof(param.DpdkEal) - 1); param.DpdkEal[sizeof(param.DpdkEal) - 1] = '\0'; break;
+            case 279: param.dpdk_port = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 280: param.dpdk_queues = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 281: strncpy(param.PcapFile, optarg, sizeof(param.PcapFile) - 1); param.PcapFile[sizeof(param.PcapFile) - 1] = '\0'; break;
+            case 282:
+                if (strcmp(optarg, "original") == 0) param.replay_mode = PCAP_REPLAY_ORIGINAL;
+                else if (strcmp(optarg, "max") == 0) param.replay_mode = PCAP_REPLAY_MAX;
+                else {
+                    param.replay_mode = PCAP_REPLAY_RATE;
+                    param.replay_gbps = atof(optarg);
+                    if (param.replay_gbps <= 0.0) { fprintf(stderr, "Error: invalid replay rate '%s'\n", optarg); return -1; }
+                }
+                break;
+            case 283: param.replay_loop = true; break;
+            case 284: param.rc_port = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 285: param.gid_index = atoi(optarg); break;
+            case 286: strncpy(param.McastIf, optarg, sizeof(param.McastIf) - 1); param.McastIf[sizeof(param.McastIf) - 1] = '\0'; break;
+            case 287: param.nshards = (unsigned int)atoi(optarg); break;
+            case 288: strncpy(param.Devices, optarg, sizeof(param.Devices) - 1); param.Devices[sizeof(param.Devices) - 1] = '\0'; break;
+            case 289: g_nstreams = (unsigned int)atoi(optarg); break;
+            case 290: strncpy(param.Sources, optarg, sizeof(param.Sources) - 1); param.Sources[sizeof(param.Sources) - 1] = '\0'; break;
+            case 291:
+                if (sscanf(optarg, "%u,%u", &param.source_id_offset, &param.nsources) != 2) {
+                    fprintf(stderr, "Error: --source-id expects \"offset,count\"\n");
+                    return -1;
+                }
+                break;
+            case 292: param.direct_depth = (unsigned int)atoi(optarg); break;
+            case 293: param.split_header = true; break;
+            case 294: param.compact = true; break;
+            case 295: param.stream_fill = true; break;
+            case 296: param.seq_place = true; break;
+            case 297:
+            case 298: {
+                unsigned int first = 0, count = 0;
+                if (sscanf(optarg, "%u:%u", &first, &count) != 2 || count == 0) {
+                    fprintf(stderr, "Error: --%s expects \"first:count\"\n", c == 297 ? "ants" : "chans");
+                    return -1;
+                }
+                if (c == 297) { param.ant_first = first; param.ant_count = count; }
+                else { param.chan_first = first; param.chan_count = count; }
+                break;
+            }
             case 'g': param.gpu_id = atoi(optarg); break;
             case 'c': param.bind_cpu_id = atoi(optarg); break;
             case 'h': print_helper(); return -1;
@@ -270,6 +589,7 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "[WARN] Invalid --nsge value 0, falling back to 4\n");
         param.nsge = 4;
     }
+    if ((param.ant_count > 0 || param.chan_count > 0) && setup_subset(param, header_path, sizeof(header_path)) < 0) return -1;
     g_pkt_size = param.pkt_size;
     g_send_n = param.send_n;
 
@@ -280,6 +600,21 @@ int main(int argc, char *argv[]) {
         print_helper();
         return -1;
     }
+    if (param.transport == RX_TRANSPORT_PCAP && strlen(param.PcapFile) == 0) {
+        fprintf(stderr, "Error: --pcap is required for the pcap transport\n");
+        print_helper();
+        return -1;
+    }
+    if (param.transport == RX_TRANSPORT_XDP && strlen(param.IfName) == 0) {
+        fprintf(stderr, "Error: --ifname is required for the xdp transport\n");
+        print_helper();
+        return -1;
+    }
+    if (g_nstreams == 0 || g_nstreams > RX_MAX_STREAMS ||
+        (g_nstreams > 1 && param.transport != RX_TRANSPORT_VERBS && param.transport != RX_TRANSPORT_UDP)) {
+        fprintf(stderr, "Error: --streams must be 1..%d and needs the verbs or udp transport\n", RX_MAX_STREAMS);
+        return -1;
+    }
     g_ringbuf = new PsrdadaRingBuf();
     if (!g_ringbuf) { fprintf(stderr, "Error: Failed to create PsrdadaRingBuf\n"); return -1; }
     
@@ -289,6 +624,15 @@ int main(int argc, char *argv[]) {
     
     // pkt_size 已经包含包头（从 run_demo.sh 传入的是 PKT_HEADER+PKT_DATA）
     uint64_t receive_bytes_per_time = (uint64_t)(param.pkt_size) * param.send_n;
+    if (param.nant > 0) {
+        // 子集抽取：每个包在 ring 中只占保留的字节
+        g_pkt_size = PKT_HEAD_LEN + param.ant_count * param.chan_count * param.sample_bytes;
+        receive_bytes_per_time = (uint64_t)g_pkt_size * param.send_n;
+        printf("  Subset: antennas %u+%u of %u, channels %u+%u of %u, %u of %u bytes kept per packet\n",
+               param.ant_first, param.ant_count, param.nant, param.chan_first, param.chan_count, param.pkt_nsamp,
+               g_pkt_size, param.pkt_size);
+        printf("  Ring block size (dada_db -b) should be a multiple of %lu bytes\n", (unsigned long)receive_bytes_per_time);
+    }
     printf("  Receive size per batch: %lu bytes (%.2f MB)\n", 
            receive_bytes_per_time, receive_bytes_per_time / 1024.0 / 1024.0);
     fflush(stdout);
@@ -304,6 +648,16 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "[Main] ✓ psrdada ring buffer initialized\n"); 
     }
     
+    for (unsigned int i = 1; i < g_nstreams; i++) {
+        printf("[Main] Connecting to PSRDADA ring buffer for stream %u (key=0x%x)...\n", i, psrdada_key + i);
+        g_stream_rings[i] = new PsrdadaRingBuf();
+        if (g_stream_rings[i]->Init(psrdada_key + i, receive_bytes_per_time, nbufs, header_path, file_bytes) < 0) {
+            fprintf(stderr, "Error: Failed to initialize psrdada ring buffer 0x%x\n", psrdada_key + i);
+            delete g_stream_rings[i]; g_stream_rings[i] = NULL;
+            close_stream_rings(); delete g_ringbuf; return -1;
+        }
+    }
+    
     // 获取实际PSRDADA block大小（由dada_db创建时决定）
     uint64_t actual_block_size = g_ringbuf->GetBlockSize();
     printf("[Main] PSRDADA block size: %lu bytes (%lu MB)\n", 
@@ -313,16 +667,52 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Warning: Actual block size (%lu) does not mattch with receive size (%lu)\n", 
                 actual_block_size, receive_bytes_per_time);
     }
+    if (param.transport == RX_TRANSPORT_XDP) {
+        // AF_XDP 的 UMEM 直接使用连续的 ring，帧直接写入 block
+        param.RingBase = g_ringbuf->GetContiguousRing(&param.RingBytes);
+        if (param.RingBase) {
+            printf("[Main] XDP UMEM: PSRDADA ring at %p (%lu MB)\n", (void*)param.RingBase, param.RingBytes / 1024 / 1024);
+        } else {
+            printf("[Main] Ring not contiguous, XDP will copy from an internal UMEM\n");
+        }
+    }
+    param.RingBlockBytes = actual_block_size;
     param.DataSendBuff = &SendBuffPtr;
     param.GetBuffPtr = &GetBuffPtr;
     param.DecrementWriteCount = &DecrementWriteCount;
     param.IsBlockFull = &IsBlockFull;
+    param.PeekBuffPtr = &PeekBuffPtr;
+    param.GetBlockMrPtr = &GetBlockMrPtr;
+    param.HeaderSendBuff = &HeaderSendBuffPtr;
+    param.FrameIndexSend = &FrameIndexSendPtr;
+    param.LossSend = &LossSendPtr;
+    // 拷贝路径直接写第 0 路 ring，block 记账由库内的 PsrdadaSink 完成，上面的 block 回调只在通用循环中使用
+    if (!g_callback_loop) param.Ring = g_ringbuf;
+    g_compact = param.compact;
+    g_stream_fill = param.stream_fill;
     printf("[Main] Creating RDMA receiver...\n");
-    printf("  Device: %d\n", param.device_id);
+    if (strlen(param.Devices) > 0) printf("  Devices: %s\n", param.Devices);
+    if (strlen(param.Sources) > 0) printf("  Sources: %s\n", param.Sources);
+    if (param.source_id_offset > 0) printf("  Source id: 16-bit at header offset %u, %u sources\n", param.source_id_offset, param.nsources);
+    else printf("  Device: %d\n", param.device_id);
     printf("  GPU: %d\n", param.gpu_id);
     printf("  Packet Size: %d\n", param.pkt_size);
     printf("  Batch Size: %d\n", param.send_n);
     printf("  NSGE: %u\n", param.nsge);
+    printf("  Poll batch: %u completions\n", param.poll_n);
+    if (param.idle_us > 0) printf("  Idle sleep: after %u us without completions, wait on the completion channel\n", param.idle_us);
+    if (param.numa_node >= 0) printf("  NUMA node: %d\n", param.numa_node);
+    else printf("  NUMA node: %s\n", param.numa_node == RX_NUMA_AUTO ? "auto (NIC's node)" : "off");
+    if (param.rt_priority > 0) printf("  Receive thread: SCHED_FIFO priority %d\n", param.rt_priority);
+    if (param.mlock_all) printf("  Memory: mlockall before start\n");
+    if (param.pool_kb > 0) printf("  Buffer pool: %u KB of posted receive buffers, %u more held back for bursts\n", param.pool_kb, param.pool_burst ? param.pool_burst : 256);
+    if (param.seq_place) printf("  Sequence placement: slot = seq %% (block / %u), lost slots zero-filled\n", param.pkt_size);
+    if (param.stream_fill) printf("  Stream fill: batches of %lu bytes straddle block boundaries\n", (unsigned long)param.pkt_size * param.send_n);
+    if (param.compact) printf("  Compact: frames of %d..%u bytes packed back-to-back\n", PKT_HEAD_LEN, param.pkt_size);
+    if (g_nstreams > 1) printf("  Streams: %u (dport %s + 0..%u, key 0x%x + 0..%u)\n", g_nstreams, param.dst_port, g_nstreams - 1, psrdada_key, g_nstreams - 1);
+    printf("  Transport: %s%s\n", transport_name(param.transport),
+           (param.transport == RX_TRANSPORT_UDP && param.udp_gro) ? " (GRO)" : "");
+    if (param.nshards > 1) printf("  Shards: %u (source ports %s + 0..%u)\n", param.nshards, param.src_port, param.nshards - 1);
     printf("  Source: %s:%s (%s)\n", param.SAddr, param.src_port, param.SMacAddr);
     printf("  Destination: %s:%s (%s)\n", param.DAddr, param.dst_port, param.DMacAddr);
     printf("[Main] Calling: new RoCEv2Dada(param)...\n");
@@ -334,7 +724,19 @@ int main(int argc, char *argv[]) {
     printf("[Main] Getting IB resources...\n");
     fflush(stdout);
     void *ibv_res_void = rdma_dada->GetIbvRes();
-    if (ibv_res_void) {
+    if (rdma_dada->NumaNode() >= 0) {
+        // ring 的页放到网卡节点上，注册 MR（固定页）之前进行
+        int bound = g_ringbuf->BindNode(rdma_dada->NumaNode());
+        for (unsigned int i = 1; i < g_nstreams; i++) g_stream_rings[i]->BindNode(rdma_dada->NumaNode());
+        printf("[Main] Ring: %d block(s) bound to NUMA node %d\n", bound, rdma_dada->NumaNode());
+    }
+    if (param.transport != RX_TRANSPORT_VERBS && param.transport != RX_TRANSPORT_RC) {
+        // 非 verbs 后端由内核/软件写入 ring，不需要注册 MR
+        printf("[Demo] Non-verbs transport: skipping RDMA ring registration\n");
+    } else if (g_nstreams > 1) {
+        // 多流接收走拷贝路径，各路 ring 不需要注册 MR
+        printf("[Demo] Multi-stream receive: skipping RDMA ring registration\n");
+    } else if (ibv_res_void) {
         struct ibv_utils_res *ibv_res_ptr = (struct ibv_utils_res *)ibv_res_void;
         if (ibv_res_ptr->pd) {
             printf("[Main] Attempting to register whole ring buffer...\n");
@@ -343,18 +745,27 @@ int main(int argc, char *argv[]) {
                 IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
             printf("[Main] RegisterWholeRing returned: %p\n", (void*)ring_mr);
             fflush(stdout);
-            if (ring_mr) {
+            if (ring_mr && rdma_dada->SetDirectMr(ring_mr) == 0) {
                 // 连续内存模式：整个ring注册为单一MR，启用DirectToRing优化
                 printf("[Demo] Registered ring MR: addr=%p rkey=0x%x\n", (void*)ring_mr->addr, ring_mr->rkey);
-                rdma_dada->SetDirectMr(ring_mr);
                 printf("[Demo] DirectToRing mode enabled (zero-copy RDMA writes)\n");
-            } else {
-                // 分块注册模式：每个block有自己的MR
-                // DirectToRing模式不支持多MR场景，使用普通接收路径(内部buffer + memcpy)
-                printf("[Demo] Using per-block MR registration mode\n");
+            } else if (ring_mr && param.transport != RX_TRANSPORT_RC) {
+                // 这种接收模式用不了 DirectToRing（原因已打印），走内部 buffer + memcpy
                 printf("[Demo] RDMA will use normal receive path (not DirectToRing)\n");
-                printf("[Demo] Note: For best performance, use 'dada_db --contig' to enable single-MR mode\n");
-                // 不调用SetDirectMr，让RDMA使用默认的接收路径
+            } else {
+                if (param.transport == RX_TRANSPORT_RC) {
+                    // 发送端只拿到一个 rkey，必须是整个 ring
+                    fprintf(stderr, "Error: the rc transport needs a contiguous ring (dada_db --contig)\n");
+                    delete rdma_dada; delete g_ringbuf; return -1;
+                }
+                // 分块注册模式：每个block有自己的MR，DirectToRing按block取lkey
+                if (g_ringbuf->IsBlockRegistered() && rdma_dada->SetDirectBlockMrs() == 0) {
+                    printf("[Demo] Using per-block MR registration mode\n");
+                    printf("[Demo] DirectToRing mode enabled (zero-copy RDMA writes, per-block lkey)\n");
+                } else {
+                    // 分块注册也失败：使用普通接收路径(内部buffer + memcpy)
+                    printf("[Demo] RDMA will use normal receive path (not DirectToRing)\n");
+                }
             }
         } else {
             fprintf(stderr, "[Demo] Warning: ibv_res_ptr->pd is NULL\n");
@@ -369,10 +780,28 @@ int main(int argc, char *argv[]) {
     // Note: dada_dbdisk is started externally by run_demo.sh
     // Do NOT start it here to avoid conflicts
     
+    for (unsigned int i = 1; i < g_nstreams; i++) {
+        RoCEv2Dada::RxStream stream;
+        PsrdadaRingBuf *ring = g_stream_rings[i];
+        stream.DAddr[0] = '\0';
+        stream.src_port[0] = '\0';
+        snprintf(stream.dst_port, sizeof(stream.dst_port), "%d", atoi(param.dst_port) + (int)i);
+        stream.GetBuffPtr = [ring](long int &buf_size) { return StreamGetBuffPtr(ring, buf_size); };
+        stream.DataSendBuff = [ring]() { return StreamSendBuffPtr(ring); };
+        stream.PeekBuffPtr = [ring](unsigned int ahead, long int &buf_size) { return StreamPeekBuffPtr(ring, ahead, buf_size); };
+        if (rdma_dada->AddStream(stream) < 0) {
+            fprintf(stderr, "Error: failed to add stream %u (dport %s)\n", i, stream.dst_port);
+            delete rdma_dada; close_stream_rings(); delete g_ringbuf; return -1;
+        }
+    }
+
     printf("[Main] Starting RDMA receiver thread...\n");
     fflush(stdout);
     ret = rdma_dada->Start();
-    if (ret != 0) { fprintf(stderr, "Error: rdma_dada->Start failed: %d\n", ret); delete rdma_dada; delete g_ringbuf; return -1; }
+    if (ret != 0) { fprintf(stderr, "Error: rdma_dada->Start failed: %d\n", ret); delete rdma_dada; close_stream_rings(); delete g_ringbuf; return -1; }
+    // Start 只在 DirectToRing 真正分开包头时接受 split_header，此后才按包头统计缺包
+    g_split_header = param.split_header;
+    if (g_split_header) printf("[Main] Split header: %d-byte headers aside, %u-byte payloads in the ring\n", PKT_HEAD_LEN, param.pkt_size - PKT_HEAD_LEN);
     printf("\n========================================\n");
     printf("RDMA receiver running\n");
     printf("Listening on: %s:%s (%s)\n", param.DAddr, param.dst_port, param.DMacAddr);
@@ -384,7 +813,7 @@ int main(int argc, char *argv[]) {
     printf("\n");
     printf("Press Ctrl+C to exit gracefully\n");
     printf("========================================\n\n");
-    while (!g_thread_exit) sleep(1);
+    while (!g_thread_exit && !rdma_dada->Finished()) sleep(1);
     
     printf("\n[Main] Shutting down...\n");
     
@@ -405,6 +834,7 @@ int main(int argc, char *argv[]) {
         delete g_ringbuf;
         g_ringbuf = NULL;
     }
+    close_stream_rings();
     
     // Give readers (dada_dbdisk) time to detect EOD and finish gracefully
     printf("[Main] Waiting for readers to detect EOD and finish...\n");
@@ -0,0 +1,156 @@
+// RC RDMA WRITE-with-immediate sender for the rc transport: writes whole blocks straight into the receiver's ring
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include "ibv_utils.h"
+#include "ibv_rc.h"
+#include "RoCEv2Dada.h"
+
+#define PKT_DATA_SIZE 8192
+#define RC_SEND_WR_NUM 64
+
+static volatile int g_exit = 0;
+
+static void signal_handler(int sig) { (void)sig; g_exit = 1; }
+
+static void print_helper() {
+    printf("Usage:\n");
+    printf("    ./Demo_rc_sender [options]\n");
+    printf("Options:\n");
+    printf("    --host, receiver address (default: 127.0.0.1)\n");
+    printf("    --rc-port, receiver TCP port (default: %d)\n", RC_DEFAULT_PORT);
+    printf("    -d, RDMA device number (default: 0)\n");
+    printf("    --gid-index, GID index on RoCE (default: 0)\n");
+    printf("    --pkt_size, packet slot size, same as receiver (default: %d)\n", PKT_DATA_SIZE + 64);
+    printf("    --count, number of blocks to write, 0 = until Ctrl+C (default: 0)\n");
+    printf("    --help, -h\n");
+}
+
+static double elapsed_s(const struct timespec &a, const struct timespec &b) {
+    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    char host[256] = "127.0.0.1";
+    unsigned int rc_port = RC_DEFAULT_PORT;
+    int device_id = 0, gid_index = 0;
+    unsigned int pkt_size = PKT_DATA_SIZE + 64;
+    uint64_t count = 0;
+    struct option long_options[] = {
+        {.name = "host", .has_arg = required_argument, .val = 256},
+        {.name = "rc-port", .has_arg = required_argument, .val = 284},
+        {.name = "gid-index", .has_arg = required_argument, .val = 285},
+        {.name = "pkt_size", .has_arg = required_argument, .val = 264},
+        {.name = "count", .has_arg = required_argument, .val = 266},
+        {.name = "device", .has_arg = required_argument, .val = 'd'},
+        {.name = "help", .has_arg = no_argument, .val = 'h'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "d:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 256: strncpy(host, optarg, sizeof(host) - 1); break;
+            case 284: rc_port = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 285: gid_index = atoi(optarg); break;
+            case 264: pkt_size = (unsigned int)atoi(optarg); break;
+            case 266: count = strtoull(optarg, NULL, 10); break;
+            case 'd': device_id = atoi(optarg); break;
+            default: print_helper(); return -1;
+        }
+    }
+    if (pkt_size < PKT_SEQ_OFFSET + 8) { print_helper(); return -1; }
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    struct ibv_utils_res res;
+    memset(&res, 0, sizeof(res));
+    if (open_ib_device((uint8_t)device_id, &res) < 0) return -1;
+    if (create_rc_res(&res, RC_SEND_WR_NUM, 0) < 0) return -1;
+    int sock = rc_connect(host, (uint16_t)rc_port);
+    if (sock < 0) return -1;
+    struct ibv_rc_info local, remote;
+    if (rc_local_info(&res, gid_index, &local) < 0) return -1;
+    if (rc_exchange(sock, &local, &remote) < 0) return -1;
+    if (remote.rkey == 0 || remote.block_bytes == 0 || remote.nblocks == 0) {
+        fprintf(stderr, "Receiver did not publish a ring (rkey=0x%x block=%lu)\n", remote.rkey, (unsigned long)remote.block_bytes);
+        return -1;
+    }
+    uint64_t block_bytes = remote.block_bytes;
+    unsigned int nchunks = (unsigned int)((block_bytes + RC_MAX_WRITE_BYTES - 1) / RC_MAX_WRITE_BYTES);
+    if (nchunks > RC_SEND_WR_NUM) { fprintf(stderr, "Block of %lu bytes is too large\n", (unsigned long)block_bytes); return -1; }
+    printf("Receiver ring: 0x%lx rkey=0x%x, %u blocks x %lu bytes\n",
+           (unsigned long)remote.ring_addr, remote.rkey, remote.nblocks, (unsigned long)block_bytes);
+
+    char *buf = (char *)aligned_alloc(4096, (block_bytes + 4095) / 4096 * 4096);
+    if (!buf) { fprintf(stderr, "Failed to allocate %lu-byte block\n", (unsigned long)block_bytes); return -1; }
+    memset(buf, 0, block_bytes);
+    struct ibv_mr *mr = ibv_reg_mr(res.pd, buf, block_bytes, IBV_ACCESS_LOCAL_WRITE);
+    if (!mr) { ibv_utils_error("Failed to register block buffer."); return -1; }
+    res.mr = mr;
+    if (init_rc_res(&res, gid_index, &local, &remote) < 0) return -1;
+
+    uint64_t slots = block_bytes / pkt_size;
+    uint64_t seq = 0, blocks = 0, bytes_pre = 0, bytes = 0;
+    struct timespec ts_start, ts_now;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    while (!g_exit && (count == 0 || blocks < count)) {
+        uint32_t idx;
+        if (rc_recv_credit(sock, &idx) < 0) { printf("Receiver closed the connection\n"); break; }
+        if (idx >= remote.nblocks) { fprintf(stderr, "Invalid block credit %u\n", idx); break; }
+        // 上一个 block 的 WRITE 已完成，可以改写缓冲
+        for (uint64_t k = 0; k < slots; k++, seq++) pkt_seq_put(buf + k * pkt_size, seq);
+        uint64_t remote_base = remote.ring_addr + (uint64_t)idx * block_bytes;
+        for (unsigned int i = 0; i < nchunks; i++) {
+            uint64_t off = (uint64_t)i * RC_MAX_WRITE_BYTES;
+            struct ibv_send_wr *wr = &res.send_wr[i];
+            res.sge[i].addr = (uint64_t)(uintptr_t)(buf + off);
+            res.sge[i].length = (uint32_t)(block_bytes - off < RC_MAX_WRITE_BYTES ? block_bytes - off : RC_MAX_WRITE_BYTES);
+            res.sge[i].lkey = mr->lkey;
+            memset(wr, 0, sizeof(*wr));
+            wr->wr_id = blocks;
+            wr->sg_list = &res.sge[i];
+            wr->num_sge = 1;
+            wr->wr.rdma.remote_addr = remote_base + off;
+            wr->wr.rdma.rkey = remote.rkey;
+            if (i == nchunks - 1) {
+                wr->opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+                wr->imm_data = htonl(idx);
+                wr->send_flags = IBV_SEND_SIGNALED;
+                wr->next = NULL;
+            } else {
+                wr->opcode = IBV_WR_RDMA_WRITE;
+                wr->next = &res.send_wr[i + 1];
+            }
+        }
+        if (ibv_post_send(res.qp, res.send_wr, &res.bad_send_wr)) { ibv_utils_error("Failed to post RDMA write."); break; }
+        struct ibv_wc wc;
+        int n;
+        while ((n = ibv_poll_cq(res.cq, 1, &wc)) == 0 && !g_exit) {}
+        if (n < 0 || (n == 1 && wc.status != IBV_WC_SUCCESS)) {
+            fprintf(stderr, "RDMA write to block %u failed: %s\n", idx, n < 0 ? "poll error" : ibv_wc_status_str(wc.status));
+            break;
+        }
+        blocks++;
+        bytes += block_bytes;
+        clock_gettime(CLOCK_MONOTONIC, &ts_now);
+        double elapsed = elapsed_s(ts_start, ts_now);
+        if (elapsed >= 1.0) {
+            printf("written: %lu blocks, %.3f Gbps\n", (unsigned long)blocks, (bytes - bytes_pre) * 8.0 / elapsed / 1e9);
+            bytes_pre = bytes;
+            ts_start = ts_now;
+        }
+    }
+    printf("Total written: %lu blocks (%lu packets)\n", (unsigned long)blocks, (unsigned long)seq);
+    close(sock);
+    destroy_ib_res(&res);
+    close_ib_device(&res);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Simple sendmmsg UDP sender for loopback benchmarks of the udp transport
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include "udp_transport.h"
+
+#define PKT_DATA_SIZE 8192
+
+static volatile int g_exit = 0;
+
+static void signal_handler(int sig) { (void)sig; g_exit = 1; }
+
+static void print_helper() {
+    printf("Usage:\n");
+    printf("    ./Demo_udp_sender [options]\n");
+    printf("Options:\n");
+    printf("    --sip, source IP address (default: 127.0.0.1)\n");
+    printf("    --dip, destination IP address (default: 127.0.0.1)\n");
+    printf("    --sport, source port number (default: 60000)\n");
+    printf("    --dport, destination port number (default: 17201)\n");
+    printf("    --pkt_size, frame size including Eth/IP/UDP and packet header, same as receiver (default: %d)\n",
+           PKT_DATA_SIZE + 64);
+    printf("    --send_n, datagrams per sendmmsg call (default: 64)\n");
+    printf("    --count, number of datagrams to send, 0 = until Ctrl+C (default: 0)\n");
+    printf("    --mcast-if, outgoing interface IP when --dip is a multicast group\n");
+    printf("    --help, -h\n");
+}
+
+int main(int argc, char *argv[]) {
+    char sip[64] = "127.0.0.1";
+    char dip[64] = "127.0.0.1";
+    int sport = 60000, dport = 17201;
+    unsigned int pkt_size = PKT_DATA_SIZE + 64;
+    unsigned int send_n = 64;
+    uint64_t count = 0;
+    char mcast_if[64] = "";
+    struct option long_options[] = {
+        {.name = "sip", .has_arg = required_argument, .val = 258},
+        {.name = "dip", .has_arg = required_argument, .val = 259},
+        {.name = "sport", .has_arg = required_argument, .val = 260},
+        {.name = "dport", .has_arg = required_argument, .val = 261},
+        {.name = "pkt_size", .has_arg = required_argument, .val = 264},
+        {.name = "send_n", .has_arg = required_argument, .val = 265},
+        {.name = "count", .has_arg = required_argument, .val = 266},
+        {.name = "mcast-if", .has_arg = required_argument, .val = 267},
+        {.name = "help", .has_arg = no_argument, .val = 'h'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 258: strncpy(sip, optarg, sizeof(sip) - 1); break;
+            case 259: strncpy(dip, optarg, sizeof(dip) - 1); break;
+            case 260: sport = atoi(optarg); break;
+            case 261: dport = atoi(optarg); break;
+            case 264: pkt_size = (unsigned int)atoi(optarg); break;
+            case 265: send_n = (unsigned int)atoi(optarg); break;
+            case 266: count = strtoull(optarg, NULL, 10); break;
+            case 267: strncpy(mcast_if, optarg, sizeof(mcast_if) - 1); break;
+            default: print_helper(); return -1;
+        }
+    }
+    if (pkt_size <= UDP_FRAME_HDR_LEN || send_n == 0) { print_helper(); return -1; }
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    unsigned int payload = pkt_size - UDP_FRAME_HDR_LEN;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    int sndbuf = 64 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(sport);
+    inet_pton(AF_INET, sip, &addr.sin_addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { perror("bind"); return -1; }
+    if (mcast_if[0]) {
+        // 组播：指定出口网卡，TTL 允许经过少量路由器
+        struct in_addr ifaddr;
+        int ttl = 8;
+        if (inet_pton(AF_INET, mcast_if, &ifaddr) != 1 ||
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr)) < 0) { perror("IP_MULTICAST_IF"); return -1; }
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+    addr.sin_port = htons(dport);
+    inet_pton(AF_INET, dip, &addr.sin_addr);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { perror("connect"); return -1; }
+
+    // 每个数据报的前8字节写入递增包序号，便于接收端核对
+    char *buf = (char *)calloc(send_n, payload);
+    struct mmsghdr *msgs = (struct mmsghdr *)calloc(send_n, sizeof(struct mmsghdr));
+    struct iovec *iovs = (struct iovec *)calloc(send_n, sizeof(struct iovec));
+    if (!buf || !msgs || !iovs) { fprintf(stderr, "Failed to allocate send buffers\n"); return -1; }
+    for (unsigned int i = 0; i < send_n; i++) {
+        iovs[i].iov_base = buf + (size_t)i * payload;
+        iovs[i].iov_len = payload;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    printf("Sending %u-byte datagrams %s:%d -> %s:%d, batch %u\n", payload, sip, sport, dip, dport, send_n);
+    uint64_t seq = 0, sent_pre = 0;
+    struct timespec ts_start, ts_now;
+    clock_gettime(CLOCK_MONOTONIC, &ts_start);
+    while (!g_exit && (count == 0 || seq < count)) {
+        unsigned int n = send_n;
+        if (count && count - seq < n) n = (unsigned int)(count - seq);
+        for (unsigned int i = 0; i < n; i++) {
+            // 载荷开头即帧中 PKT_SEQ_OFFSET 处的包序号，网络字节序
+            uint64_t s = htobe64(seq + i);
+            memcpy(buf + (size_t)i * payload, &s, sizeof(s));
+        }
+        int ret = sendmmsg(fd, msgs, n, 0);
+        if (ret < 0) { perror("sendmmsg"); break; }
+        seq += ret;
+        clock_gettime(CLOCK_MONOTONIC, &ts_now);
+        double elapsed = (ts_now.tv_sec - ts_start.tv_sec) + (ts_now.tv_nsec - ts_start.tv_nsec) / 1e9;
+        if (elapsed >= 1.0) {
+            printf("sent: %lu pkts, %.3f Mpps, %.3f Gbps\n", (unsigned long)seq,
+                   (seq - sent_pre) / elapsed / 1e6, (seq - sent_pre) * (double)payload * 8.0 / elapsed / 1e9);
+            sent_pre = seq;
+            ts_start = ts_now;
+        }
+    }
+    printf("Total sent: %lu datagrams\n", (unsigned long)seq);
+    free(buf);
+    free(msgs);
+    free(iovs);
+    close(fd);
+    return 0;
+}
@@ -1,14 +1,56 @@
 #pragma once
 
 #include <functional>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define PKT_HEAD_LEN 64
+#define PKT_SEQ_OFFSET 42   // PKT_HEADER 中 8 字节包序号的偏移（以太网/IP/UDP 头之后）
+
+// 包序号在线上是网络字节序（大端），与前面的以太网/IP/UDP 头一致，与收发两端的主机字节序无关；
+// 所有读写序号的地方（接收端、mock、发送端）都经过这两个函数
+static inline uint64_t pkt_seq_get(const void * frame)
+{
+    uint64_t v;
+    memcpy(&v, (const char *)frame + PKT_SEQ_OFFSET, sizeof(v));
+    return be64toh(v);
+}
+
+static inline void pkt_seq_put(void * frame, uint64_t seq)
+{
+    uint64_t v = htobe64(seq);
+    memcpy((char *)frame + PKT_SEQ_OFFSET, &v, sizeof(v));
+}
+
+// 接收后端
+#define RX_TRANSPORT_VERBS 0   // ibverbs RAW_PACKET QP（默认）
+#define RX_TRANSPORT_UDP   1   // 内核 UDP socket (recvmmsg)
+#define RX_TRANSPORT_XDP   2   // AF_XDP socket
+#define RX_TRANSPORT_DPDK  3   // DPDK poll-mode driver（需 USE_DPDK 编译）
+#define RX_TRANSPORT_PCAP  4   // pcap/pcapng 文件回放
+#define RX_TRANSPORT_RC    5   // RC QP，发送端 RDMA WRITE 直接写 ring block（WRITE_WITH_IMM 提交）
+
+// pcap 回放速率
+#define PCAP_REPLAY_MAX      0   // 不限速
+#define PCAP_REPLAY_ORIGINAL 1   // 按抓包时间戳
+#define PCAP_REPLAY_RATE     2   // 固定 Gbps
 
 struct ibv_mr;
+class RxTransport;
+class RxShardGroup;
+class RxMergeGroup;
+class RxStreamGroup;
+class RxAssembler;
+class RxCompactor;
+class RxSubset;
+class IbvDirectRing;
+class PsrdadaRingBuf;
+class PsrdadaSink;
 
 class RoCEv2Dada
 {
@@ -18,6 +60,12 @@ class RoCEv2Dada
         typedef std::function<int(unsigned char *, long int )> WriteBuff;
         typedef std::function<void(void)> DecrementWriteCount;  // 递减写入计数
         typedef std::function<bool(void)> IsBlockFull;  // 检查block是否已满
+        typedef std::function<char*(unsigned int, long int &)> PeekBuff;  // 当前 block 之后第 n 个 block（空闲时），不占用
+        typedef std::function<struct ibv_mr*(unsigned int)> BlockMr;     // 当前 block 之后第 n 个 block 的 MR，NULL = 整块 MR
+        typedef std::function<int(const char *, uint64_t)> HeaderSend;  // 一个 block 的包头数组（每包 PKT_HEAD_LEN 字节）和包数
+        struct FrameIndex { uint32_t offset; uint32_t len; };   // compact：帧在 block 中的偏移和长度
+        typedef std::function<int(const FrameIndex *, uint64_t)> IndexSend;  // 一个 block 的帧索引和帧数
+        typedef std::function<int(const uint64_t *, uint64_t)> LossBitmap;   // 一个 block 的丢失位图（置位 = 丢失）和槽位数
 
         struct RdmaParam
         {
@@ -32,6 +80,48 @@ class RoCEv2Dada
             int DirectToRing;
             struct ibv_mr *DirectMr;
             unsigned int nsge;
+            unsigned int poll_n;    // verbs：每次 ibv_poll_cq 最多取的完成数（0 = 8，不超过接收 WR 数）
+            unsigned int idle_us;   // verbs 接收线程：连续空闲超过该微秒数后睡眠等待完成事件（0 = 一直忙轮询）
+            unsigned int pool_kb;   // verbs 拷贝路径缓冲池：接收队列平时挂的缓冲总量（KB），让 DMA 写入留在 LLC/DDIO 内（0 = 关闭）
+            unsigned int pool_burst;    // 缓冲池模式下额外留在空闲栈里、CQ 积压时才挂上的 WR 数（0 = 256）
+            int numa_node;          // 接收线程和缓冲所在的 NUMA 节点：RX_NUMA_AUTO(-1) = 网卡所在节点，RX_NUMA_OFF(-2) = 不放置
+            int rt_priority;        // 接收线程的 SCHED_FIFO 优先级（0 = 普通调度）
+            bool mlock_all;         // Start() 时 mlockall，接收过程中不缺页
+            bool split_header;          // DirectToRing：包头与载荷分开（2 个 SGE），block 只存载荷，需要 nsge >= 2
+            unsigned int direct_depth;  // DirectToRing 同时挂接收 WR 的 block 数（1..3，0 = 2），大于 1 时需要 PeekBuffPtr
+            int transport;  // RX_TRANSPORT_*
+            bool udp_gro;   // UDP后端启用UDP_GRO
+            char IfName[64];        // XDP后端网卡名
+            unsigned int rx_queue;  // XDP后端接收队列号
+            bool xdp_skb_mode;      // XDP generic/SKB 模式（veth等无驱动支持的网卡）
+            char *RingBase;         // 连续ring的起始地址，XDP后端用作UMEM（NULL则拷贝）
+            uint64_t RingBytes;     // 连续ring的总大小
+            char DpdkEal[256];      // DPDK EAL 参数（空格分隔）
+            unsigned int dpdk_port;     // DPDK 端口号
+            unsigned int dpdk_queues;   // DPDK RX 队列数，每个队列一个 worker lcore
+            char PcapFile[256];     // 回放的 pcap/pcapng 文件
+            int replay_mode;        // PCAP_REPLAY_*
+            double replay_gbps;     // PCAP_REPLAY_RATE 时的速率
+            bool replay_loop;       // 文件结束后从头循环
+            unsigned int rc_port;   // RC 模式建连用的 TCP 端口
+            int gid_index;          // RC 模式的 GID 索引（RoCE 需要）
+            uint64_t RingBlockBytes;    // ring block 大小，RC 模式告知发送端
+            char McastIf[64];       // DAddr 为组播地址时，加入组播组的本地网卡 IP（空 = 按路由）
+            unsigned int nshards;   // 分片接收的 QP/socket 数（verbs、udp），分片 i 匹配源端口 src_port + i
+            char Devices[64];       // 多网卡聚合（verbs）：逗号分隔的设备号，如 "0,1"，按包序号合并去重（空 = 只用 device_id）
+            char Sources[256];      // 多源拼帧（verbs）：逗号分隔的源 ip[:port]，源 i 写 block 的第 i 段（空 = 不拼帧）
+            unsigned int source_id_offset;  // 非 0：按包头该偏移处 2 字节（大端）的板卡/天线号选段，代替源地址
+            unsigned int nsources;  // source_id_offset 非 0 时的段数（板卡/天线号 0..nsources-1）
+            bool seq_place;         // 单流按序号放置（verbs）：包按 PKT_HEADER 序号落到固定槽位，丢失的槽位清零
+            bool compact;           // 变长包（verbs）：按 byte_len 首尾相接写入 block，pkt_size 为帧长上限
+            bool stream_fill;       // 连续字节流：放不下的批次拆到下一个 block 开头，block 大小不必是批次的整数倍
+            unsigned int nant;          // 子集抽取：包内天线数（0 = 不抽取），载荷按 [天线][采样/通道][偏振] 排列
+            unsigned int pkt_nsamp;     // 子集抽取：每个天线的采样/通道数
+            unsigned int sample_bytes;  // 子集抽取：每个采样的字节数（PKT_NPOL * PKT_NBIT）
+            unsigned int ant_first;     // 子集抽取：保留的第一个天线
+            unsigned int ant_count;     // 子集抽取：保留的天线数
+            unsigned int chan_first;    // 子集抽取：保留的第一个采样/通道
+            unsigned int chan_count;    // 子集抽取：保留的采样/通道数
             char SAddr[64];
             char DAddr[64];
             char SMacAddr[64];
@@ -43,19 +133,63 @@ class RoCEv2Dada
             WriteBuff WritSendBuff;
             DecrementWriteCount DecrementWriteCount;
             IsBlockFull IsBlockFull;
+            PeekBuff PeekBuffPtr;   // DirectToRing 预先挂载下一个 block 的接收 WR（可为空）
+            BlockMr GetBlockMrPtr;  // DirectToRing 分块注册的 ring：按 block 取 lkey（可为空）
+            HeaderSend HeaderSendBuff;  // split_header：block 提交前交出其包头数组（可为空）
+            IndexSend FrameIndexSend;   // compact：block 提交前交出其帧索引（可为空）
+            LossBitmap LossSend;        // seq_place/多源拼帧：block 提交前交出其丢失位图（可为空）
+            PsrdadaRingBuf *Ring;       // verbs 拷贝路径：非 NULL 时由编译期特化的接收循环直接写这个 ring，
+                                        // block 记账在 PsrdadaSink 中，不再每批调用上面的 block 回调（可为空）
+        };
+
+        // 同一进程内的额外一路流（verbs、udp）：自己的 flow 规则和 ring，空字段沿用 RdmaParam 中的值
+        struct RxStream
+        {
+            char DAddr[64];         // 组播地址时自动加入
+            char src_port[64];
+            char dst_port[64];
+            GetBuff GetBuffPtr;
+            DataSend DataSendBuff;
+            PeekBuff PeekBuffPtr;   // 取下一个 block 前不占用地查看（ahead = 0），ring 满时跳过这一路而不阻塞其它路（可为空）
         };
 
         explicit RoCEv2Dada(const RdmaParam & Param);
         ~RoCEv2Dada();
+        int AddStream(const RxStream & stream);    // Start() 之前调用，RdmaParam 本身是第 0 路
         int Start();
+        void Stop();    // 停止并等待接收线程（析构时自动调用），之后不能再 Start
         void * GetIbvRes() const;
+        bool Finished() const { return this->finished; }  // 数据源结束（pcap 回放完），接收线程已提交最后的数据并退出
+        int NumaNode() const { return this->numa_node; }   // 实际使用的 NUMA 节点，-1 = 未知或不放置
         int SetDirectMr(struct ibv_mr *mr);
+        int SetDirectBlockMrs();    // 非连续 ring：DirectToRing 每个 block 的 lkey 由 GetBlockMrPtr 给出
     private:
         RoCEv2Dada(const RoCEv2Dada &);
         const RoCEv2Dada &operator=(const RoCEv2Dada &);
         static void * SendRecvThread(void * arg);
+        int ConnectRc();
+        int ValidateParam(unsigned int nstreams) const;   // 接收模式的组合检查，不支持时打印原因并返回 RDMA_ERROR
         RdmaParam param;
         void * ibv_res;
+        RxTransport * transport;
+        int rc_sock;    // RC 模式的 TCP 控制连接，发放 block credit
+        RxShardGroup * shards;  // nshards > 1 时代替 transport 和 SendRecvThread
+        void * shard_res;       // verbs 分片 1..n-1 的 ibv_utils_res
+        RxMergeGroup * merge;   // 多网卡聚合时代替 transport 和 SendRecvThread
+        void * merge_res;       // 链路 1..n-1 的 ibv_utils_res（各自打开设备）
+        unsigned int nlinks;
+        RxStreamGroup * streams;    // AddStream 之后代替 transport 和 SendRecvThread
+        void * stream_res;          // 第 1..n-1 路 verbs 流的 ibv_utils_res
+        RxAssembler * assembler;    // 多源拼帧时代替 transport 和 SendRecvThread
+        RxCompactor * compactor;    // 变长包压缩放置时代替 transport 和 SendRecvThread
+        IbvDirectRing * direct;     // DirectToRing 接收 WR 的挂载与 block 提交
+        PsrdadaSink * sink;         // 特化接收循环写入 Ring 时的 block 记账（NULL = 走回调的通用循环）
+        char * stage;               // stream_fill：跨 block 的批次先收到这里，再拆成两段拷贝；子集聚合时整批收到这里
+        RxSubset * subset;          // nant > 0 时保留的天线/通道字节段
+        int numa_node;              // 网卡所在（或指定）的 NUMA 节点，-1 = 不放置
+        volatile bool finished;     // 接收线程在数据源结束后置位
+        volatile bool stop;         // Stop() 置位，接收线程看到后退出
+        bool started;               // 接收线程已创建、还没有 join
 };
 
 #ifdef __cplusplus
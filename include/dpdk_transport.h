@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "rx_transport.h"
+#include "ibv_utils.h"
+
+#define DPDK_MAX_QUEUES 16
+
+struct rte_mempool;
+struct rte_ring;
+struct rte_mbuf;
+
+// DPDK poll-mode 后端。每个 RX 队列由一个独立的 worker lcore 轮询（rte_eth_rx_burst），
+// 按 IP/UDP 四元组过滤后把 mbuf 放入该队列的 SPSC rte_ring；接收线程（main lcore）
+// 在 Recv 中轮流取出 mbuf，把整帧拷进 ring block 的 slot。
+// 只有 1 个队列且没有 worker lcore 时，接收线程直接轮询该队列。
+// 不依赖 rte_flow/RSS 等硬件特性，可以用 net_pcap / net_ring 虚拟 PMD 在无网卡环境下运行。
+class DpdkRxTransport : public RxTransport
+{
+    public:
+        DpdkRxTransport();
+        ~DpdkRxTransport();
+        int Open(const char * eal_args, uint16_t port_id, unsigned int nb_queues,
+                 const struct ibv_pkt_info * pkt_info, unsigned int pkt_size, unsigned int batch);
+        const char * Name() const { return "dpdk"; }
+        int Recv(char * dst, unsigned int pkt_num);
+    private:
+        DpdkRxTransport(const DpdkRxTransport &);
+        const DpdkRxTransport &operator=(const DpdkRxTransport &);
+
+        struct Queue
+        {
+            DpdkRxTransport * owner;
+            uint16_t id;
+            unsigned int lcore;     // 轮询该队列的 worker lcore，LCORE_ID_ANY 表示由接收线程直接轮询
+            struct rte_ring * ring;
+            // 以下统计只由对应 worker 写
+            uint64_t rx_pkts;
+            uint64_t filtered;   // 四元组不匹配被丢弃
+            uint64_t ring_full;  // 接收线程来不及取而丢弃
+            uint64_t tsc_first;
+            uint64_t tsc_last;
+        };
+        static int WorkerMain(void * arg);
+        unsigned int Filter(struct rte_mbuf ** bufs, unsigned int n, uint64_t * filtered) const;
+        void PrintStats() const;
+
+        bool eal_ready;
+        bool port_started;
+        bool workers_running;
+        volatile bool stop;
+        uint16_t port_id;
+        unsigned int nb_queues;
+        unsigned int next_queue;  // Recv 轮询的起始队列
+        unsigned int pkt_size;
+        unsigned int batch;
+        struct ibv_pkt_info pkt_info;
+        struct rte_mempool * pool;
+        struct rte_mbuf ** burst;
+        Queue queues[DPDK_MAX_QUEUES];
+        uint64_t copied;
+        uint64_t truncated;
+        uint64_t inline_filtered;
+};
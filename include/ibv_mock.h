@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ibverbs 软件模拟（-DUSE_IBV_MOCK=ON 时代替 libibverbs 链接）。
+// 每个 QP 模拟一条 UDP 流：按配置的包速率和突发长度到达，消耗已投递的接收 WR，
+// 在 WR 的缓冲中写入以太网/IP/UDP 头（取自 ibv_create_flow 的规则）和 8 字节递增包序号，
+// 然后在 recv CQ 上产生完成。可以注入线路丢包、相邻包乱序和错误完成。
+// 参数默认从环境变量读取：
+//   IBV_MOCK_PPS        每个 QP 的包速率，0 = 不限速（每次 poll 完成所有已投递 WR）
+//   IBV_MOCK_BURST      突发长度，包按该粒度成批到达（默认 1）
+//   IBV_MOCK_DROP       线路丢包概率（序号跳过，WR 不消耗）
+//   IBV_MOCK_REORDER    与下一个包交换序号的概率
+//   IBV_MOCK_ERROR      错误完成概率（IBV_WC_GENERAL_ERR，WR 被消耗）
+//   IBV_MOCK_FRAME_LEN  帧长，0 = 填满 WR 的所有 SGE（默认 0）
+//   IBV_MOCK_SEED       随机数种子
+//   IBV_MOCK_DEVICES    模拟的设备数（默认 1，最多 4），每个设备上的 QP 各自生成一条从 0 开始的序号流，
+//                       用于测试多网卡冗余接收
+//   IBV_MOCK_NO_STEERING  非 0 时 ibv_create_flow 返回 EOPNOTSUPP（规则仍用于生成帧头），模拟不支持 steering 的网卡
+//   IBV_MOCK_STRAY      NO_STEERING 时混入其它流（目的端口不同）的帧的比例
+//   IBV_MOCK_FILL       非 0 时写满整帧（模拟 DMA 写入载荷，用于比较缓存行为），默认只写帧头和序号
+// 一个 QP 上挂多条 flow 规则时，帧按规则轮流生成（第 k 个包用规则 k % n 的帧头），每条规则的序号各自从 0 递增，
+// 相当于多块板卡发往同一个 QP（IBV_MOCK_PPS 由各规则均分）。
+// SGE 不在已注册 MR 内时产生 IBV_WC_LOC_PROT_ERR，用于检查 DirectToRing / per-block MR 的 lkey。
+// 完成通道：ibv_req_notify_cq arm 过的 CQ 由后台线程每 20 us 检查一次，有完成时产生事件（ibv_get_cq_event 取走）。
+// RC QP 支持同进程内的 RDMA WRITE / WRITE_WITH_IMM 回环：按 RTR 的 dest_qp_num 找到对端，
+// 按 rkey 校验并直接拷贝，WRITE_WITH_IMM 在对端产生 IBV_WC_RECV_RDMA_WITH_IMM（对端无接收 WR 时为 RNR 错误）。
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ibv_mock_config {
+    double pps;
+    unsigned int burst;
+    double drop;
+    double reorder;
+    double error;
+    unsigned int frame_len;
+    unsigned int seed;
+    unsigned int devices;
+    bool no_steering;
+    double stray;
+    bool fill;
+};
+
+struct ibv_mock_stats {
+    uint64_t posted;        // 投递的接收 WR
+    uint64_t completed;     // 成功的接收完成
+    uint64_t wire_drops;    // 注入的线路丢包
+    uint64_t no_wr_drops;   // 到达时没有可用 WR 被丢弃
+    uint64_t reordered;
+    uint64_t errors;        // 注入的错误完成
+    uint64_t prot_errors;   // lkey/地址不匹配
+    uint64_t sent;          // 发送完成
+    uint64_t strays;        // 混入的其它流的帧
+};
+
+// 在创建 QP 之前调用，覆盖环境变量中的配置
+void ibv_mock_configure(const struct ibv_mock_config *config);
+void ibv_mock_get_stats(struct ibv_mock_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ibv_utils.h"
+
+// RC 单边写入模式：接收端把整个 ring 注册为 REMOTE_WRITE MR，建连时通过 TCP 交换 QP 信息、ring 地址和 rkey。
+// 接收端每打开一个 block 就在 TCP 上发一个 credit（block 序号），发送端用 RDMA WRITE 把数据直接写进该 block，
+// 最后一个 WR 用 WRITE_WITH_IMM 携带 block 序号，接收端收到该完成后 MarkWritten。
+#define RC_DEFAULT_PORT 18515
+#define RC_MAX_WRITE_BYTES (1u << 30)   // 单个 WRITE WR 的最大长度
+#define RC_RECV_WR_NUM 16               // 接收端常驻的 0-SGE 接收 WR（每个 WRITE_WITH_IMM 消耗一个）
+
+struct ibv_rc_info {
+    uint32_t qpn;
+    uint32_t psn;
+    uint16_t lid;
+    uint8_t gid[16];
+    uint64_t ring_addr;     // 接收端 ring 起始地址（发送端填 0）
+    uint64_t ring_bytes;
+    uint64_t block_bytes;
+    uint32_t rkey;
+    uint32_t nblocks;
+};
+
+int rc_listen(uint16_t port);
+int rc_connect(const char *host, uint16_t port);
+int rc_exchange(int sock, const struct ibv_rc_info *local, struct ibv_rc_info *remote);
+int rc_send_credit(int sock, uint32_t block_idx);
+int rc_recv_credit(int sock, uint32_t *block_idx);
+int create_rc_res(struct ibv_utils_res *ib_res, int send_wr_num, int recv_wr_num);
+int rc_local_info(struct ibv_utils_res *ib_res, int gid_index, struct ibv_rc_info *info);
+int init_rc_res(struct ibv_utils_res *ib_res, int gid_index, const struct ibv_rc_info *local, const struct ibv_rc_info *remote);
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "rx_transport.h"
+#include "ibv_utils.h"
+#include "RoCEv2Dada.h"
+#include "rx_subset.h"
+
+#define DIRECT_MAX_DEPTH 3
+#define DIRECT_MAX_SGE 32
+
+// ibverbs RAW_PACKET QP 的拷贝接收路径：包先落在内部 mem_buf，再拷贝到 ring block。
+// pool_wr > 0 时是缓冲池模式：接收队列平时只挂 pool_wr 个缓冲（能留在 LLC/DDIO 中的工作集），完成后立即逐包拷走，
+// 不再为凑满一批而压着 WR。拷完的缓冲压进空闲栈，从栈顶取回重新投递，最近用过的先挂回去；
+// 其余缓冲留在栈底备用：poll 取满（CQ 积压，正在突发）时每次多挂一次 poll 的量，积压持续就一直加到全部挂上；
+// 一旦 poll 取不满就不再补充，回落到工作集。
+// 建 QP 时投递了全部 WR，开始收包后逐步收敛到工作集。
+class IbvRxTransport : public RxTransport
+{
+    public:
+        IbvRxTransport(struct ibv_utils_res * ibv_res, unsigned int pkt_size, int RdmaDirectGpu, unsigned int pool_wr = 0);
+        ~IbvRxTransport();
+        const char * Name() const { return "verbs"; }
+        int Recv(char * dst, unsigned int pkt_num);
+    private:
+        IbvRxTransport(const IbvRxTransport &);
+        const IbvRxTransport &operator=(const IbvRxTransport &);
+        int RecvEach(char * dst, unsigned int pkt_num);
+        struct ibv_utils_res * res;
+        unsigned int pkt_size;
+        int RdmaDirectGpu;
+        uint32_t * lifo;        // 缓冲池模式：空闲栈，拷完没有挂回去的 WR（栈顶最近）
+        unsigned int nlifo;
+        unsigned int posted;    // 挂在接收队列上的 WR 数
+        unsigned int pool_wr;   // 平时挂着的 WR 数（工作集）
+        unsigned int target;    // 当前要挂着的 WR 数，突发时高于 pool_wr
+};
+
+// DirectToRing 接收：接收 WR 直接指向 ring block 中的包 slot，网卡把帧写进 block，无需拷贝。
+// 一个 block 的 slot 数为 block 大小 / pkt_size（整个 block 都写满，不足一包的尾部不用），
+// WR 池远小于 block 时，完成的 WR 循环挂到下一个 slot，直到整个 block 挂完。
+// 非连续 ring 分块注册时，每个 block 的 lkey 由 GetBlockMrPtr 按 block 索引给出。
+// WR 按 slot 顺序连续挂载：当前 block 的 slot 挂完后接着挂后面的 block（PeekBuffPtr 确认读端已经清空），
+// 最多同时挂 depth 个 block。block 的 slot 全部完成后提交，并从 GetBuffPtr 正式取得已经挂好的下一个 block，
+// 所以 DataSendBuff/GetBuffPtr 期间接收队列里一直有 WR，block 切换不会丢包。
+// split_header 时每个 WR 两个 SGE：PKT_HEAD_LEN 字节的包头落在该 block 的包头数组，载荷连续写入 block，
+// block 成为纯采样数据；提交前把包头数组交给 HeaderSendBuff。
+// 天线/通道子集抽取时不保留的字节由 SGE 指向一块共用的丢弃缓冲，网卡 DMA 时就丢掉，block 中只有保留的字节。
+class IbvDirectRing
+{
+    public:
+        enum { SEG_DATA, SEG_HDR, SEG_DROP };
+        struct Segment { uint32_t len; int kind; };     // 一个 SGE：写入 block、写入包头数组或丢弃
+        // 按 split_header 和子集抽取排出一个包的 SGE，最多写 DIRECT_MAX_SGE 个，返回需要的个数
+        static unsigned int Layout(const RoCEv2Dada::RdmaParam * param, const RxSubset * subset, Segment * seg);
+        IbvDirectRing(const RoCEv2Dada::RdmaParam * param, struct ibv_utils_res * ibv_res, unsigned int depth,
+                      const RxSubset * subset);
+        ~IbvDirectRing();
+        int Poll();     // poll 一次 CQ，返回完成的包数，<0 表示出错
+        uint64_t Blocks() const { return blocks; }
+        uint64_t Errors() const { return errors; }
+        uint64_t Dropped() const { return dropped; }
+    private:
+        IbvDirectRing(const IbvDirectRing &);
+        const IbvDirectRing &operator=(const IbvDirectRing &);
+
+        struct Block
+        {
+            char * base;
+            uint64_t gen;           // block 序号，WR 据此找到所属的 block
+            uint64_t slots;         // block 中的包数
+            uint32_t lkey;
+            uint64_t posted;        // 已挂 WR 的 slot 数
+            uint64_t done;          // 已完成的 slot 数
+            char * hdr;             // split_header：slots 个包头
+            struct ibv_mr * hdr_mr;
+            uint64_t hdr_cap;       // hdr 可容纳的包头数
+        };
+        int Arm();
+        int Commit();
+        int ReserveHeaders(Block * b);
+
+        const RoCEv2Dada::RdmaParam * param;
+        struct ibv_utils_res * res;
+        unsigned int pkt_size;
+        unsigned int data_len;      // 每个 slot 写入 block 的字节数（split_header 时不含包头，子集抽取时只含保留的字节）
+        unsigned int nsge;          // 每个 WR 的 SGE 数
+        Segment seg[DIRECT_MAX_SGE];
+        bool split;                 // 有写入包头数组的 SGE
+        char * drop;                // 丢弃缓冲
+        struct ibv_mr * drop_mr;
+        unsigned int depth;
+        Block ring[DIRECT_MAX_DEPTH];
+        unsigned int head;
+        unsigned int nblocks;
+        uint64_t next_gen;
+        uint64_t * wr_gen;          // 每个 WR 当前所属 block 的序号
+        uint32_t * free_ids;        // 未挂载的 WR
+        unsigned int nfree;
+        uint64_t blocks;
+        uint64_t errors;
+        uint64_t dropped;           // 落在启动前内部缓冲 WR 中的包
+};
@@ -21,6 +21,14 @@ struct ibv_pkt_info {
     uint16_t dst_port; 
 };
 
+// 软件 flow 过滤（网卡不支持 steering 时）：按 create_flow 相同的元组（MAC、IPv4、UDP 端口）
+// 比较帧头前 IBV_FILTER_BYTES 字节，tmpl/mask 由 ibv_pkt_filter_init 生成
+#define IBV_FILTER_BYTES 48
+struct ibv_pkt_filter {
+    uint8_t tmpl[IBV_FILTER_BYTES];
+    uint8_t mask[IBV_FILTER_BYTES];
+};
+
 struct ibv_utils_res {
     struct ibv_device *dev;
     struct ibv_context *context;
@@ -44,13 +52,22 @@ struct ibv_utils_res {
     unsigned int poll_n;
     unsigned int pkt_size;
     unsigned char * mem_buf;
+    size_t mem_buf_bytes;       // mem_buf 由 rx_numa_alloc 映射时的长度（munmap 释放），0 = malloc
     struct ibv_pkt_info pkt_info;
     pthread_t tid;
     struct ibv_wc *wc_tmp;
-    int recv_sum_completed;
+    int recv_sum_completed;     // 拷贝路径：完成环（wc_tmp）中未处理的完成数
+    int wc_head;                // 拷贝路径：完成环中最早一个未处理完成的位置
     bool recv_ready;
     bool mr_external;
     bool init_flag;
+    bool cq_events;     // 创建 CQ 时带完成通道（recv_cc），空闲时可以睡眠等待完成事件
+    struct ibv_cq_ex *cq_ex;    // cq_events 时尽量带 wallclock 完成时间戳创建的 CQ（cq 指向同一对象），不支持时为 NULL
+    bool stamp_next;    // 下一次 ib_poll_cq 读取第一个完成的到达时间（RxIdle 被事件唤醒后设置）
+    uint64_t stamp_ns;  // 该完成的 wallclock 时间（CLOCK_REALTIME 时基，ns），0 = 没有读到
+    int mcast_fd;   // 组播时用于 IGMP 加入的 socket（>0 有效）
+    struct ibv_pkt_filter *sw_filter;   // create_flow 失败时启用的软件过滤（NULL = 网卡已过滤）
+    uint64_t sw_rejected;               // 被软件过滤丢弃的帧数
 };
 
 void ibv_utils_info(const char *msg);
@@ -64,5 +81,19 @@ int register_memory(struct ibv_utils_res *ib_res, void *addr, size_t total_lengt
 int create_flow(struct ibv_utils_res *ib_res, struct ibv_pkt_info *pkt_info);
 int ib_send(struct ibv_utils_res *ibv_res);
 int ib_recv(struct ibv_utils_res *ibv_res);
+int ib_repost_chain(struct ibv_utils_res *ibv_res, const struct ibv_wc *wc, unsigned int first, unsigned int n, unsigned int ring);
+int ib_poll_cq_stamped(struct ibv_utils_res *ib_res, int n, struct ibv_wc *wc);
+// 接收循环的 poll：平时就是 ibv_poll_cq；stamp_next 时这一次走扩展 poll，顺带读出第一个完成的到达时间
+static inline int ib_poll_cq(struct ibv_utils_res *ib_res, int n, struct ibv_wc *wc)
+{
+    if (__builtin_expect(ib_res->stamp_next, 0)) return ib_poll_cq_stamped(ib_res, n, wc);
+    return ibv_poll_cq(ib_res->cq, n, wc);
+}
 int destroy_ib_res(struct ibv_utils_res *ib_res);
 int close_ib_device(struct ibv_utils_res *ib_res);
+bool ipv4_is_multicast(uint32_t ip);
+void ipv4_multicast_mac(uint32_t ip, uint8_t *mac);
+int ipv4_mcast_join(int fd, uint32_t group, uint32_t ifaddr);
+void ibv_pkt_filter_init(struct ibv_pkt_filter *filter, const struct ibv_pkt_info *pkt_info);
+uint64_t ibv_pkt_filter_batch(const struct ibv_pkt_filter *filter, const uint8_t *const *frames, const uint32_t *lens, int n);
+int ibv_filter_completions(struct ibv_utils_res *ib_res, int n);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "rx_transport.h"
+#include "ibv_utils.h"
+#include "RoCEv2Dada.h"
+
+// pcap/pcapng 回放后端：mmap 抓包文件，打开时建立帧索引（只保留以太网帧中与四元组匹配的 UDP 包），
+// Recv 按速率控制把帧拷进 ring block，走与在线接收完全相同的批处理、block 计数和 MarkWritten 流程。
+class PcapRxTransport : public RxTransport
+{
+    public:
+        PcapRxTransport();
+        ~PcapRxTransport();
+        int Open(const char * path, const struct ibv_pkt_info * pkt_info, unsigned int pkt_size,
+                 int mode, double gbps, bool loop);
+        const char * Name() const { return "pcap"; }
+        int Recv(char * dst, unsigned int pkt_num);
+        bool Finished() const { return finished; }
+    private:
+        PcapRxTransport(const PcapRxTransport &);
+        const PcapRxTransport &operator=(const PcapRxTransport &);
+
+        struct Frame
+        {
+            uint64_t offset;  // 帧数据在文件中的偏移
+            uint32_t len;     // 抓到的字节数
+            uint64_t ts_ns;   // 抓包时间戳
+        };
+        int IndexPcap();
+        int IndexPcapng();
+        void AddFrame(uint64_t offset, uint32_t caplen, uint32_t origlen, uint64_t ts_ns);
+        uint64_t DueTime(size_t idx) const;
+
+        int fd;
+        const uint8_t * map;
+        uint64_t map_len;
+        unsigned int pkt_size;
+        struct ibv_pkt_info pkt_info;
+        int mode;
+        double gbps;
+        bool loop;
+        std::vector<Frame> frames;
+        uint64_t filtered;    // 非以太网或四元组不匹配
+        uint64_t snapped;     // 抓包时被截断（caplen < 原始长度）
+
+        // 回放状态
+        size_t cur;
+        bool started;
+        bool finished;
+        uint64_t t0_ns;         // 回放开始时刻
+        uint64_t loop_ts_ns;    // 之前各轮累计的抓包时长（ORIGINAL）
+        uint64_t bits_sent;     // 已回放的比特数（RATE）
+        uint64_t replayed;
+        uint64_t loops;
+        uint64_t truncated;     // 大于 pkt_size 被截断
+};
@@ -24,3 +24,6 @@ void set_udp_src_port(struct udp_pkt *pkt, uint16_t port);
 void set_udp_dst_port(struct udp_pkt *pkt, uint16_t port);
 void set_pkt_len(struct udp_pkt *pkt, uint16_t len);
 void set_payload(struct udp_pkt *pkt, uint8_t *payload, int len);
+
+// 帧是否为 IPv4/UDP 且四元组一致（ip 为网络字节序，port 为主机字节序）；软件收包后端用于过滤
+bool match_udp_flow(const uint8_t *frame, uint32_t len, uint32_t src_ip, uint32_t dst_ip, uint16_t src_port, uint16_t dst_port);
@@ -22,6 +22,9 @@ public:
     int Init(key_t key, uint64_t block_bytes, uint64_t nbufs, const char *header_template_path, uint64_t file_bytes = 0);
     char* GetWriteBuffer(uint64_t bytes);
     int MarkWritten(uint64_t bytes);
+    // 不占用地查看当前写入 block 之后第 ahead 个 block：读端已清空时返回其地址，否则返回 NULL；
+    // 没有打开的 block 时 ahead 只能为 0，即下一次 GetWriteBuffer 将取得的 block
+    char* PeekWriteBuffer(uint64_t ahead);
     int StartBlock();
     int StopBlock();
     uint64_t GetFreeSpace();
@@ -38,9 +41,19 @@ public:
     // 新方法：为每个block分别注册MR（支持非连续内存）
     int RegisterRingBlocks(struct ibv_pd *pd, int access);
     
+    // 如果所有block在内存中连续，返回ring起始地址和总大小，否则返回NULL
+    char* GetContiguousRing(uint64_t *total_bytes);
+    
+    // 把各 block 的共享内存放到 NUMA 节点 node 上（已落地的页尽量迁移），需在注册 MR 之前调用；返回成功的 block 数
+    int BindNode(int node);
+    
     // 获取当前写入block的MR
     struct ibv_mr* GetCurrentBlockMr();
     
+    // 当前写入block之后第ahead个block的MR（分块注册模式，O(1)按block索引查找），整块注册时返回NULL
+    struct ibv_mr* GetBlockMr(uint64_t ahead);
+    bool IsBlockRegistered() const { return use_block_registration && !block_mrs.empty(); }
+    
     // 清理所有已注册的block MRs
     void UnregisterAllBlocks();
     
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ibv_utils.h"
+#include "RoCEv2Dada.h"
+#include "rx_thread.h"
+#include "rx_slots.h"
+
+#define RX_MAX_SOURCES 64
+#define RX_ASSEMBLE_HOLD_NS 2000000ull  // 有源超前到下一个 block 时，等待其它源补齐当前 block 的时间
+#define RX_ASSEMBLE_JUMP_AGREE 4        // 向前跳过超过 RX_FILL_BLOCKS 时，目标 block 中至少要有这么多暂留包
+#define RX_ASSEMBLE_STALE_RUN 1024      // 连续这么多个旧序号的包（或只有旧包持续 RX_ASSEMBLE_HOLD_NS）视为计数器回退
+
+// 多源拼帧：多块 FPGA 板卡（每块发一部分天线/通道）发往同一个 QP，每个 block 按源分成 nsources 段，
+// 第 i 段固定存放源 i 的包，段内按 PKT_HEADER 中的包序号排列：
+//   block + (i * slots + (seq - base)) * pkt_size
+// 于是一个 block 是所有源在同一时间片的数据，下游可以直接按源读取连续数组而不需要再重排一遍。
+// 源由帧的源 IP/端口（SetSource）或包头中 2 字节大端的板卡/天线号（source_id_offset）决定。
+// 某个源已经发到下一个 block 时，它的包留在接收 WR 中暂不重新投递，等其它源补齐当前 block 后再放入；
+// 超过 RX_ASSEMBLE_HOLD_NS 或暂留的 WR 达到接收队列的一半时，当前 block 带着空洞提交，并计入缺失数。
+// 提交时空槽位清零，丢失位图（置位 = 丢失）交给 LossSend；整块丢失时补交全零 block，后面的数据保持时间对齐。
+// 序号重新对齐：只收到旧序号的包（发送端重启、计数器清零）达到 RX_ASSEMBLE_STALE_RUN 个或持续 RX_ASSEMBLE_HOLD_NS 时，
+// 当前 block 提交后 base 对齐到新序号；向前跳得比补零范围更远时，需要多个暂留包落在同一目标 block，
+// 单个序号异常的包丢弃（计入 outlier）。只有部分源重启时其它源的包会打断旧包的连续计数，该源的包按 stale 丢弃。
+// seq_place 时只有一个段、不按源区分（flow 规则已经选定了流），即单流按序号放置。
+class RxAssembler
+{
+    public:
+        RxAssembler(const RoCEv2Dada::RdmaParam * param, struct ibv_utils_res * res, unsigned int nsources);
+        ~RxAssembler();
+        void SetSource(unsigned int idx, uint32_t ip, uint16_t port);   // ip 为网络字节序，port 为主机字节序
+        int Start(const RxThreadPlace & place);  // place.cpu 为第一个线程的核
+        void Stop();
+    private:
+        RxAssembler(const RxAssembler &);
+        const RxAssembler &operator=(const RxAssembler &);
+
+        static void * Thread(void * arg);
+        int Run();
+        int Locate(const uint8_t * frame) const;
+        int Place(uint64_t wr_id);
+        int Commit();
+        int Replay();
+        int Resync(uint64_t wr_id);
+        int Repost(uint64_t wr_id);
+        const uint8_t * Frame(uint64_t wr_id) const;
+
+        const RoCEv2Dada::RdmaParam * param;
+        struct ibv_utils_res * res;
+        unsigned int nsources;
+        uint32_t src_ip[RX_MAX_SOURCES];
+        uint16_t src_port[RX_MAX_SOURCES];
+        RxSlotBlock blk;        // 每个源一段，段内 slots 个包
+        uint64_t base;          // 当前 block 第一个槽位的序号（按 slots 对齐），UINT64_MAX 表示还没收到包
+        uint64_t * deferred;    // 属于后面 block、暂不重新投递的 WR
+        unsigned int ndeferred;
+        unsigned int max_deferred;
+        uint64_t t_hold;        // 第一个 WR 被暂留的时刻
+        bool committed;         // Place 中提交了 block，需要重放暂留的 WR
+        uint64_t stale_run;     // 连续收到的旧序号包数，收到当前或之后的包时清零
+        uint64_t t_stale;       // 这一串旧包中第一个到达的时刻
+        pthread_t tid;
+        bool started;
+        volatile bool stop;
+        uint64_t packets;
+        uint64_t unknown;       // 不属于任何源
+        uint64_t stale;         // 序号落在已提交的 block 之前
+        uint64_t outliers;      // 序号远超当前 block 且没有其它包佐证，丢弃
+        uint64_t resyncs;       // 计数器回退或远跳后重新对齐的次数（触发回退的旧包仍计入 stale）
+        uint64_t dups;
+        uint64_t errors;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ibv_utils.h"
+#include "RoCEv2Dada.h"
+#include "rx_thread.h"
+
+// 变长包：帧按完成的 byte_len 首尾相接地拷贝进 block，不再按 pkt_size 步长留出空隙。
+// pkt_size 是一帧的上限（接收 WR 的大小），超过它的帧由网卡以 IBV_WC_LOC_LEN_ERR 完成，
+// 短于 PKT_HEAD_LEN 的帧包头不完整，这两种都计入 truncated 并丢弃。
+// 每个 block 记录一张 (offset, len) 索引，block 放不下下一帧时尾部清零，
+// 索引交给 FrameIndexSend 后提交 block。
+class RxCompactor
+{
+    public:
+        RxCompactor(const RoCEv2Dada::RdmaParam * param, struct ibv_utils_res * res);
+        ~RxCompactor();
+        int Start(const RxThreadPlace & place);  // place.cpu 为第一个线程的核
+        void Stop();
+    private:
+        RxCompactor(const RxCompactor &);
+        const RxCompactor &operator=(const RxCompactor &);
+
+        static void * Thread(void * arg);
+        int Run();
+        int OpenBlock();
+        int Commit();
+        int Place(const struct ibv_wc * wc);
+
+        const RoCEv2Dada::RdmaParam * param;
+        struct ibv_utils_res * res;
+        char * block;
+        uint64_t block_bytes;
+        uint64_t used;          // 当前 block 已写入的字节数
+        RoCEv2Dada::FrameIndex * index;
+        uint64_t nindex;
+        uint64_t index_cap;
+        pthread_t tid;
+        bool started;
+        volatile bool stop;
+        uint64_t frames;
+        uint64_t bytes;
+        uint64_t blocks;
+        uint64_t truncated;     // 超过 pkt_size 或短于 PKT_HEAD_LEN 的帧
+        uint64_t errors;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ibv_utils.h"
+#include "psrdada_ringbuf.h"
+#include "rx_idle.h"
+#include "rx_thread.h"
+
+// PSRDADA sink：自己做 block 记账（一个 block 能放几批、写满后提交），代替 GetBuffPtr/DecrementWriteCount/
+// IsBlockFull/DataSendBuff 四个回调。每批只在内联的 Commit 里减一次计数，取 block 和提交才进入 ring。
+// 与 demo 的回调一致：block 放不下整数个批次时尾部不用，提交整个 block。
+class PsrdadaSink
+{
+    public:
+        PsrdadaSink(PsrdadaRingBuf * ring, uint64_t batch_bytes);
+        char * Acquire();       // 取下一个可写 block（读端没有清空时阻塞），出错返回 NULL
+        // 一批已写入当前 block：<0 出错，1 表示 block 已写满并提交（接着 Acquire），0 表示还能继续写
+        inline int Commit()
+        {
+            if (--left) return 0;
+            return Submit() < 0 ? -1 : 1;
+        }
+        uint64_t Blocks() const { return blocks; }
+    private:
+        PsrdadaSink(const PsrdadaSink &);
+        const PsrdadaSink &operator=(const PsrdadaSink &);
+        int Submit();
+        PsrdadaRingBuf * ring;
+        uint64_t block_bytes;
+        uint64_t batch_bytes;
+        uint64_t left;          // 当前 block 还能写的批次数
+        uint64_t blocks;
+        time_t last_print;
+};
+
+// 包几何：模板参数非 0 时是编译期常量，拷贝按常量长度内联展开；为 0 时用运行时的值（通用版本）
+template <unsigned int PKT, unsigned int NPKT>
+struct RxGeometry
+{
+    RxGeometry(unsigned int pkt, unsigned int n) : pkt_rt(pkt), n_rt(n) {}
+    inline unsigned int Pkt() const { return PKT ? PKT : pkt_rt; }
+    inline unsigned int Batch() const { return NPKT ? NPKT : n_rt; }
+    static bool Fixed() { return PKT && NPKT; }
+    unsigned int pkt_rt;
+    unsigned int n_rt;
+};
+
+// 编译期特化的 verbs 拷贝接收循环：完成 poll 进完成环（与 IbvRxTransport::Recv 相同的 wc_tmp/wc_head 记账），
+// 凑满一批后逐包拷进 block 并成链重投，block 记账交给 Sink。没有 std::function 回调，
+// debug_mode、RdmaDirectGpu、软件过滤等分支在选用本循环之前就已排除，循环里不再判断。
+// *stop 置位后返回 0（每轮 poll 检查一次，空闲睡眠时最多晚 RX_IDLE_SLEEP_MS），出错返回 -1。
+// 每秒打印一次吞吐，没有流量时也打印（每批之后和空 poll 时检查）。
+template <class Sink, class Geom>
+class RxEngine
+{
+    public:
+        RxEngine(struct ibv_utils_res * res, Sink * sink, const Geom & geom, unsigned int idle_us, const volatile bool * stop)
+            : res(res), sink(sink), geom(geom), idle_us(idle_us), stop(stop), pkts(0) {}
+        int Run();
+    private:
+        void Report(RxIdle * idle);
+        struct ibv_utils_res * res;
+        Sink * sink;
+        Geom geom;
+        unsigned int idle_us;
+        const volatile bool * stop;
+        RxRate rate;
+        uint64_t pkts;          // 本统计周期收到的包数
+};
+
+template <class Sink, class Geom>
+void RxEngine<Sink, Geom>::Report(RxIdle * idle)
+{
+    if (!rate.Due()) return;
+    printf("[RxEngine] %u x %u bytes%s: %.3f Gbps, %lu blocks\n", geom.Batch(), geom.Pkt(), Geom::Fixed() ? "" : " (generic)",
+           rate.Gbps(pkts * geom.Pkt()), (unsigned long)sink->Blocks());
+    if (idle->Enabled()) idle->Report("RxEngine");
+    pkts = 0;
+}
+
+template <class Sink, class Geom>
+int RxEngine<Sink, Geom>::Run()
+{
+    const unsigned int pkt = geom.Pkt();
+    const unsigned int n = geom.Batch();
+    const unsigned int ring = (unsigned int)res->recv_wr_num;
+    const uint64_t batch_bytes = (uint64_t)pkt * n;
+    struct ibv_wc * wc = res->wc_tmp;
+    RxIdle idle(res, idle_us);
+    const bool sleepy = idle.Enabled();
+    if (n == 0 || n > ring) {
+        printf("[RxEngine] ERROR: batch of %u packets does not fit the %u receive WRs\n", n, ring);
+        return -1;
+    }
+
+    char * dst = sink->Acquire();
+    if (!dst) return -1;
+    rate = RxRate();
+    pkts = 0;
+    unsigned int empty = 0;
+    while (!*stop) {
+        unsigned int pending = (unsigned int)res->recv_sum_completed;
+        if (pending < n) {
+            unsigned int tail = res->wc_head + pending;
+            if (tail >= ring) tail -= ring;
+            unsigned int room = ring - tail;
+            if (room > ring - pending) room = ring - pending;
+            if (room > res->poll_n) room = res->poll_n;
+            int got = ib_poll_cq(res, room, wc + tail);
+            if (got < 0) return -1;
+            res->recv_completed = got;
+            res->recv_sum_completed += got;
+            if (sleepy && idle.After(got) < 0) return -1;
+            // 忙轮询的空 poll 很便宜，每 1024 次才读一次时钟；空闲睡眠时每次 poll 前已经等过
+            if (got == 0 && (sleepy || (++empty & 1023) == 0)) Report(&idle);
+            if ((unsigned int)res->recv_sum_completed < n) continue;
+        }
+
+        // 常量 pkt 时 memcpy 内联成定长拷贝，常量 n 时循环可以整体展开；错误完成的缓冲内容无效，slot 清零
+        unsigned int head = (unsigned int)res->wc_head;
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int k = head + i;
+            if (k >= ring) k -= ring;
+            if (__builtin_expect(wc[k].status != IBV_WC_SUCCESS, 0)) memset(dst + (uint64_t)i * pkt, 0, pkt);
+            else memcpy(dst + (uint64_t)i * pkt, (const void *)res->sge[wc[k].wr_id * res->recv_nsge].addr, pkt);
+        }
+        if (ib_repost_chain(res, wc, head, n, ring) < 0) return -1;
+        head += n;
+        res->wc_head = (int)(head >= ring ? head - ring : head);
+        res->recv_sum_completed -= n;
+        pkts += n;
+
+        dst += batch_bytes;
+        int r = sink->Commit();
+        if (r < 0) return -1;
+        if (r > 0) {
+            dst = sink->Acquire();
+            if (!dst) return -1;
+        }
+        Report(&idle);
+    }
+    return 0;
+}
+
+// 运行时分派：pkt_size/send_n 与预先实例化的某个组合相同时用该特化版本，否则用通用版本
+int rx_engine_run(struct ibv_utils_res * res, PsrdadaSink * sink, unsigned int pkt_size, unsigned int send_n, unsigned int idle_us,
+                  const volatile bool * stop);
+bool rx_engine_specialised(unsigned int pkt_size, unsigned int send_n);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ibv_utils.h"
+
+#define RX_IDLE_SLEEP_MS 100    // 一次睡眠最长的时间，到期后回到轮询，统计和退出检查照常进行
+
+// 混合轮询：有流量时忙轮询 CQ；连续 idle_us 微秒没有完成后 arm CQ 的完成通道（recv_cc），
+// 调用方再 poll 一次（arm 之前到达的完成不会产生事件），仍然为空就睡眠等待完成事件，流量恢复后回到忙轮询。
+// 空闲但还没到阈值时用 tpause（编译时开启 WAITPKG）或 pause 降低自旋的功耗。
+// 唤醒延迟：从完成到达（CQ 带 wallclock 完成时间戳时取第一个完成的时间戳，包含线程被唤醒的过程）
+// 到第一次 poll 到它；网卡不支持时间戳时只能从 poll 返回算起，不含唤醒本身。
+// 只有真正阻塞过的睡眠才记一次唤醒：上一段空闲 arm 留下的事件在睡眠前不等待地取走，不计入。
+class RxIdle
+{
+    public:
+        RxIdle(struct ibv_utils_res * res, unsigned int idle_us);
+        bool Enabled() const { return idle_ns > 0 && res->recv_cc; }
+        int After(int n);       // 每次 poll CQ 之后调用，n 为取回的完成数；<0 表示等待事件出错
+        void Report(const char * who);  // 打印上次 Report 以来的睡眠统计
+    private:
+        struct ibv_utils_res * res;
+        uint64_t idle_ns;
+        uint64_t t_idle;        // 开始空闲的时刻，0 = 有流量
+        bool armed;             // 已 arm，事件还没有取走
+        uint64_t t_wake;        // 被事件唤醒的时刻，0 = 没有待测的唤醒
+        uint64_t stamped;       // 从完成时间戳测得的唤醒数
+        uint64_t t_report;
+        uint64_t sleeps;
+        uint64_t slept_ns;
+        uint64_t wakes;
+        uint64_t wake_ns;
+        uint64_t wake_ns_max;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "ibv_utils.h"
+#include "RoCEv2Dada.h"
+#include "rx_thread.h"
+#include "rx_slots.h"
+
+#define RX_MAX_LINKS 4
+#define RX_MERGE_HOLD_NS 2000000ull  // 包超前当前 block 时等待其它链路补齐的时间，超时后提前提交
+#define RX_MERGE_JUMP_AGREE 4        // 越过下一个 block 向前跳时，目标 block 中至少要有这么多暂留包
+#define RX_MERGE_STALE_RUN 1024      // 所有链路连续这么多个远落后的包（或只有这种包持续 RX_MERGE_HOLD_NS）视为计数器回退
+#define RX_MERGE_LAG_BLOCKS 16       // 落后 base 不超过这么多个 block 的旧包视为慢链路的冗余副本，不算回退的证据
+
+// 多网卡聚合：每个设备一个 RAW_PACKET QP（同一条 flow 规则）和一个绑核线程，写同一个 ring。
+// 包按 PKT_HEADER 中的序号放到 block 内的 (seq - base) * pkt_size 处，位图记录已到的槽位：
+// 两条链路冗余发送同一路流时，后到的重复包直接丢弃；两条链路各承担一部分包时，按序号合并成有序的 block。
+// block 的所有槽位到齐后提交；链路间的偏斜超过 RX_MERGE_HOLD_NS 时带着空洞提交，并计入缺失数。
+// 提交与多源拼帧共用 RxSlotBlock：空槽位清零，丢失位图交给 LossSend；整块丢失时补交全零 block（最多 RX_FILL_BLOCKS 个）。
+// 超前的包留在该链路的接收 WR 中暂不重新投递（链路线程继续 poll），block 切换后再放一遍。
+// 跳得比补零范围更远时需要多个暂留包落在同一目标 block，单个坏序号的包丢弃（outlier）。
+// 只收到远落后 base 的包（发送端重启、计数器清零）达到 RX_MERGE_STALE_RUN 个或持续 RX_MERGE_HOLD_NS 时，
+// 提交当前 block 并把 base 对齐到新序号，各链路暂留的旧流包丢弃。冗余链路中慢的一路只落后几个 block，
+// 它的包照常按 stale 丢弃，不参与判断。
+class RxMergeGroup
+{
+    public:
+        RxMergeGroup(const RoCEv2Dada::RdmaParam * param, unsigned int nlinks);
+        ~RxMergeGroup();
+        void SetLink(unsigned int idx, struct ibv_utils_res * res);  // 不取得 res 的所有权
+        int Start(const RxThreadPlace & place);  // place.cpu 为第一个线程的核
+        void Stop();
+    private:
+        RxMergeGroup(const RxMergeGroup &);
+        const RxMergeGroup &operator=(const RxMergeGroup &);
+
+        struct Link
+        {
+            RxMergeGroup * group;
+            unsigned int idx;
+            struct ibv_utils_res * res;
+            pthread_t tid;
+            bool started;
+            uint64_t packets;       // 写入 block 的包
+            uint64_t dups;          // 槽位已被其它链路写过
+            uint64_t stale;         // 序号落在已提交的 block 之前
+            uint64_t outliers;      // 序号远超当前 block 且没有其它包佐证，丢弃
+            uint64_t errors;        // 错误完成
+            uint64_t * parked;      // 属于后面 block、暂不重新投递的 WR
+            unsigned int nparked;
+            unsigned int max_parked;
+            uint64_t t_hold;        // 第一个 WR 被暂留的时刻
+            uint64_t park_gen;      // 暂留时的 block 代数，变化后重放
+            uint64_t park_epoch;    // 暂留时的对齐代数，重新对齐后暂留的包作废
+            uint64_t seen_gen;      // 最近一次 Place 看到的 block 代数
+        };
+        static void * LinkThread(void * arg);
+        int Run(Link * l);
+        int Place(Link * l, const char * pkt);
+        int Advance(uint64_t seen_gen, uint64_t seq);
+        int Resync(uint64_t seen_gen, uint64_t seq);
+        int Release(Link * l);
+        int Replay(Link * l);
+        int Repost(Link * l, uint64_t wr_id);
+        int Commit();
+
+        const RoCEv2Dada::RdmaParam * param;
+        unsigned int nlinks;
+        Link links[RX_MAX_LINKS];
+        pthread_rwlock_t lock;  // 读锁：写当前 block；写锁：提交并切换 block
+        RxSlotBlock blk;        // 当前 block，单段；位图和 filled 在读锁下原子更新，提交在写锁下
+        uint64_t base;          // 当前 block 第一个槽位的序号，UINT64_MAX 表示还没收到包
+        uint64_t gen;           // block 代数
+        uint64_t epoch;         // 对齐代数，计数器回退重新对齐时加一
+        uint64_t resyncs;       // 计数器回退或远跳后重新对齐的次数
+        uint64_t stale_run;     // 所有链路连续收到的旧序号包数，收到当前或之后的包时清零
+        uint64_t stale_since;   // 这一串旧包中第一个到达的时刻，0 表示没有
+        volatile bool stop;
+};
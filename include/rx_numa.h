@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define RX_NUMA_AUTO -1     // RdmaParam::numa_node：从 sysfs 读取网卡所在节点
+#define RX_NUMA_OFF  -2     // 不做 NUMA 放置
+#define RX_NUMA_MAX_NODES 1024
+#define RX_NUMA_MASK_WORDS (RX_NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+
+// NUMA 放置：网卡所在节点由 sysfs 给出，接收线程、内部缓冲和 ring 都放到该节点上，
+// 避免 DMA 写入和拷贝跨 socket。内存策略直接走 mbind/set_mempolicy 系统调用，不依赖 libnuma。
+int rx_numa_node_of_ibdev(const char * ibdev);      // /sys/class/infiniband/<ibdev>/device/numa_node，未知返回 -1
+int rx_numa_node_of_netdev(const char * ifname);    // /sys/class/net/<ifname>/device/numa_node，未知返回 -1
+int rx_numa_cpus(int node, cpu_set_t * cpus);       // 节点的 CPU 集合，返回 CPU 个数，失败返回 -1
+int rx_numa_bind(void * addr, size_t bytes, int node, bool move);  // 区间优先从 node 分配，move 时迁移已有的页
+int rx_numa_prefer(int node);                       // 当前线程之后的分配优先落在 node 上，node < 0 恢复默认策略
+// 当前线程的内存策略（get_mempolicy/set_mempolicy），mode 含 MPOL_F_* 标志，mask 为 RX_NUMA_MASK_WORDS 个字
+int rx_numa_get_policy(int * mode, unsigned long * mask);
+int rx_numa_set_policy(int mode, const unsigned long * mask);
+
+// 在 node 上分配内部缓冲：先试 2 MB 大页，不够时退回普通页并 madvise 透明大页；
+// 页在返回前已写零落地。*mapped 为实际映射的长度，释放时原样交给 rx_numa_free。
+void * rx_numa_alloc(size_t bytes, int node, size_t * mapped, bool * huge);
+void rx_numa_free(void * addr, size_t mapped);
+
+// 实时线程配置：rt_priority > 0 时线程属性设为 SCHED_FIFO（需要 CAP_SYS_NICE 或 rtprio 限额）
+int rx_rt_attr(pthread_attr_t * attr, int rt_priority);
+int rx_mlock_all();     // mlockall(MCL_CURRENT | MCL_FUTURE)，接收过程中不再缺页
+
+// 作用域内当前线程的分配优先落在 node 上（verbs 资源、WR/SGE/WC 数组、驱动的队列内存），
+// 构造时保存调用线程原来的策略（例如 numactl --membind 给的），析构时原样恢复
+class RxNumaScope
+{
+    public:
+        explicit RxNumaScope(int node);
+        ~RxNumaScope();
+    private:
+        RxNumaScope(const RxNumaScope &);
+        const RxNumaScope &operator=(const RxNumaScope &);
+        bool active;
+        int mode;
+        unsigned long mask[RX_NUMA_MASK_WORDS];
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rx_transport.h"
+#include "RoCEv2Dada.h"
+#include "rx_thread.h"
+
+#define RX_MAX_SHARDS 16
+
+// 多 QP / 多 socket 分片接收：每个分片一个后端实例和一个绑核线程，写当前 block 中互不重叠的一段
+// （按 send_n 批次均分）。分片写满自己的段后到达屏障，最后到达的线程调用一次 DataSendBuff（MarkWritten）
+// 并取下一个 block，然后推进 block 代数，其余分片看到代数变化后继续写新 block。
+class RxShardGroup
+{
+    public:
+        RxShardGroup(const RoCEv2Dada::RdmaParam * param, unsigned int nshards);
+        ~RxShardGroup();
+        void SetShard(unsigned int idx, RxTransport * transport);  // 取得 transport 的所有权
+        int Start(const RxThreadPlace & place);  // place.cpu 为第一个线程的核
+        void Stop();
+    private:
+        RxShardGroup(const RxShardGroup &);
+        const RxShardGroup &operator=(const RxShardGroup &);
+
+        struct Shard
+        {
+            RxShardGroup * group;
+            unsigned int idx;
+            RxTransport * transport;
+            pthread_t tid;
+            bool started;
+            uint64_t packets;       // 只由本分片线程写
+            uint64_t wait_ns;       // 在屏障上等待其它分片的时间
+        };
+        static void * ShardThread(void * arg);
+        int Run(Shard * s);
+        int OpenBlock();
+        void Range(unsigned int idx, char ** begin, long int * bytes) const;
+
+        const RoCEv2Dada::RdmaParam * param;
+        unsigned int nshards;
+        Shard shards[RX_MAX_SHARDS];
+        long int batch_bytes;
+        char * block;           // 当前 block，gen 变化后有效
+        long int block_batches; // 当前 block 可容纳的批次数
+        uint64_t gen;           // block 代数
+        unsigned int arrived;   // 已写满本段的分片数
+        volatile bool stop;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "RoCEv2Dada.h"
+
+#define RX_FILL_BLOCKS 16   // 整块丢失时最多补交的全零 block 数，序号跳得更远视为发送端重启，重新对齐
+
+// 按序号放置的 block：nsegs 段，每段 slots 个包槽位，到达位图每个槽位一位。
+// 提交时空槽位用非临时存储清零并计入 missing，丢失位图（置位 = 丢失）交给 LossSend，再取下一个 block。
+// RxAssembler（按源分段）和 RxMergeGroup（单段、多链路并发写）共用同一套提交逻辑；
+// 放包的热路径直接读写 block/bitmap/filled（并发写时由调用方原子更新），Open/Commit 由调用方保证互斥
+class RxSlotBlock
+{
+    public:
+        RxSlotBlock(const RoCEv2Dada::RdmaParam * param, unsigned int nsegs, const char * who);
+        ~RxSlotBlock();
+        int Open();     // 取下一个 block，按其大小得到 slots 并清空位图
+        int Commit();   // 空槽位清零、交出丢失位图、提交当前 block 并打开下一个
+
+        char * block;
+        uint64_t slots;         // 每段的包槽位数
+        uint64_t * bitmap;      // nsegs * slots 位
+        uint64_t filled;        // 当前 block 已写入的槽位数
+        uint64_t blocks;        // 已提交的 block 数（含补交的全零 block）
+        uint64_t missing;       // 提交时仍为空的槽位数（整块跳过时由调用方累加）
+    private:
+        RxSlotBlock(const RxSlotBlock &);
+        const RxSlotBlock &operator=(const RxSlotBlock &);
+        void ZeroFill();
+
+        const RoCEv2Dada::RdmaParam * param;
+        unsigned int nsegs;
+        const char * who;       // 打印前缀
+        uint64_t * loss;        // 提交时的丢失位图
+        uint64_t bitmap_words;
+};
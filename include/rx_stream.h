@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rx_transport.h"
+#include "RoCEv2Dada.h"
+#include "rx_thread.h"
+
+#define RX_MAX_STREAMS 16
+
+// 一个进程接收多路流（每个 beam / 目的端口一路），各写自己的 ring。
+// 每路流一个后端实例（verbs 时共用设备和 PD、各有一条 flow 规则和 QP），完成按 QP 天然分流；
+// 一个绑核线程轮流 poll 各路，每路有自己的当前 block 和批次计数，写满后调用该路的 DataSendBuff。
+// 有 PeekBuffPtr 的路先不占用地查看下一个 block，读端还没清空时本轮跳过这一路（计入 ring full），
+// 不让一个 ring 满的流在阻塞的 GetBuffPtr 中卡住其它流。
+class RxStreamGroup
+{
+    public:
+        explicit RxStreamGroup(const RoCEv2Dada::RdmaParam * param);
+        ~RxStreamGroup();
+        // 取得 transport 的所有权；返回流序号，<0 表示已满
+        int Add(const char * name, RxTransport * transport, const RoCEv2Dada::GetBuff & get_buff,
+                const RoCEv2Dada::DataSend & data_send, const RoCEv2Dada::PeekBuff & peek_buff);
+        unsigned int Count() const { return nstreams; }
+        int Start(const RxThreadPlace & place);  // place.cpu 为第一个线程的核
+        void Stop();
+    private:
+        RxStreamGroup(const RxStreamGroup &);
+        const RxStreamGroup &operator=(const RxStreamGroup &);
+
+        struct Stream
+        {
+            char name[32];
+            RxTransport * transport;
+            RoCEv2Dada::GetBuff GetBuffPtr;
+            RoCEv2Dada::DataSend DataSendBuff;
+            RoCEv2Dada::PeekBuff PeekBuffPtr;   // 可为空，此时 GetBuffPtr 可能阻塞
+            char * block;           // 当前 block，NULL 表示需要取下一个
+            long int bytes;         // 当前 block 按整批次可写的字节数
+            long int filled;        // 已写满的批次字节数
+            unsigned int batch_filled;
+            uint64_t packets;
+            uint64_t blocks;
+            uint64_t full;          // 取下一个 block 时 ring 已满的次数
+            bool waiting;           // 正在等读端清空下一个 block
+        };
+        static void * Thread(void * arg);
+        int Run();
+        int OpenBlock(Stream * s);
+
+        const RoCEv2Dada::RdmaParam * param;
+        Stream * streams[RX_MAX_STREAMS];
+        unsigned int nstreams;
+        long int batch_bytes;
+        pthread_t tid;
+        bool started;
+        volatile bool stop;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "RoCEv2Dada.h"
+
+#define RX_SUBSET_MAX_RUNS 256
+
+// 天线/通道子集抽取：包载荷按 [天线][采样/通道][偏振] 排列（头文件模板的 NANT、PKT_NSAMP、PKT_NPOL、PKT_NBIT），
+// 只保留 ant_first 起的 ant_count 个天线、每个天线中 chan_first 起的 chan_count 个采样/通道。
+// 保留的字节按原顺序紧凑排列：PKT_HEAD_LEN 字节的包头，接着每个天线一段 chan_count * sample_bytes 字节。
+// 相邻的保留段合并，例如保留全部通道时所有天线只有一段。
+class RxSubset
+{
+    public:
+        struct Run { uint32_t offset; uint32_t len; };     // 源包中保留的一段
+        RxSubset();
+        int Init(const RoCEv2Dada::RdmaParam * param);     // 参数不合法返回 -1；nant 为 0 时不抽取，Active() 为 false
+        bool Active() const { return nruns > 0; }
+        unsigned int InLen() const { return in_len; }
+        unsigned int OutLen() const { return out_len; }
+        unsigned int Runs() const { return nruns; }
+        const Run & GetRun(unsigned int i) const { return runs[i]; }
+        // 把 src 中 npkts 个 InLen() 步长的包抽取成 dst 中 OutLen() 步长的包
+        void Gather(char * dst, const char * src, unsigned int npkts) const;
+    private:
+        Run runs[RX_SUBSET_MAX_RUNS + 1];
+        unsigned int nruns;
+        unsigned int in_len;
+        unsigned int out_len;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define RX_REPORT_NS 1000000000ull  // 接收线程打印吞吐的周期
+
+// 接收线程共用的小工具：单调时钟、自旋等待、按放置创建/回收线程、每秒一次的吞吐报告
+
+static inline uint64_t rx_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void rx_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    sched_yield();
+#endif
+}
+
+// 线程放置：cpu >= 0 时绑到该核，否则 numa_node >= 0 时绑到节点的全部核；
+// rt_priority > 0 时用 SCHED_FIFO，只在绑核时生效（忙轮询的实时线程不让出 CPU，没有独占的核会饿死同节点的其它线程）
+struct RxThreadPlace
+{
+    int cpu;
+    int numa_node;
+    int rt_priority;
+};
+
+// 按 place 创建线程，亲和性和调度属性在创建时生效，线程从第一条指令起就在目标核上；
+// 没有 SCHED_FIFO 权限时退回普通调度。who 为打印前缀，成功返回 0
+int rx_thread_start(pthread_t * tid, void * (*fn)(void *), void * arg, const RxThreadPlace & place, const char * who);
+void rx_thread_join(pthread_t tid, bool * started);    // *started 时 join 并清零
+
+// 每秒一次的吞吐报告：Due() 到期时重新计时并返回 true，之后 Secs()/Gbps() 按这个周期换算
+class RxRate
+{
+    public:
+        RxRate() : t_report(rx_now_ns()), secs(0) {}
+        bool Due()
+        {
+            uint64_t now = rx_now_ns();
+            if (now - t_report < RX_REPORT_NS) return false;
+            secs = (now - t_report) / 1e9;
+            t_report = now;
+            return true;
+        }
+        double Secs() const { return secs; }
+        double Gbps(uint64_t bytes) const { return bytes * 8.0 / secs / 1e9; }
+        // 计数器本周期的增量，*pre 更新为当前值
+        static uint64_t Delta(uint64_t count, uint64_t * pre)
+        {
+            uint64_t d = count - *pre;
+            *pre = count;
+            return d;
+        }
+    private:
+        uint64_t t_report;
+        double secs;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+// 接收后端抽象：RoCEv2Dada 的批处理、block计数与ring提交逻辑只依赖这个接口，
+// 具体收包方式（ibverbs RAW_PACKET QP、内核UDP socket 等）由各后端实现。
+class RxTransport
+{
+    public:
+        virtual ~RxTransport() {}
+        virtual const char * Name() const = 0;
+        // 把最多 pkt_num 个包按 pkt_size 步长连续写入 dst。
+        // 返回本次写入的包数；0 表示暂时没有数据；<0 表示错误。
+        virtual int Recv(char * dst, unsigned int pkt_num) = 0;
+        // 取到新 block 后调用，bytes 为本 block 将被写满的字节数；
+        // 能直接写入 ring 的后端可以据此提前挂好整个 block 的接收缓冲
+        virtual int BeginBlock(char * block, long int bytes) { (void)block; (void)bytes; return 0; }
+        // 数据源已经结束（回放到文件末尾），Recv 之后不会再返回数据
+        virtual bool Finished() const { return false; }
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "rx_transport.h"
+#include "ibv_utils.h"
+
+// Ethernet(14) + IPv4(20) + UDP(8)
+#define UDP_FRAME_HDR_LEN 42
+
+// 内核 UDP socket 后端：recvmmsg 一次系统调用收一批数据报，直接写入 ring block。
+// 每个包的 UDP payload 放在 slot 的 UDP_FRAME_HDR_LEN 偏移处，前面补上与
+// RAW_PACKET 路径相同的以太网/IP/UDP 头，保证两种后端写出的 block 布局一致。
+class UdpRxTransport : public RxTransport
+{
+    public:
+        UdpRxTransport();
+        ~UdpRxTransport();
+        int Open(const struct ibv_pkt_info * pkt_info, unsigned int pkt_size, unsigned int batch, bool gro,
+                 uint32_t mcast_if);
+        const char * Name() const { return "udp"; }
+        int Recv(char * dst, unsigned int pkt_num);
+        // 一个线程轮询多个 socket 时设为非阻塞，空闲的 socket 不会占住线程直到超时
+        void SetNonBlocking(bool on) { recv_flags = on ? MSG_DONTWAIT : MSG_WAITFORONE; }
+    private:
+        UdpRxTransport(const UdpRxTransport &);
+        const UdpRxTransport &operator=(const UdpRxTransport &);
+        int fd;
+        unsigned int pkt_size;
+        unsigned int payload_size;
+        unsigned int batch;
+        unsigned int segs_per_msg;  // UDP_GRO 时每个消息最多合并的数据报数
+        bool gro;
+        int recv_flags;
+        uint8_t frame_hdr[UDP_FRAME_HDR_LEN];
+        struct mmsghdr * msgs;
+        struct iovec * iovs;
+        char * cmsg_buf;
+        uint64_t truncated;     // 超过 slot 大小被截断的数据报
+        uint64_t gso_dropped;   // GRO 段大小与 payload_size 不一致而丢弃的数据报
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <linux/if_xdp.h>
+
+#include "rx_transport.h"
+#include "ibv_utils.h"
+
+// AF_XDP 接收后端。
+// 如果给定了连续的 PSRDADA ring（RingBase/RingBytes），整个 ring 注册为 UMEM（unaligned chunk 模式），
+// fill ring 直接填 ring block 中每个包的 slot 地址，网卡/内核把帧写进 block，无需再拷贝；
+// 否则退化为内部 UMEM + 拷贝。内置的 XDP 程序按 IP/UDP 四元组把包重定向到本 socket，
+// 其它流量 XDP_PASS 交还内核协议栈。支持 generic/SKB 模式，可以在 veth 上测试。
+class XdpRxTransport : public RxTransport
+{
+    public:
+        XdpRxTransport();
+        ~XdpRxTransport();
+        int Open(const char * ifname, unsigned int queue_id, bool skb_mode,
+                 const struct ibv_pkt_info * pkt_info, unsigned int pkt_size, unsigned int batch,
+                 char * ring_base, uint64_t ring_bytes);
+        const char * Name() const { return zero_copy ? "xdp(ring umem)" : "xdp(copy)"; }
+        int Recv(char * dst, unsigned int pkt_num);
+        int BeginBlock(char * block, long int bytes);
+    private:
+        XdpRxTransport(const XdpRxTransport &);
+        const XdpRxTransport &operator=(const XdpRxTransport &);
+        int LoadProgram(const struct ibv_pkt_info * pkt_info);
+        int ArmSlots();
+        int FillPush(uint64_t addr);
+
+        int fd;
+        int map_fd;
+        int prog_fd;
+        int link_fd;
+        unsigned int ifindex;
+        unsigned int queue_id;
+        unsigned int pkt_size;
+        unsigned int batch;
+        bool zero_copy;
+
+        // UMEM：零拷贝时就是 PSRDADA ring，否则为内部缓冲
+        char * umem;
+        uint64_t umem_len;
+        bool umem_owned;
+        uint32_t frame_size;
+
+        // fill / rx ring（内核共享的生产者/消费者队列）
+        uint32_t ring_size;
+        void * fill_map;
+        size_t fill_map_len;
+        uint32_t * fill_prod;
+        uint32_t * fill_cons;
+        uint32_t * fill_flags;
+        uint64_t * fill_desc;
+        void * rx_map;
+        size_t rx_map_len;
+        uint32_t * rx_prod;
+        uint32_t * rx_cons;
+        struct xdp_desc * rx_desc;
+
+        char * block_begin;  // 当前 block 中待接收的范围
+        char * block_end;
+        char * armed_end;    // [block_begin, armed_end) 已挂到 fill ring
+        uint64_t bounce_slot;   // 借给 UMEM 开头 slot 接收的 slot 偏移，bounce 帧拷回前不挂载；UINT64_MAX 表示没有
+        uint64_t misplaced;  // 未落在预期 slot、需要补拷贝的帧
+};
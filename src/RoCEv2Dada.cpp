@@ -5,11 +5,31 @@
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <errno.h>
 #include <stdio.h>
+#include <arpa/inet.h>
 
 #include "RoCEv2Dada.h"
 #include "ibv_utils.h"
+#include "ibv_rc.h"
 #include "pkt_gen.h"
+#include "ibv_transport.h"
+#include "udp_transport.h"
+#include "xdp_transport.h"
+#include "pcap_transport.h"
+#include "rx_shard.h"
+#include "rx_merge.h"
+#include "rx_stream.h"
+#include "rx_assemble.h"
+#include "rx_compact.h"
+#include "rx_subset.h"
+#include "rx_idle.h"
+#include "rx_numa.h"
+#include "rx_thread.h"
+#include "rx_engine.h"
+#ifndef NO_DPDK
+#include "dpdk_transport.h"
+#endif
 
 #ifndef NO_CUDA
 #include <cuda_runtime.h>
@@ -77,6 +97,23 @@ static int check_send_recv_info(struct ibv_utils_res * ibv_res_ptr, RoCEv2Dada::
     return 0;
 }
 
+// stream_fill 拆分批次时在中转缓冲和 block 之间拷贝，GPU 缓冲由 cudaMemcpy 判断方向
+static void stage_copy(char * dst, const char * src, long int bytes, int RdmaDirectGpu)
+{
+    if (RdmaDirectGpu != 0) {
+        CUDA_CALL(cudaMemcpy(dst, src, bytes, cudaMemcpyDefault));
+    } else {
+        memcpy(dst, src, bytes);
+    }
+}
+
+// 缓冲池模式平时挂着的接收缓冲数：pool_kb 能放下的包数，至少 1 个
+static unsigned int pool_working_set(const RoCEv2Dada::RdmaParam * param)
+{
+    uint64_t n = (uint64_t)param->pool_kb * 1024 / (param->pkt_size + PKT_HEAD_LEN);
+    return n > 0 ? (unsigned int)n : 1;
+}
+
 static int post_direct_recvs(struct ibv_utils_res *ibv_res_ptr, int recv_num)
 {
     for (int i = 0; i < recv_num; i++) {
@@ -106,6 +143,125 @@ static int ib_send_pkg(struct ibv_utils_res * ibv_res, int send_idx, int send_nu
     return 0;
 }
 
+// 额外的接收 QP：建 QP/CQ 和内部缓冲，装 flow 规则并投递接收 WR
+static int setup_verbs_rx(struct ibv_utils_res * res, int work_num)
+{
+    if (create_ib_res(res, 0, work_num) < 0) return -1;
+    if (init_ib_res(res) < 0) return -2;
+    uint32_t buf_size = (res->pkt_size + PKT_HEAD_LEN) * work_num;
+    res->mem_buf = (unsigned char *)malloc(buf_size);
+    if (!res->mem_buf || register_memory(res, res->mem_buf, buf_size, res->pkt_size + PKT_HEAD_LEN) < 0) return -3;
+    // 没有 flow 规则就无法把流量分到各 QP
+    if (create_flow(res, &res->pkt_info) < 0) return -4;
+    if (post_direct_recvs(res, work_num) < 0) return -5;
+    return 0;
+}
+
+// verbs 额外分片：共用设备和 PD，各自的 QP/CQ/内部缓冲，按源端口区分的 flow 规则把流量分到本 QP
+static int open_verbs_shard(struct ibv_utils_res * main_res, struct ibv_utils_res * res, int work_num, uint16_t src_port)
+{
+    memset(res, 0, sizeof(*res));
+    res->dev = main_res->dev;
+    res->context = main_res->context;
+    res->pd = main_res->pd;
+    res->recv_nsge = main_res->recv_nsge;
+    res->send_nsge = main_res->send_nsge;
+    res->pkt_size = main_res->pkt_size;
+    res->poll_n = main_res->poll_n;
+    res->pkt_info = main_res->pkt_info;
+    res->pkt_info.src_port = src_port;
+    res->mcast_fd = -1;
+    return setup_verbs_rx(res, work_num);
+}
+
+// 多网卡聚合的额外链路：单独打开设备，装与主 QP 相同的 flow 规则
+static int open_verbs_link(struct ibv_utils_res * main_res, struct ibv_utils_res * res, int work_num, int device_id)
+{
+    memset(res, 0, sizeof(*res));
+    res->mcast_fd = -1;
+    if (open_ib_device((uint8_t)device_id, res) < 0) return -6;
+    res->recv_nsge = main_res->recv_nsge;
+    res->send_nsge = main_res->send_nsge;
+    res->pkt_size = main_res->pkt_size;
+    res->poll_n = main_res->poll_n;
+    res->pkt_info = main_res->pkt_info;
+    return setup_verbs_rx(res, work_num);
+}
+
+// 逗号分隔的列表中的项数
+static unsigned int count_list(const char * list)
+{
+    unsigned int n = 0;
+    bool item = false;
+    for (const char * c = list; *c; c++) {
+        if (*c == ',') item = false;
+        else if (!item) { item = true; n++; }
+    }
+    return n;
+}
+
+// 接收模式之间的兼容性：所有互相冲突或不起作用的参数组合都在这里拒绝，构造函数、SetDirectMr/SetDirectBlockMrs
+// （启用 DirectToRing）和 AddStream（nstreams 为加上新一路后的路数）各调用一次，失败时不改变任何状态
+int RoCEv2Dada::ValidateParam(unsigned int nstreams) const
+{
+    const RdmaParam & p = this->param;
+    if (p.SendOrRecv) return RDMA_OK;
+    const char * why = NULL;   // 拒绝的原因，%d 处填 limit
+    int limit = 0;
+    bool verbs = p.transport == RX_TRANSPORT_VERBS;
+    bool direct = verbs && p.DirectToRing;
+    unsigned int links = strlen(p.Devices) > 0 ? count_list(p.Devices) : 1;
+    unsigned int listed = count_list(p.Sources);
+    bool assemble = listed > 0 || p.source_id_offset > 0 || p.seq_place;
+    unsigned int nsources = p.seq_place ? 1 : (p.source_id_offset == 0 ? listed : p.nsources);
+    bool multi = p.nshards > 1 || links > 1 || assemble || p.compact || nstreams > 1;  // 接收线程不是 SendRecvThread
+
+    if (p.nshards > RX_MAX_SHARDS) {
+        why = "nshards exceeds %d"; limit = RX_MAX_SHARDS;
+    } else if (p.nshards > 1 && !(verbs && !direct) && p.transport != RX_TRANSPORT_UDP) {
+        why = "sharded receive needs the verbs copy path or the udp transport";
+    } else if (links > RX_MAX_LINKS) {
+        why = "at most %d devices can be aggregated"; limit = RX_MAX_LINKS;
+    } else if (links > 1 && (!verbs || direct || p.nshards > 1)) {
+        why = "device aggregation needs the verbs copy path without sharding";
+    } else if (listed > RX_MAX_SOURCES) {
+        why = "at most %d sources can be assembled"; limit = RX_MAX_SOURCES;
+    } else if (p.seq_place && (listed > 0 || p.source_id_offset > 0)) {
+        why = "sequence placement is for a single flow, use --sources to assemble several";
+    } else if (assemble && (nsources == 0 || nsources > RX_MAX_SOURCES || p.source_id_offset + 2 > p.pkt_size)) {
+        why = "frame assembly needs 1..%d sources and an id field inside the packet"; limit = RX_MAX_SOURCES;
+    } else if (assemble && (!verbs || direct || p.nshards > 1 || links > 1)) {
+        why = "frame assembly needs the verbs copy path without sharding or aggregation";
+    } else if (p.compact && (!verbs || direct || p.nshards > 1 || links > 1 || assemble || p.RdmaDirectGpu != 0)) {
+        why = "compacted placement needs the verbs copy path in host memory without sharding, aggregation or assembly";
+    } else if (p.stream_fill && (multi || direct || p.transport == RX_TRANSPORT_RC)) {
+        why = "byte-stream filling needs the single-thread copy path without sharding, aggregation, assembly, compaction or streams";
+    } else if ((p.stream_fill || p.nant > 0) && p.transport == RX_TRANSPORT_XDP && p.RingBase) {
+        why = "the zero-copy XDP UMEM cannot be received through a staging buffer (stream filling, subset extraction)";
+    } else if (p.nant > 0 && (multi || p.stream_fill || p.RdmaDirectGpu != 0 || p.transport == RX_TRANSPORT_RC)) {
+        why = "subset extraction needs the single-thread receive path in host memory without sharding, aggregation, assembly, compaction, streams or stream filling";
+    } else if (p.split_header && (!verbs || multi || p.stream_fill || p.RdmaDirectGpu != 0)) {
+        why = "split_header needs DirectToRing on the single-thread verbs receive path in host memory (no sharding, aggregation, assembly, compaction, streams or stream filling)";
+    } else if (p.idle_us > 0 && (!verbs || multi)) {
+        why = "idle sleeping needs the single-QP verbs receive thread";
+    } else if (p.pool_kb > 0 && (!verbs || direct || p.RdmaDirectGpu != 0 || links > 1 || assemble || p.compact)) {
+        why = "the buffer pool needs the verbs copy path in host memory";
+    } else if (nstreams > RX_MAX_STREAMS) {
+        why = "at most %d streams per process"; limit = RX_MAX_STREAMS;
+    } else if (nstreams > 1 && ((!verbs && p.transport != RX_TRANSPORT_UDP) || direct || p.nshards > 1 || links > 1
+                                || assemble || p.compact || p.stream_fill || p.nant > 0)) {
+        why = "extra streams need the verbs copy path or the udp transport without sharding, aggregation, assembly, compaction, stream filling or subsets";
+    }
+    if (why) {
+        printf("[RoCEv2Dada] ERROR: ");
+        printf(why, limit);
+        printf("\n");
+        fflush(stdout);
+        return RDMA_ERROR;
+    }
+    return RDMA_OK;
+}
+
 RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
 {
     printf("[RoCEv2Dada] Constructor started\n");
@@ -113,6 +269,25 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
     uint8_t tmp[4];
     int ret = 0;
     memcpy(&this->param, &Param, sizeof(Param));
+    this->transport = NULL;
+    this->rc_sock = -1;
+    this->shards = NULL;
+    this->shard_res = NULL;
+    this->merge = NULL;
+    this->merge_res = NULL;
+    this->nlinks = 1;
+    this->streams = NULL;
+    this->stream_res = NULL;
+    this->assembler = NULL;
+    this->compactor = NULL;
+    this->direct = NULL;
+    this->sink = NULL;
+    this->finished = false;
+    this->stop = false;
+    this->started = false;
+    this->stage = NULL;
+    this->subset = NULL;
+    this->numa_node = this->param.numa_node >= 0 ? this->param.numa_node : -1;
     struct ibv_utils_res * ibv_res_ptr = (struct ibv_utils_res *)malloc(sizeof(struct ibv_utils_res));
     this->ibv_res = (void *)ibv_res_ptr;
     memset(ibv_res_ptr, 0, sizeof(struct ibv_utils_res));
@@ -133,6 +308,21 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
                                &ibv_res_ptr->pkt_info.dst_mac[4], &ibv_res_ptr->pkt_info.dst_mac[5]);
     sscanf(this->param.src_port, "%hd", &ibv_res_ptr->pkt_info.src_port);
     sscanf(this->param.dst_port, "%hd", &ibv_res_ptr->pkt_info.dst_port);
+    ibv_res_ptr->mcast_fd = -1;
+    
+    // 组播流：目的 MAC 由组地址决定，flow 规则、UDP/XDP 帧头都使用该 MAC
+    uint32_t mcast_if = htonl(INADDR_ANY);
+    bool mcast = ipv4_is_multicast(ibv_res_ptr->pkt_info.dst_ip);
+    if (mcast) {
+        if (strlen(this->param.McastIf) > 0 && inet_pton(AF_INET, this->param.McastIf, &mcast_if) != 1) {
+            printf("[RoCEv2Dada] Invalid multicast interface address %s\n", this->param.McastIf);
+            return;
+        }
+        ipv4_multicast_mac(ibv_res_ptr->pkt_info.dst_ip, ibv_res_ptr->pkt_info.dst_mac);
+        printf("[RoCEv2Dada] Multicast destination %s, dst_mac set to %02x:%02x:%02x:%02x:%02x:%02x\n", this->param.DAddr,
+               ibv_res_ptr->pkt_info.dst_mac[0], ibv_res_ptr->pkt_info.dst_mac[1], ibv_res_ptr->pkt_info.dst_mac[2],
+               ibv_res_ptr->pkt_info.dst_mac[3], ibv_res_ptr->pkt_info.dst_mac[4], ibv_res_ptr->pkt_info.dst_mac[5]);
+    }
     
     printf("[RoCEv2Dada] Network params parsed: %d.%d.%d.%d:%d -> %d.%d.%d.%d:%d\n",
            tmp[0], tmp[1], tmp[2], tmp[3], ibv_res_ptr->pkt_info.src_port,
@@ -140,18 +330,24 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
     fflush(stdout);
     
     ibv_res_ptr->pkt_size = Param.pkt_size;
-    ibv_res_ptr->poll_n = 8;
     ibv_res_ptr->recv_completed = 0;
     ibv_res_ptr->recv_sum_completed = 0;
+    ibv_res_ptr->wc_head = 0;
     ibv_res_ptr->recv_sum = 0;
     
     // Calculate work queue depth
-    // DirectToRing mode: use send_n (one batch worth of WRs)
+    // DirectToRing mode: WRs are recycled across the whole block, the pool only has to cover
+    //   send_n packets per pipelined block (direct_depth blocks armed at once), capped like the copy path
     // Normal mode: use smaller queue depth (typical NIC limit is ~16K)
     //   We only need enough to keep pipeline full - use send_n or 8192, whichever is smaller
     int work_num;
+    if (this->param.direct_depth == 0) this->param.direct_depth = 2;
+    if (this->param.direct_depth > DIRECT_MAX_DEPTH) this->param.direct_depth = DIRECT_MAX_DEPTH;
+    if (this->param.nshards == 0) this->param.nshards = 1;
+    if (ValidateParam(1) < 0) return;
     if (!this->param.SendOrRecv && this->param.DirectToRing) {
-        work_num = this->param.send_n;
+        work_num = this->param.send_n * this->param.direct_depth;
+        if (work_num > 8192) work_num = 8192;
     } else if (!this->param.SendOrRecv) {
         // Receiver with internal buffer: limit queue depth to reasonable size
         work_num = (this->param.send_n < 2048) ? (this->param.send_n * 4) : 8192;
@@ -161,8 +357,183 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
     }
     printf("[RoCEv2Dada] Configured work_num=%d (DirectToRing=%d, send_n=%d)\n", 
            work_num, this->param.DirectToRing, this->param.send_n);
+    // 一次 poll 取回的完成数：wc 数组按 WR 数分配，不能超过它
+    ibv_res_ptr->poll_n = this->param.poll_n ? this->param.poll_n : 8;
+    if (ibv_res_ptr->poll_n > (unsigned int)work_num) ibv_res_ptr->poll_n = (unsigned int)work_num;
     fflush(stdout);
     
+    // 多网卡聚合：第一个设备代替 device_id 作为主设备
+    int link_dev[RX_MAX_LINKS];
+    if (!this->param.SendOrRecv && strlen(this->param.Devices) > 0) {
+        char list[64];
+        char * save = NULL;
+        strncpy(list, this->param.Devices, sizeof(list) - 1);
+        list[sizeof(list) - 1] = '\0';
+        this->nlinks = 0;
+        // 项数已由 ValidateParam 检查
+        for (char * tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+            link_dev[this->nlinks++] = atoi(tok);
+        }
+        if (this->nlinks == 0) this->nlinks = 1;
+        else this->param.device_id = (unsigned char)link_dev[0];
+    }
+    
+    // 多源拼帧：列出的每个源一条 flow 规则（源 MAC 不限），都挂在主 QP 上
+    uint32_t source_ip[RX_MAX_SOURCES];
+    uint16_t source_port[RX_MAX_SOURCES];
+    unsigned int nlisted = 0;
+    bool assemble = !this->param.SendOrRecv && (strlen(this->param.Sources) > 0 || this->param.source_id_offset > 0
+                                                || this->param.seq_place);
+    if (assemble) {
+        char list[256];
+        char * save = NULL;
+        strncpy(list, this->param.Sources, sizeof(list) - 1);
+        list[sizeof(list) - 1] = '\0';
+        for (char * tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+            char * colon = strchr(tok, ':');
+            if (colon) *colon = '\0';
+            if (inet_pton(AF_INET, tok, &source_ip[nlisted]) != 1) {
+                printf("[RoCEv2Dada] ERROR: invalid source address %s\n", tok);
+                return;
+            }
+            source_port[nlisted++] = colon ? (uint16_t)atoi(colon + 1) : 0;
+        }
+        if (this->param.seq_place) this->param.nsources = 1;
+        else if (this->param.source_id_offset == 0) this->param.nsources = nlisted;
+    }
+    
+    // 变长包：帧按 byte_len 压缩放置，只用于 verbs 拷贝路径（内部缓冲在主机内存）
+    bool compact = !this->param.SendOrRecv && this->param.compact;
+    
+    // 缓冲池：平时挂着的缓冲按 LLC 预算而不是批次大小决定，完成的包立即拷走，
+    // 挂着的缓冲（网卡 DMA 的工作集）留在 DDIO 可写的那部分 LLC 中；另有 pool_burst 个缓冲留在空闲栈里，突发时才挂上
+    unsigned int pool = 0;
+    if (!this->param.SendOrRecv && this->param.pool_kb > 0) {
+        unsigned int slot = this->param.pkt_size + PKT_HEAD_LEN;
+        unsigned int burst = this->param.pool_burst ? this->param.pool_burst : 256;
+        pool = pool_working_set(&this->param);
+        if (pool > 4096) pool = 4096;
+        if (pool + burst > 8192) burst = 8192 - pool;
+        work_num = (int)(pool + burst);
+        if (ibv_res_ptr->poll_n > pool) ibv_res_ptr->poll_n = pool;
+        printf("[RoCEv2Dada] Buffer pool: %u receive buffers posted (%lu KB working set), %u more held back for bursts\n",
+               pool, (unsigned long)((uint64_t)pool * slot / 1024), burst);
+    }
+    
+    // 天线/通道子集抽取：DirectToRing 时由 SGE 在 DMA 时丢弃不要的字节，否则拷贝时逐包聚合
+    if (!this->param.SendOrRecv && this->param.nant > 0) {
+        this->subset = new RxSubset();
+        if (this->subset->Init(&this->param) < 0) return;
+        printf("[RoCEv2Dada] Keeping antennas %u..%u and channels %u..%u: %u of %u bytes per packet\n",
+               this->param.ant_first, this->param.ant_first + this->param.ant_count - 1, this->param.chan_first,
+               this->param.chan_first + this->param.chan_count - 1, this->subset->OutLen(), this->param.pkt_size);
+    }
+    
+    // 内核 UDP socket 后端：不需要打开 IB 设备
+    if (!this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_UDP) {
+        printf("[RoCEv2Dada] Opening UDP socket transport...\n");
+        fflush(stdout);
+        if (this->param.nshards > 1) {
+            // 每个分片一个 socket，connect 到 src_port + i，内核按源端口把数据报分给各分片
+            this->shards = new RxShardGroup(&this->param, this->param.nshards);
+            for (unsigned int i = 0; i < this->param.nshards; i++) {
+                struct ibv_pkt_info info = ibv_res_ptr->pkt_info;
+                info.src_port = (uint16_t)(info.src_port + i);
+                UdpRxTransport * udp = new UdpRxTransport();
+                this->shards->SetShard(i, udp);
+                ret = udp->Open(&info, this->param.pkt_size, this->param.send_n, this->param.udp_gro, mcast_if);
+                if (ret < 0) { printf("Failed to open UDP transport for shard %u.\n", i); fflush(stdout); return; }
+            }
+        } else {
+            UdpRxTransport * udp = new UdpRxTransport();
+            this->transport = udp;
+            ret = udp->Open(&ibv_res_ptr->pkt_info, this->param.pkt_size, this->param.send_n, this->param.udp_gro, mcast_if);
+            if (ret < 0) { printf("Failed to open UDP transport.\n"); fflush(stdout); return; }
+        }
+        ret = check_send_recv_info(ibv_res_ptr, &this->param);
+        if (ret >= 0) {
+            printf("[RoCEv2Dada] ✓ Initialization complete (transport=udp, %u shard(s)), ready to start\n",
+                   this->shards ? this->param.nshards : 1);
+            ibv_res_ptr->init_flag = true;
+        } else {
+            printf("RoCEv2Dada ERROE: check_send_recv_info is failed!\n");
+        }
+        return;
+    }
+    
+    // DPDK 后端：端口由 EAL 接管，不经过 ibverbs
+    if (!this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_DPDK) {
+#ifndef NO_DPDK
+        printf("[RoCEv2Dada] Opening DPDK transport on port %u (%u queue(s))...\n", this->param.dpdk_port, this->param.dpdk_queues);
+        fflush(stdout);
+        DpdkRxTransport * dpdk = new DpdkRxTransport();
+        this->transport = dpdk;
+        ret = dpdk->Open(this->param.DpdkEal, (uint16_t)this->param.dpdk_port, this->param.dpdk_queues,
+                         &ibv_res_ptr->pkt_info, this->param.pkt_size, this->param.send_n);
+        if (ret < 0) { printf("Failed to open DPDK transport.\n"); fflush(stdout); return; }
+        ret = check_send_recv_info(ibv_res_ptr, &this->param);
+        if (ret >= 0) {
+            printf("[RoCEv2Dada] ✓ Initialization complete (transport=%s), ready to start\n", this->transport->Name());
+            ibv_res_ptr->init_flag = true;
+        } else {
+            printf("RoCEv2Dada ERROE: check_send_recv_info is failed!\n");
+        }
+#else
+        printf("RoCEv2Dada error: built without DPDK support (configure with -DUSE_DPDK=ON).\n");
+        fflush(stdout);
+#endif
+        return;
+    }
+    
+    // pcap 回放后端：用抓包文件代替网卡，走完整的接收流水线
+    if (!this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_PCAP) {
+        printf("[RoCEv2Dada] Opening pcap replay transport (%s)...\n", this->param.PcapFile);
+        fflush(stdout);
+        PcapRxTransport * pcap = new PcapRxTransport();
+        this->transport = pcap;
+        ret = pcap->Open(this->param.PcapFile, &ibv_res_ptr->pkt_info, this->param.pkt_size,
+                         this->param.replay_mode, this->param.replay_gbps, this->param.replay_loop);
+        if (ret < 0) { printf("Failed to open pcap transport.\n"); fflush(stdout); return; }
+        ret = check_send_recv_info(ibv_res_ptr, &this->param);
+        if (ret >= 0) {
+            printf("[RoCEv2Dada] ✓ Initialization complete (transport=%s), ready to start\n", this->transport->Name());
+            ibv_res_ptr->init_flag = true;
+        } else {
+            printf("RoCEv2Dada ERROE: check_send_recv_info is failed!\n");
+        }
+        return;
+    }
+    
+    // AF_XDP 后端：同样绕开 ibverbs，UMEM 优先使用 PSRDADA ring 本身
+    if (!this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_XDP) {
+        printf("[RoCEv2Dada] Opening AF_XDP transport on %s queue %u...\n", this->param.IfName, this->param.rx_queue);
+        fflush(stdout);
+        if (this->param.numa_node == RX_NUMA_AUTO) {
+            this->numa_node = rx_numa_node_of_netdev(this->param.IfName);
+            if (this->numa_node >= 0) printf("[RoCEv2Dada] %s is on NUMA node %d\n", this->param.IfName, this->numa_node);
+        }
+        RxNumaScope numa_scope(this->numa_node);  // 内部 UMEM（ring 不连续时）落在网卡节点上
+        XdpRxTransport * xdp = new XdpRxTransport();
+        this->transport = xdp;
+        ret = xdp->Open(this->param.IfName, this->param.rx_queue, this->param.xdp_skb_mode,
+                        &ibv_res_ptr->pkt_info, this->param.pkt_size, this->param.send_n,
+                        this->param.RingBase, this->param.RingBytes);
+        if (ret < 0) { printf("Failed to open XDP transport.\n"); fflush(stdout); return; }
+        if (mcast) {
+            // XDP 程序在协议栈之前取走包，但网卡的组播过滤和交换机的 IGMP snooping 仍需要内核加入组
+            ibv_res_ptr->mcast_fd = ipv4_mcast_join(-1, ibv_res_ptr->pkt_info.dst_ip, mcast_if);
+            if (ibv_res_ptr->mcast_fd < 0) { printf("Failed to join multicast group.\n"); fflush(stdout); return; }
+        }
+        ret = check_send_recv_info(ibv_res_ptr, &this->param);
+        if (ret >= 0) {
+            printf("[RoCEv2Dada] ✓ Initialization complete (transport=%s), ready to start\n", this->transport->Name());
+            ibv_res_ptr->init_flag = true;
+        } else {
+            printf("RoCEv2Dada ERROE: check_send_recv_info is failed!\n");
+        }
+        return;
+    }
+    
 #ifndef NO_CUDA
     printf("[RoCEv2Dada] Setting CUDA device %d...\n", this->param.gpu_id);
     fflush(stdout);
@@ -178,10 +549,37 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
     printf("Open IB device successfully.\n");
     fflush(stdout);
     
+    // NUMA 放置：之后的 verbs 资源（QP/CQ 队列、WR/SGE/WC 数组）和内部缓冲都优先分配在网卡所在节点
+    if (this->param.numa_node == RX_NUMA_AUTO) {
+        const char * ibdev = ibv_get_device_name(ibv_res_ptr->dev);
+        this->numa_node = rx_numa_node_of_ibdev(ibdev);
+        if (this->numa_node >= 0) printf("[RoCEv2Dada] %s is on NUMA node %d\n", ibdev, this->numa_node);
+        else printf("[RoCEv2Dada] NUMA node of %s unknown (single-node host?), placement skipped\n", ibdev);
+    }
+    RxNumaScope numa_scope(this->numa_node);
+    
+    // RC 单边写入：只建 QP 和 CQ，ring MR 由调用方注册后通过 SetDirectMr 传入，Start() 时与发送端建连
+    if (!this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_RC) {
+        printf("[RoCEv2Dada] Creating RC QP for RDMA WRITE-with-immediate ingest...\n");
+        fflush(stdout);
+        ret = create_rc_res(ibv_res_ptr, 0, RC_RECV_WR_NUM);
+        if (ret < 0) { printf("Failed to create RC resources.\n"); fflush(stdout); return; }
+        ret = check_send_recv_info(ibv_res_ptr, &this->param);
+        if (ret >= 0) {
+            printf("[RoCEv2Dada] ✓ Initialization complete (transport=rc), ready to start\n");
+            ibv_res_ptr->init_flag = true;
+        } else {
+            printf("RoCEv2Dada ERROE: check_send_recv_info is failed!\n");
+        }
+        return;
+    }
+    
     printf("[RoCEv2Dada] Creating IB resources... (SendOrRecv=%d)\n", this->param.SendOrRecv);
     fflush(stdout);
     unsigned int nsge = this->param.nsge ? this->param.nsge : 4;
     ibv_res_ptr->recv_nsge = nsge;
+    // 空闲时睡眠只用于主 QP 的接收线程（SendRecvThread）
+    ibv_res_ptr->cq_events = !this->param.SendOrRecv && this->param.idle_us > 0;
     ibv_res_ptr->send_nsge = nsge;
     if(this->param.SendOrRecv) {
         ret = create_ib_res(ibv_res_ptr, work_num, 0);
@@ -222,6 +620,11 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
 #else
             ibv_res_ptr->mem_buf = (unsigned char *)malloc(buf_size);
 #endif
+        } else if (this->numa_node >= 0) {
+            bool huge = false;
+            ibv_res_ptr->mem_buf = (unsigned char *)rx_numa_alloc(buf_size, this->numa_node, &ibv_res_ptr->mem_buf_bytes, &huge);
+            if (!ibv_res_ptr->mem_buf) { printf("Failed to allocate %u bytes on NUMA node %d.\n", buf_size, this->numa_node); fflush(stdout); return; }
+            printf("[RoCEv2Dada] Internal buffer on NUMA node %d (%s pages)\n", this->numa_node, huge ? "2 MB huge" : "4 KB/THP");
         } else {
             ibv_res_ptr->mem_buf = (unsigned char *)malloc(buf_size);
         }
@@ -249,7 +652,23 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
         ret = ib_send_pkg(ibv_res_ptr, 0, work_num);
         if (ret < 0) { printf("Failed to send pkts.\n"); return; }
     } else {
-        ret = create_flow(ibv_res_ptr, &ibv_res_ptr->pkt_info);
+        if (mcast) {
+            // RAW_PACKET QP 收不到 IGMP，由内核 socket 代为加入组播组
+            ibv_res_ptr->mcast_fd = ipv4_mcast_join(-1, ibv_res_ptr->pkt_info.dst_ip, mcast_if);
+            if (ibv_res_ptr->mcast_fd < 0) { printf("Failed to join multicast group.\n"); fflush(stdout); return; }
+        }
+        if (nlisted > 0) {
+            ret = 0;
+            for (unsigned int i = 0; i < nlisted && ret >= 0; i++) {
+                struct ibv_pkt_info info = ibv_res_ptr->pkt_info;
+                memset(info.src_mac, 0, sizeof(info.src_mac));
+                info.src_ip = source_ip[i];
+                info.src_port = source_port[i];
+                ret = create_flow(ibv_res_ptr, &info);
+            }
+        } else {
+            ret = create_flow(ibv_res_ptr, &ibv_res_ptr->pkt_info);
+        }
         if (ret < 0) { 
             printf("========================================\n");
             printf("⚠️  WARNING: Flow Steering Failed\n");
@@ -261,14 +680,26 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
             printf("\n");
             printf("📌 CONTINUING WITHOUT FLOW STEERING\n");
             printf("   The NIC will receive ALL packets (promiscuous mode)\n");
-            printf("   You must filter by MAC/IP/Port in software.\n");
-            printf("   Performance may be lower but functionality preserved.\n");
+            if (this->param.RdmaDirectGpu > 0) {
+                // 内部缓冲在显存中，CPU 无法检查帧头
+                printf("   RdmaDirectGpu buffers are in GPU memory: software filter unavailable,\n");
+                printf("   stray frames WILL end up in the ring.\n");
+            } else {
+                // 与 flow 规则相同的元组在软件中逐批比较，不匹配的帧立即重新投递，不计入 send_n
+                ibv_res_ptr->sw_filter = (struct ibv_pkt_filter *)malloc(sizeof(struct ibv_pkt_filter));
+                if (!ibv_res_ptr->sw_filter) { printf("Failed to allocate software filter.\n"); fflush(stdout); return; }
+                ibv_pkt_filter_init(ibv_res_ptr->sw_filter, &ibv_res_ptr->pkt_info);
+                printf("   Software filter enabled: frames not matching MAC/IP/Port are dropped.\n");
+            }
             printf("========================================\n");
-            // Continue without flow - will receive all packets on this QP
-            // Application must filter unwanted packets in software
         } else {
             printf("Create flow successfully.\n");
         }
+        if (ret < 0 && (this->param.nshards > 1 || this->nlinks > 1 || nlisted > 0)) {
+            printf("[RoCEv2Dada] ERROR: sharded/aggregated/assembled receive needs flow steering on every QP\n");
+            fflush(stdout);
+            return;
+        }
         
         printf("[RoCEv2Dada] Posting receive work requests... (work_num=%d)\n", work_num);
         if (!this->param.DirectToRing) {
@@ -296,6 +727,55 @@ RoCEv2Dada::RoCEv2Dada(const RdmaParam & Param)
             printf("  DirectToRing mode: skipping recv WR posting\n");
             fflush(stdout);
         }
+        this->transport = new IbvRxTransport(ibv_res_ptr, ibv_res_ptr->pkt_size, this->param.RdmaDirectGpu, pool);
+        if (this->param.nshards > 1) {
+            // 分片 0 使用上面建好的 QP，其余分片各建一个 QP，flow 规则匹配 src_port + i
+            printf("[RoCEv2Dada] Creating %u verbs shards (one QP per source port %u..%u)...\n", this->param.nshards,
+                   ibv_res_ptr->pkt_info.src_port, ibv_res_ptr->pkt_info.src_port + this->param.nshards - 1);
+            this->shards = new RxShardGroup(&this->param, this->param.nshards);
+            this->shards->SetShard(0, this->transport);
+            this->transport = NULL;
+            struct ibv_utils_res * extra = (struct ibv_utils_res *)calloc(this->param.nshards - 1, sizeof(struct ibv_utils_res));
+            this->shard_res = extra;
+            for (unsigned int i = 1; i < this->param.nshards; i++) {
+                ret = open_verbs_shard(ibv_res_ptr, &extra[i - 1], work_num, (uint16_t)(ibv_res_ptr->pkt_info.src_port + i));
+                if (ret < 0) { printf("Failed to create verbs shard %u (%d).\n", i, ret); fflush(stdout); return; }
+                this->shards->SetShard(i, new IbvRxTransport(&extra[i - 1], extra[i - 1].pkt_size, 0, pool));
+            }
+        }
+        if (this->nlinks > 1) {
+            // 链路 0 使用上面建好的 QP，其余设备各建一个 QP，包由 RxMergeGroup 按序号直接放进 block
+            printf("[RoCEv2Dada] Aggregating %u devices (%s) into one ring...\n", this->nlinks, this->param.Devices);
+            delete this->transport;
+            this->transport = NULL;
+            this->merge = new RxMergeGroup(&this->param, this->nlinks);
+            this->merge->SetLink(0, ibv_res_ptr);
+            struct ibv_utils_res * extra = (struct ibv_utils_res *)calloc(this->nlinks - 1, sizeof(struct ibv_utils_res));
+            this->merge_res = extra;
+            for (unsigned int i = 1; i < this->nlinks; i++) {
+                ret = open_verbs_link(ibv_res_ptr, &extra[i - 1], work_num, link_dev[i]);
+                if (ret < 0) { printf("Failed to open device %d for link %u (%d).\n", link_dev[i], i, ret); fflush(stdout); return; }
+                this->merge->SetLink(i, &extra[i - 1]);
+            }
+        }
+        if (assemble) {
+            // 包由 RxAssembler 按 (源, 序号) 直接放进 block
+            if (this->param.seq_place) printf("[RoCEv2Dada] Placing packets by sequence number...\n");
+            else printf("[RoCEv2Dada] Assembling %u sources into fixed block regions...\n", this->param.nsources);
+            delete this->transport;
+            this->transport = NULL;
+            this->assembler = new RxAssembler(&this->param, ibv_res_ptr, this->param.nsources);
+            for (unsigned int i = 0; i < nlisted && i < this->param.nsources; i++) {
+                this->assembler->SetSource(i, source_ip[i], source_port[i]);
+            }
+        }
+        if (compact) {
+            // 帧由 RxCompactor 按 byte_len 首尾相接地放进 block
+            printf("[RoCEv2Dada] Packing variable-length frames (up to %u bytes) back-to-back...\n", this->param.pkt_size);
+            delete this->transport;
+            this->transport = NULL;
+            this->compactor = new RxCompactor(&this->param, ibv_res_ptr);
+        }
     }
     
     printf("[RoCEv2Dada] Checking send/recv info...\n");
@@ -326,28 +806,67 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
     struct timespec ts_now;
     uint64_t ns_elapsed;
     long int block_bufsz = 0;
-    long int write_bufsz = 0;
+    long int write_bufsz = 0;       // 当前 block 取得时的大小
+    uint64_t total_pkts = 0;        // 启动以来收到的包数
     char * gpu_ibuf = NULL;
     char * cpu_data = NULL;
     // pkt_size already includes header (passed from run_demo.sh as PKT_HEADER+PKT_DATA)
     int pkt_len = ibv_res_ptr->pkt_size;
+    // 每个包在 block 中占的字节数：子集抽取时只有保留的字节
+    int blk_len = this_ptr->subset && this_ptr->subset->Active() ? (int)this_ptr->subset->OutLen() : pkt_len;
     int send_idx = 0;
+    unsigned int batch_filled = 0;  // 当前批次已收到的包数
+    uint32_t rc_block = 0;          // RC 模式当前发放 credit 的 block 序号
+    // stream_fill：中转缓冲中的 bytes 字节依次写入当前 block 的剩余部分和后面的 block，
+    // 批次比 block 还大时跨过多个 block；写满的 block 随即提交
+    auto spill = [&](const char * src, long int bytes) -> int {
+        while (bytes > 0) {
+            if (block_bufsz <= 0) {
+                gpu_ibuf = this_ptr->param.GetBuffPtr(block_bufsz);
+                if (!gpu_ibuf || block_bufsz <= 0) {
+                    printf("ERROR: SendRecvThread Failed to GetBuffPtr for the batch tail.gpu_ibuf: %p, block_bufsz:%ld\n", (void*)gpu_ibuf, block_bufsz);
+                    return -1;
+                }
+                write_bufsz = block_bufsz;
+            }
+            long int n = bytes < block_bufsz ? bytes : block_bufsz;
+            stage_copy(gpu_ibuf, src, n, this_ptr->param.RdmaDirectGpu);
+            gpu_ibuf += n;
+            block_bufsz -= n;
+            src += n;
+            bytes -= n;
+            if (block_bufsz == 0 && this_ptr->param.DataSendBuff() < 0) {
+                fprintf(stderr, "[ERROR] Failed to mark block as written\n");
+                return -1;
+            }
+        }
+        return 0;
+    };
     time_t rawtime;
     struct tm *timeinfo;
     char time_buffer[80];
     
     // 初始化时间戳，避免第一次计算时使用未初始化的值
     clock_gettime(CLOCK_MONOTONIC_RAW, &ts_start);
+    if (this_ptr->sink) {
+        // 特化的接收循环在 Stop() 置位 stop 后返回，出错时提前返回
+        if (rx_engine_run(ibv_res_ptr, this_ptr->sink, pkt_len, this_ptr->param.send_n, this_ptr->param.idle_us, &this_ptr->stop) < 0) {
+            printf("ERROR: SendRecvThread specialised receive loop failed.\n");
+        }
+        return NULL;
+    }
+    // idle_us > 0 时空闲睡眠等待完成事件（只有 verbs 主 QP 创建了完成通道）
+    RxIdle idle(ibv_res_ptr, this_ptr->param.idle_us);
     
     if (this_ptr->param.debug_mode) {
         printf("[DEBUG] Entering main receive loop...\n");
         fflush(stdout);
     }
     
-    while (1) {
-        pthread_testcancel();
+    while (!this_ptr->stop) {
         if(this_ptr->param.SendOrRecv) {
             while(total_recv_pre < this_ptr->param.send_n) {
+                if (this_ptr->stop) return NULL;
                 total_recv_pre += ibv_poll_cq(ibv_res_ptr->cq, ibv_res_ptr->poll_n, ibv_res_ptr->wc);
             }
             for(int k = 0; k < this_ptr->param.send_n; k++) {
@@ -361,48 +880,87 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
             if (ret < 0) { printf("Failed to send pkts.\n"); return NULL; }
         } else {
             // 接收模式
-            if (this_ptr->param.DirectToRing && ibv_res_ptr->mr) {
-                if (this_ptr->param.debug_mode) {
-                    printf("[DEBUG] Using DirectToRing path\n");
-                    fflush(stdout);
-                }
-                int recv_num = this_ptr->param.send_n;
-                // pkt_size already includes header
-                int pkt_len = ibv_res_ptr->pkt_size;
-                long int direct_bufsz = 0;
-                char *direct_base = NULL;
-
+            if (this_ptr->param.transport == RX_TRANSPORT_RC) {
+                // RC 模式：数据由发送端直接写入 block，这里只发放 credit 并等待 WRITE_WITH_IMM 完成
                 if (!ibv_res_ptr->recv_ready) {
-                    direct_base = this_ptr->param.GetBuffPtr(direct_bufsz);
-                    if (!direct_base || direct_bufsz < (long int)(recv_num * pkt_len)) {
-                        printf("ERROR: Direct recv buffer invalid.\n");
+                    gpu_ibuf = this_ptr->param.GetBuffPtr(block_bufsz);
+                    if (!gpu_ibuf || block_bufsz <= 0) {
+                        printf("ERROR: SendRecvThread Failed to GetBuffPtr.gpu_ibuf: %p, block_bufsz:%ld\n", (void*)gpu_ibuf, block_bufsz);
                         return NULL;
                     }
-                    for (int i = 0; i < recv_num; i++) {
-                        ibv_res_ptr->sge[i].addr = (uint64_t)(direct_base + i * pkt_len);
-                        ibv_res_ptr->sge[i].length = pkt_len;
-                        ibv_res_ptr->sge[i].lkey = ibv_res_ptr->mr->lkey;
-                    }
-                    if (post_direct_recvs(ibv_res_ptr, recv_num) < 0) {
-                        printf("ERROR: failed to post direct recv WRs.\n");
+                    rc_block = (uint32_t)((gpu_ibuf - (char *)ibv_res_ptr->mr->addr) / this_ptr->param.RingBlockBytes);
+                    if (rc_send_credit(this_ptr->rc_sock, rc_block) < 0) {
+                        printf("[RoCEv2Dada] RC sender disconnected, receive thread exits.\n");
                         return NULL;
                     }
                     ibv_res_ptr->recv_ready = true;
                 }
-
                 ibv_res_ptr->recv_completed = ibv_poll_cq(ibv_res_ptr->cq, ibv_res_ptr->poll_n, ibv_res_ptr->wc);
-                if (ibv_res_ptr->recv_completed > 0) {
-                    ibv_res_ptr->recv_sum_completed += ibv_res_ptr->recv_completed;
-                    if (ibv_res_ptr->recv_sum_completed >= recv_num) {
-                        ret = this_ptr->param.DataSendBuff();
-                        if (ret < 0) { printf("ERROR: Direct DataSendBuff failed.\n"); return NULL; }
-                        ibv_res_ptr->recv_sum_completed = 0;
-                        ibv_res_ptr->recv_ready = false;
+                for (int i = 0; i < ibv_res_ptr->recv_completed; i++) {
+                    struct ibv_wc *wc = &ibv_res_ptr->wc[i];
+                    if (wc->status != IBV_WC_SUCCESS) {
+                        printf("ERROR: RC completion failed: %s\n", ibv_wc_status_str(wc->status));
+                        return NULL;
+                    }
+                    if (wc->opcode != IBV_WC_RECV_RDMA_WITH_IMM) continue;
+                    // 补回被 WRITE_WITH_IMM 消耗的接收 WR
+                    ibv_res_ptr->recv_wr->wr_id = wc->wr_id;
+                    ibv_res_ptr->recv_wr->sg_list = NULL;
+                    ibv_res_ptr->recv_wr->num_sge = 0;
+                    ibv_res_ptr->recv_wr->next = NULL;
+                    if (ibv_post_recv(ibv_res_ptr->qp, ibv_res_ptr->recv_wr, &ibv_res_ptr->bad_recv_wr)) {
+                        printf("ERROR: failed to repost RC recv WR.\n");
+                        return NULL;
+                    }
+                    uint32_t imm_block = ntohl(wc->imm_data);
+                    if (!ibv_res_ptr->recv_ready || imm_block != rc_block) {
+                        printf("ERROR: RC write-with-imm for block %u, expected block %u.\n", imm_block, rc_block);
+                        return NULL;
                     }
-                } else if (ibv_res_ptr->recv_completed < 0) {
-                    printf("ERROR: SendRecvThread Failed to recv.\n");
+                    ret = this_ptr->param.DataSendBuff();
+                    if (ret < 0) { printf("ERROR: RC DataSendBuff failed.\n"); return NULL; }
+                    ibv_res_ptr->recv_ready = false;
+                    total_recv += block_bufsz;
+                }
+                if (ibv_res_ptr->recv_completed < 0) {
+                    printf("ERROR: SendRecvThread Failed to poll RC CQ.\n");
                     return NULL;
                 }
+                clock_gettime(CLOCK_MONOTONIC_RAW, &ts_now);
+                ns_elapsed = ELAPSED_US(ts_start, ts_now);
+                if (ns_elapsed > 1000 * 1000) {
+                    printf("[RoCEv2Dada] RC ingest: %lu MB, %.3f Gbps\n", (unsigned long)(total_recv / 1024 / 1024),
+                           MEASURE_BANDWIDTH(total_recv, ns_elapsed));
+                    ts_start = ts_now;
+                    total_recv = 0;
+                }
+                continue;
+            }
+
+            if (this_ptr->param.DirectToRing && this_ptr->direct) {
+                if (this_ptr->param.debug_mode) {
+                    printf("[DEBUG] Using DirectToRing path\n");
+                    fflush(stdout);
+                }
+                ret = this_ptr->direct->Poll();
+                if (ret < 0 || idle.After(ret) < 0) {
+                    printf("ERROR: SendRecvThread DirectToRing receive failed.\n");
+                    return NULL;
+                }
+                total_recv += ret;
+                clock_gettime(CLOCK_MONOTONIC_RAW, &ts_now);
+                ns_elapsed = ELAPSED_US(ts_start, ts_now);
+                if (ns_elapsed > 1000 * 1000) {
+                    printf("[RoCEv2Dada] DirectToRing: %.3f Gbps, %lu blocks, %lu error completions\n",
+                           MEASURE_BANDWIDTH(total_recv * pkt_len, ns_elapsed), (unsigned long)this_ptr->direct->Blocks(),
+                           (unsigned long)this_ptr->direct->Errors());
+                    if (ibv_res_ptr->sw_filter) {
+                        printf("[RoCEv2Dada] software filter: %lu frames rejected\n", (unsigned long)ibv_res_ptr->sw_rejected);
+                    }
+                    idle.Report("RoCEv2Dada");
+                    ts_start = ts_now;
+                    total_recv = 0;
+                }
                 continue;
             }
 
@@ -431,13 +989,20 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
                 } else {
                     printf("total_recv: %-10lu Bandwidth: 0 Gbps, cost time us_elapsed: %lu \n", (unsigned long)total_recv, (unsigned long)ns_elapsed);
                 }
+                if (ibv_res_ptr->sw_filter) {
+                    printf("[RoCEv2Dada] software filter: %lu frames rejected\n", (unsigned long)ibv_res_ptr->sw_rejected);
+                }
+                idle.Report("RoCEv2Dada");
             }
             
             // Calculate space needed for next batch
-            long int bytes_needed = (long int)(this_ptr->param.send_n * pkt_len);
+            long int bytes_needed = (long int)(this_ptr->param.send_n * blk_len);
+            bool stream_fill = this_ptr->stage && this_ptr->param.stream_fill;
+            bool gather = this_ptr->stage && !this_ptr->param.stream_fill;
             
             // Get new buffer if current buffer is empty OR insufficient for next batch
-            if(block_bufsz <= 0 || block_bufsz < bytes_needed) {
+            // （stream_fill 时放不下的批次跨到下一个 block，block 写满才取新 block）
+            if(block_bufsz <= 0 || (!stream_fill && block_bufsz < bytes_needed)) {
                 if (this_ptr->param.debug_mode && block_bufsz > 0 && block_bufsz < bytes_needed) {
                     printf("[DEBUG] Insufficient space (%ld < %ld), getting new block\n", 
                            block_bufsz, bytes_needed);
@@ -450,8 +1015,44 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
                     printf("ERROR: SendRecvThread Failed to GetBuffPtr.gpu_ibuf: %p, block_bufsz:%ld\n", (void*)gpu_ibuf, block_bufsz);
                     return NULL;
                 }
+                if(this_ptr->transport->BeginBlock(gpu_ibuf, block_bufsz / bytes_needed * bytes_needed) < 0) {
+                    printf("ERROR: SendRecvThread Failed to begin block (transport=%s).\n", this_ptr->transport->Name());
+                    return NULL;
+                }
+            }
+            // stream_fill：block 剩余不足一批时先收到中转缓冲，凑满后拆成 block 尾部和下一个 block 开头两段
+            bool straddle = stream_fill && block_bufsz < bytes_needed;
+            char * batch_dst = straddle || gather ? this_ptr->stage : gpu_ibuf;
+            ret = this_ptr->transport->Recv(batch_dst + (long int)batch_filled * pkt_len,
+                                            this_ptr->param.send_n - batch_filled);
+            // 批次未凑满时 Recv 返回 0，空闲与否看这次 poll 到的完成数
+            if (ret >= 0 && idle.After(ret > 0 ? ret : ibv_res_ptr->recv_completed) < 0) {
+                printf("ERROR: SendRecvThread Failed to wait for completions.\n");
+                return NULL;
+            }
+            
+            if (ret == 0 && this_ptr->transport->Finished()) {
+                // 数据源结束：未凑满的批次放进 block，block 未写到的部分清零后提交，线程退出
+                long int part = (long int)batch_filled * blk_len;
+                if (batch_filled > 0 && straddle) {
+                    if (spill(this_ptr->stage, part) < 0) return NULL;
+                } else if (batch_filled > 0) {
+                    if (gather) this_ptr->subset->Gather(gpu_ibuf, this_ptr->stage, batch_filled);
+                    gpu_ibuf += part;
+                    block_bufsz -= part;
+                }
+                if (gpu_ibuf && block_bufsz > 0 && block_bufsz < write_bufsz) {
+                    memset(gpu_ibuf, 0, block_bufsz);
+                    if (this_ptr->param.DataSendBuff() < 0) { fprintf(stderr, "[ERROR] Failed to mark block as written\n"); return NULL; }
+                    printf("[RoCEv2Dada] last block committed with %ld of %ld bytes, rest zero-filled\n",
+                           write_bufsz - block_bufsz, write_bufsz);
+                }
+                printf("[RoCEv2Dada] %s finished: %lu packets (%.1f MB) received\n", this_ptr->transport->Name(),
+                       (unsigned long)total_pkts, total_pkts * (double)blk_len / 1048576.0);
+                fflush(stdout);
+                this_ptr->finished = true;
+                return NULL;
             }
-            ibv_res_ptr->recv_completed = ibv_poll_cq(ibv_res_ptr->cq, ibv_res_ptr->poll_n, ibv_res_ptr->wc);
             
             // Debug polling info (only in debug mode)
             if (this_ptr->param.debug_mode) {
@@ -459,45 +1060,58 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
                 static int no_data_count = 0;
                 poll_count++;
                 
-                if (ibv_res_ptr->recv_completed == 0) {
+                if (ret == 0) {
                     no_data_count++;
                 } else {
                     no_data_count = 0;
                 }
                 
                 if (poll_count % 100000 == 0) {
-                    printf("[DEBUG] Polled %d times, last result: %d completions, sum=%d\n", 
-                           poll_count, ibv_res_ptr->recv_completed, ibv_res_ptr->recv_sum_completed);
+                    printf("[DEBUG] Polled %d times, last result: %d packets, sum=%u\n", 
+                           poll_count, ret, batch_filled);
                     fflush(stdout);
                 }
             }
             
-            if(ibv_res_ptr->recv_completed > 0) {
+            if(ret > 0) {
                 if (this_ptr->param.debug_mode) {
-                    printf("[DEBUG] Received %d completions (sum=%d/%d)\n", 
-                           ibv_res_ptr->recv_completed, ibv_res_ptr->recv_sum_completed, 
-                           this_ptr->param.send_n);
+                    printf("[DEBUG] Received %d packets (sum=%u/%d)\n", 
+                           ret, batch_filled, this_ptr->param.send_n);
                     fflush(stdout);
                 }
-                ibv_res_ptr->recv_sum_completed += ibv_res_ptr->recv_completed;
-            if(ibv_res_ptr->recv_sum_completed >= this_ptr->param.send_n) {
-                    // Batch complete, process data
+                batch_filled += ret;
+                total_pkts += ret;
+                if(batch_filled >= this_ptr->param.send_n) {
+                    // Batch complete, data is already in the block
                     if (this_ptr->param.debug_mode) {
-                        printf("[DEBUG] Processing batch: %d completions\n", this_ptr->param.send_n);
+                        printf("[DEBUG] Processing batch: %d packets\n", this_ptr->param.send_n);
                         fflush(stdout);
                     }
                     
-                    if(this_ptr->param.RdmaDirectGpu != 0) {
-                        CUDA_CALL(cudaMemcpy(gpu_ibuf,
-                                           (void *)ibv_res_ptr->sge[ibv_res_ptr->wc_tmp[0].wr_id*ibv_res_ptr->recv_nsge].addr,
-                                           this_ptr->param.send_n * pkt_len, cudaMemcpyDeviceToDevice));
-                    } else {
-                        memcpy(gpu_ibuf,
-                               (void *)ibv_res_ptr->sge[ibv_res_ptr->wc_tmp[0].wr_id*ibv_res_ptr->recv_nsge].addr,
-                               this_ptr->param.send_n * pkt_len);
-                    }
+                    uint64_t bytes_written = this_ptr->param.send_n * blk_len;
+                    if (gather) this_ptr->subset->Gather(gpu_ibuf, this_ptr->stage, this_ptr->param.send_n);
                     
-                    uint64_t bytes_written = this_ptr->param.send_n * pkt_len;
+                    if (stream_fill) {
+                        if (!straddle) {
+                            gpu_ibuf += bytes_needed;
+                            block_bufsz -= bytes_needed;
+                            if (block_bufsz == 0 && this_ptr->param.DataSendBuff() < 0) {
+                                fprintf(stderr, "[ERROR] Failed to mark block as written\n");
+                                return NULL;
+                            }
+                        } else {
+                            // 批次拆成 block 尾部和后面 block 的开头（批次比 block 大时中间的 block 整个写满）
+                            if (spill(this_ptr->stage, bytes_needed) < 0) return NULL;
+                            if (block_bufsz >= bytes_needed &&
+                                this_ptr->transport->BeginBlock(gpu_ibuf, block_bufsz / bytes_needed * bytes_needed) < 0) {
+                                printf("ERROR: SendRecvThread Failed to begin block (transport=%s).\n", this_ptr->transport->Name());
+                                return NULL;
+                            }
+                        }
+                        batch_filled = 0;
+                        total_recv += this_ptr->param.send_n;
+                        continue;
+                    }
                     
                     gpu_ibuf += bytes_written;
                     block_bufsz -= (long int)bytes_written;
@@ -523,22 +1137,11 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
                         // Reset block_bufsz to 0 to force getting a new block next iteration
                         block_bufsz = 0;
                     }
-                    for(int i = 0; i < this_ptr->param.send_n; i++) {
-                        ibv_res_ptr->recv_wr->wr_id = ibv_res_ptr->wc_tmp[i].wr_id;
-                        ibv_res_ptr->recv_wr->sg_list = &ibv_res_ptr->sge[ibv_res_ptr->wc_tmp[i].wr_id*ibv_res_ptr->recv_nsge];
-                        ibv_res_ptr->recv_wr->num_sge = ibv_res_ptr->recv_nsge;
-                        ibv_res_ptr->recv_wr->next = NULL;
-                        ibv_post_recv(ibv_res_ptr->qp, ibv_res_ptr->recv_wr, &ibv_res_ptr->bad_recv_wr);
-                    }
-                    ibv_res_ptr->recv_sum_completed -= this_ptr->param.send_n;
-                    memcpy(ibv_res_ptr->wc, ibv_res_ptr->wc_tmp + this_ptr->param.send_n,
-                           sizeof(struct ibv_wc) * (ibv_res_ptr->recv_sum_completed));
-                    memcpy(ibv_res_ptr->wc_tmp, ibv_res_ptr->wc,
-                           sizeof(struct ibv_wc) * (ibv_res_ptr->recv_sum_completed));
+                    batch_filled = 0;
                     total_recv += this_ptr->param.send_n;
                 }
-            } else if (ibv_res_ptr->recv_completed < 0) {
-                printf("ERROR: SendRecvThread Failed to recv.\n");
+            } else if (ret < 0) {
+                printf("ERROR: SendRecvThread Failed to recv (transport=%s).\n", this_ptr->transport->Name());
                 return NULL;
             }
         }
@@ -546,11 +1149,117 @@ void * RoCEv2Dada::SendRecvThread(void *arg)
     return NULL;
 }
 
+// 停掉所有接收线程：主线程和各组（分片、多链路、多路、拼帧、紧凑）的线程。
+// 接收线程每轮检查 stop，置位后最多再等一次 poll（空闲睡眠时 RX_IDLE_SLEEP_MS）；
+// 阻塞在 GetBuffPtr（ring 满、读端没有消费）时要等读端腾出 block 才能返回
+void RoCEv2Dada::Stop()
+{
+    this->stop = true;
+    if (this->started) {
+        struct ibv_utils_res * ibv_res_ptr = (struct ibv_utils_res *)this->ibv_res;
+        rx_thread_join(ibv_res_ptr->tid, &this->started);
+    }
+    if (this->shards) this->shards->Stop();
+    if (this->merge) this->merge->Stop();
+    if (this->streams) this->streams->Stop();
+    if (this->assembler) this->assembler->Stop();
+    if (this->compactor) this->compactor->Stop();
+}
+
 RoCEv2Dada::~RoCEv2Dada()
 {
+    // 接收线程用到下面释放的 transport、direct、sink、stage 和各组共用的 ibv 资源，先全部停掉再释放
+    Stop();
+    if(this->rc_sock >= 0) {
+        close(this->rc_sock);
+        this->rc_sock = -1;
+    }
+    if(this->shards) {
+        delete this->shards;
+        this->shards = NULL;
+    }
+    if(this->direct) {
+        printf("[RoCEv2Dada] DirectToRing: %lu blocks, %lu packets dropped from pre-start WRs\n",
+               (unsigned long)this->direct->Blocks(), (unsigned long)this->direct->Dropped());
+        delete this->direct;
+        this->direct = NULL;
+    }
+    if(this->sink) {
+        printf("[RoCEv2Dada] Specialised receive loop: %lu blocks written\n", (unsigned long)this->sink->Blocks());
+        delete this->sink;
+        this->sink = NULL;
+    }
+    if(this->assembler) {
+        delete this->assembler;
+        this->assembler = NULL;
+    }
+    if(this->compactor) {
+        delete this->compactor;
+        this->compactor = NULL;
+    }
+    if(this->streams) {
+        delete this->streams;  // 各路的 transport 随之释放
+        this->streams = NULL;
+    }
+    if(this->stream_res) {
+        struct ibv_utils_res * extra = (struct ibv_utils_res *)this->stream_res;
+        for (unsigned int i = 0; i + 1 < RX_MAX_STREAMS; i++) {
+            if (!extra[i].context) continue;
+            extra[i].pd = NULL;  // PD 和设备属于主 ibv_res
+            destroy_ib_res(&extra[i]);
+            free(extra[i].mem_buf);
+        }
+        free(extra);
+        this->stream_res = NULL;
+    }
+    if(this->merge) {
+        delete this->merge;
+        this->merge = NULL;
+    }
+    if(this->merge_res) {
+        struct ibv_utils_res * extra = (struct ibv_utils_res *)this->merge_res;
+        for (unsigned int i = 0; i + 1 < this->nlinks; i++) {
+            destroy_ib_res(&extra[i]);
+            close_ib_device(&extra[i]);
+            free(extra[i].mem_buf);
+        }
+        free(extra);
+        this->merge_res = NULL;
+    }
+    if(this->shard_res) {
+        struct ibv_utils_res * extra = (struct ibv_utils_res *)this->shard_res;
+        for (unsigned int i = 0; i + 1 < this->param.nshards; i++) {
+            extra[i].pd = NULL;  // PD 和设备属于主 ibv_res
+            destroy_ib_res(&extra[i]);
+            free(extra[i].mem_buf);
+        }
+        free(extra);
+        this->shard_res = NULL;
+    }
+    if(this->transport) {
+        delete this->transport;
+        this->transport = NULL;
+    }
+    if(this->subset) {
+        delete this->subset;
+        this->subset = NULL;
+    }
+    if(this->stage) {
+        if(this->param.RdmaDirectGpu != 0) {
+            CUDA_CALL(cudaFree(this->stage));
+        } else {
+            free(this->stage);
+        }
+        this->stage = NULL;
+    }
     if(this->ibv_res) {
         struct ibv_utils_res * ibv_res_ptr = (struct ibv_utils_res *)this->ibv_res;
-        if (ibv_res_ptr->mem_buf) {
+        if (ibv_res_ptr->sw_filter) {
+            printf("[RoCEv2Dada] software filter rejected %lu frames in total\n", (unsigned long)ibv_res_ptr->sw_rejected);
+        }
+        if (ibv_res_ptr->mem_buf && ibv_res_ptr->mem_buf_bytes) {
+            rx_numa_free(ibv_res_ptr->mem_buf, ibv_res_ptr->mem_buf_bytes);
+        } else if (ibv_res_ptr->mem_buf) {
             if(this->param.RdmaDirectGpu > 0 && !this->param.SendOrRecv) {
                 CUDA_CALL(cudaFree(ibv_res_ptr->mem_buf));
             } else if(this->param.RdmaDirectGpu < 0 && !this->param.SendOrRecv) {
@@ -583,7 +1292,13 @@ int RoCEv2Dada::Start()
     printf("[RoCEv2Dada::Start] ibv_res_ptr=%p\n", (void*)ibv_res_ptr);
     fflush(stdout);
     
-    if(this->param.DirectToRing && !ibv_res_ptr->mr) { 
+    if(!this->param.SendOrRecv && !this->transport && !this->shards && !this->merge && !this->streams && !this->assembler && !this->compactor && this->param.transport != RX_TRANSPORT_RC) { 
+        printf("RoCEv2Dada::Start error: receive transport not created.\n"); 
+        fflush(stdout);
+        return RDMA_ERROR; 
+    }
+    
+    if(this->param.DirectToRing && !ibv_res_ptr->mr && !this->param.GetBlockMrPtr) { 
         printf("RoCEv2Dada::Start error: direct MR not set.\n"); 
         fflush(stdout);
         return RDMA_ERROR; 
@@ -595,32 +1310,134 @@ int RoCEv2Dada::Start()
         return RDMA_ERROR; 
     }
     
-    printf("[RoCEv2Dada::Start] Creating pthread...\n");
-    fflush(stdout);
+    if(!this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_RC && this->rc_sock < 0) {
+        if(ConnectRc() < 0) {
+            printf("RoCEv2Dada::Start error: RC connection setup failed.\n");
+            fflush(stdout);
+            return RDMA_ERROR;
+        }
+    }
     
-    cpu_set_t mask;
-    int ret = pthread_create(&ibv_res_ptr->tid, NULL, SendRecvThread, (void *)this);
+    // ring 已注册、缓冲已分配，之后新映射的内存也立即锁定
+    if(this->param.mlock_all && rx_mlock_all() == 0) {
+        printf("[RoCEv2Dada::Start] Memory locked (mlockall)\n");
+    }
     
-    printf("[RoCEv2Dada::Start] pthread_create returned: %d (tid=%lu)\n", ret, (unsigned long)ibv_res_ptr->tid);
-    fflush(stdout);
+    // 所有接收线程（主线程和各组的线程）同样绑核 / 绑到网卡所在节点，并按 rt_priority 设置调度
+    RxThreadPlace place = {this->param.bind_cpu_id, this->numa_node, this->param.rt_priority};
     
-    if (ret) { 
-        fprintf(stderr, "pthread_create failed: %d\n", ret); 
-        fflush(stderr);
-        return RDMA_ERROR; 
+    if(this->streams) {
+        printf("[RoCEv2Dada::Start] Starting receive thread for %u streams...\n", this->streams->Count());
+        fflush(stdout);
+        return this->streams->Start(place) < 0 ? RDMA_ERROR : RDMA_OK;
+    }
+    if(this->assembler) {
+        printf("[RoCEv2Dada::Start] Starting frame assembly thread...\n");
+        fflush(stdout);
+        return this->assembler->Start(place) < 0 ? RDMA_ERROR : RDMA_OK;
+    }
+    if(this->compactor) {
+        printf("[RoCEv2Dada::Start] Starting compacted receive thread...\n");
+        fflush(stdout);
+        return this->compactor->Start(place) < 0 ? RDMA_ERROR : RDMA_OK;
+    }
+    if(this->merge) {
+        printf("[RoCEv2Dada::Start] Starting %u link threads...\n", this->nlinks);
+        fflush(stdout);
+        return this->merge->Start(place) < 0 ? RDMA_ERROR : RDMA_OK;
+    }
+    if(this->shards) {
+        printf("[RoCEv2Dada::Start] Starting %u shard threads...\n", this->param.nshards);
+        fflush(stdout);
+        return this->shards->Start(place) < 0 ? RDMA_ERROR : RDMA_OK;
+    }
+    
+    // 子集抽取在 DirectToRing 时尽量用 SGE 丢弃；QP 的 SGE 不够时退回拷贝路径做聚合
+    bool gather = this->subset && this->subset->Active();
+    if (gather && this->param.DirectToRing && this->param.transport == RX_TRANSPORT_VERBS) {
+        IbvDirectRing::Segment seg[DIRECT_MAX_SGE];
+        unsigned int n = IbvDirectRing::Layout(&this->param, this->subset, seg);
+        if (n <= DIRECT_MAX_SGE && (int)n <= ibv_res_ptr->recv_nsge) {
+            gather = false;
+        } else {
+            printf("[RoCEv2Dada::Start] Subset needs %u SGEs per WR (QP has %d): gather copy instead of DirectToRing\n",
+                   n, ibv_res_ptr->recv_nsge);
+        }
+    }
+    
+    if((this->param.stream_fill || gather) && !this->param.SendOrRecv && this->param.transport != RX_TRANSPORT_RC) {
+        // 连续字节流：批次可以跨 block 边界，block 大小不必是 pkt_size * send_n 的整数倍；
+        // 子集聚合：批次先收到中转缓冲，再逐包抽取保留的字节写入 block
+        size_t bytes = (size_t)this->param.send_n * this->param.pkt_size;
+        if (this->param.RdmaDirectGpu != 0) {
+            CUDA_CALL(cudaMalloc((void **)&this->stage, bytes));
+        } else {
+            this->stage = (char *)malloc(bytes);
+        }
+        if (!this->stage) {
+            printf("RoCEv2Dada::Start error: failed to allocate the %lu-byte batch staging buffer.\n", (unsigned long)bytes);
+            fflush(stdout);
+            return RDMA_ERROR;
+        }
+        if (this->param.stream_fill) printf("[RoCEv2Dada::Start] Byte-stream filling: batches straddle block boundaries, no bytes wasted\n");
+        else printf("[RoCEv2Dada::Start] Subset extraction: %u-byte packets gathered into %u-byte slots\n", this->param.pkt_size, this->subset->OutLen());
     }
     
-    if(this->param.bind_cpu_id >= 0) {
-        printf("[RoCEv2Dada::Start] Setting CPU affinity to core %d...\n", this->param.bind_cpu_id);
+    if(this->param.DirectToRing && !this->stage && !this->param.SendOrRecv && this->param.transport == RX_TRANSPORT_VERBS) {
+        IbvDirectRing::Segment seg[DIRECT_MAX_SGE];
+        unsigned int nseg = IbvDirectRing::Layout(&this->param, this->subset, seg);
+        if (nseg > DIRECT_MAX_SGE || (int)nseg > ibv_res_ptr->recv_nsge) {
+            printf("RoCEv2Dada::Start error: DirectToRing needs %u SGEs per WR (QP created with %d).\n", nseg, ibv_res_ptr->recv_nsge);
+            fflush(stdout);
+            return RDMA_ERROR;
+        }
+        unsigned int depth = this->param.direct_depth;
+        if (depth > 1 && !this->param.PeekBuffPtr) {
+            printf("[RoCEv2Dada::Start] No PeekBuffPtr: DirectToRing arms one block at a time\n");
+            depth = 1;
+        }
+        this->direct = new IbvDirectRing(&this->param, ibv_res_ptr, depth, this->subset);
+        printf("[RoCEv2Dada::Start] DirectToRing: receive WRs armed up to %u block(s) ahead\n", depth);
+        if (this->param.split_header) {
+            printf("[RoCEv2Dada::Start] DirectToRing: %d-byte headers split off, blocks hold %u-byte payloads\n",
+                   PKT_HEAD_LEN, this->param.pkt_size - PKT_HEAD_LEN);
+        }
+        if (this->subset && this->subset->Active()) {
+            printf("[RoCEv2Dada::Start] DirectToRing: %u SGEs per WR, unselected antennas/channels dropped at DMA time\n", nseg);
+        }
+    }
+    // 包头只有 DirectToRing 的 SGE 能分开：ring 没有注册给 DirectToRing，或子集抽取退回了拷贝路径时不起作用
+    if (this->param.split_header && !this->direct) {
+        printf("RoCEv2Dada::Start error: split_header needs DirectToRing (register the ring with SetDirectMr/SetDirectBlockMrs and give enough SGEs).\n");
         fflush(stdout);
-        CPU_ZERO(&mask);
-        CPU_SET(this->param.bind_cpu_id, &mask);
-        pthread_setaffinity_np(ibv_res_ptr->tid, sizeof(mask), &mask);
+        return RDMA_ERROR;
+    }
+    
+    // 直接写 ring 的拷贝路径：block 记账交给 PsrdadaSink，接收线程跑按 pkt_size/send_n 特化的循环；
+    // 需要 GPU 拷贝、软件过滤、缓冲池、中转缓冲或调试打印的配置仍走回调的通用循环
+    if(this->param.Ring && !this->param.SendOrRecv) {
+        if(this->param.transport == RX_TRANSPORT_VERBS && !this->direct && !this->stage && this->param.RdmaDirectGpu == 0
+           && !ibv_res_ptr->sw_filter && this->param.pool_kb == 0 && !this->param.debug_mode) {
+            this->sink = new PsrdadaSink(this->param.Ring, (uint64_t)this->param.pkt_size * this->param.send_n);
+            // 特化循环直接用 ibv_res 收包，Init 建好的 IbvRxTransport 用不上，不再留着
+            delete this->transport;
+            this->transport = NULL;
+            printf("[RoCEv2Dada::Start] Copy path: %s receive loop writing the ring directly\n",
+                   rx_engine_specialised(this->param.pkt_size, this->param.send_n) ? "specialised" : "generic templated");
+        } else if(this->param.transport == RX_TRANSPORT_VERBS && !this->direct) {
+            printf("[RoCEv2Dada::Start] Copy path: this configuration uses the callback receive loop\n");
+        }
     }
     
-    printf("[RoCEv2Dada::Start] Detaching thread...\n");
+    printf("[RoCEv2Dada::Start] Creating pthread...\n");
     fflush(stdout);
-    pthread_detach(ibv_res_ptr->tid);
+    
+    // 没有指定核时绑到网卡所在节点的全部核上（栈和线程局部的分配也落在该节点）
+    if (rx_thread_start(&ibv_res_ptr->tid, SendRecvThread, (void *)this, place, "RoCEv2Dada::Start") < 0) {
+        fflush(stdout);
+        return RDMA_ERROR; 
+    }
+    this->started = true;
     
     printf("[RoCEv2Dada::Start] Success, returning RDMA_OK\n");
     fflush(stdout);
@@ -631,8 +1448,141 @@ int RoCEv2Dada::SetDirectMr(struct ibv_mr *mr)
 {
     if (!mr || !this->ibv_res) return RDMA_ERROR;
     struct ibv_utils_res * ibv_res_ptr = (struct ibv_utils_res *)this->ibv_res;
+    this->param.DirectToRing = 1;
+    if (ValidateParam(1) < 0) {
+        this->param.DirectToRing = 0;
+        return RDMA_ERROR;
+    }
     ibv_res_ptr->mr = mr;
     ibv_res_ptr->mr_external = true;
+    return RDMA_OK;
+}
+
+int RoCEv2Dada::SetDirectBlockMrs()
+{
+    if (!this->param.GetBlockMrPtr || !this->ibv_res) return RDMA_ERROR;
+    if (this->param.SendOrRecv || this->param.transport != RX_TRANSPORT_VERBS) return RDMA_ERROR;
     this->param.DirectToRing = 1;
+    if (ValidateParam(1) < 0) {
+        this->param.DirectToRing = 0;
+        return RDMA_ERROR;
+    }
+    return RDMA_OK;
+}
+
+// 再接收一路流：verbs 时在同一设备和 PD 上建 QP 和 flow 规则，udp 时新开一个 socket。
+// 第一次调用时把 RdmaParam 对应的主后端作为第 0 路移入 RxStreamGroup。
+int RoCEv2Dada::AddStream(const RxStream & stream)
+{
+    struct ibv_utils_res * ibv_res_ptr = (struct ibv_utils_res *)this->ibv_res;
+    if (this->param.SendOrRecv || !ibv_res_ptr || !ibv_res_ptr->init_flag || (!this->transport && !this->streams)) {
+        printf("[RoCEv2Dada] ERROR: AddStream needs an initialized receiver\n");
+        return RDMA_ERROR;
+    }
+    if (ValidateParam((this->streams ? this->streams->Count() : 1) + 1) < 0) return RDMA_ERROR;
+
+    struct ibv_pkt_info info = ibv_res_ptr->pkt_info;
+    if (strlen(stream.DAddr) > 0 && inet_pton(AF_INET, stream.DAddr, &info.dst_ip) != 1) {
+        printf("[RoCEv2Dada] ERROR: invalid stream address %s\n", stream.DAddr);
+        return RDMA_ERROR;
+    }
+    if (strlen(stream.src_port) > 0) info.src_port = (uint16_t)atoi(stream.src_port);
+    if (strlen(stream.dst_port) > 0) info.dst_port = (uint16_t)atoi(stream.dst_port);
+    uint32_t mcast_if = htonl(INADDR_ANY);
+    bool mcast = ipv4_is_multicast(info.dst_ip);
+    if (mcast) {
+        if (strlen(this->param.McastIf) > 0) inet_pton(AF_INET, this->param.McastIf, &mcast_if);
+        ipv4_multicast_mac(info.dst_ip, info.dst_mac);
+    }
+
+    if (!this->streams) {
+        char name[32];
+        uint8_t * ip = (uint8_t *)&ibv_res_ptr->pkt_info.dst_ip;
+        snprintf(name, sizeof(name), "%d.%d.%d.%d:%u", ip[0], ip[1], ip[2], ip[3], ibv_res_ptr->pkt_info.dst_port);
+        this->streams = new RxStreamGroup(&this->param);
+        if (this->param.transport == RX_TRANSPORT_UDP) static_cast<UdpRxTransport *>(this->transport)->SetNonBlocking(true);
+        this->streams->Add(name, this->transport, this->param.GetBuffPtr, this->param.DataSendBuff, this->param.PeekBuffPtr);
+        this->transport = NULL;
+    }
+
+    RxTransport * t = NULL;
+    if (this->param.transport == RX_TRANSPORT_UDP) {
+        UdpRxTransport * udp = new UdpRxTransport();
+        t = udp;
+        if (udp->Open(&info, this->param.pkt_size, this->param.send_n, this->param.udp_gro, mcast_if) < 0) {
+            delete udp;
+            printf("[RoCEv2Dada] ERROR: failed to open UDP socket for port %u\n", info.dst_port);
+            return RDMA_ERROR;
+        }
+        udp->SetNonBlocking(true);
+    } else {
+        if (!this->stream_res) this->stream_res = calloc(RX_MAX_STREAMS - 1, sizeof(struct ibv_utils_res));
+        struct ibv_utils_res * res = &((struct ibv_utils_res *)this->stream_res)[this->streams->Count() - 1];
+        memset(res, 0, sizeof(*res));
+        res->dev = ibv_res_ptr->dev;
+        res->context = ibv_res_ptr->context;
+        res->pd = ibv_res_ptr->pd;
+        res->recv_nsge = ibv_res_ptr->recv_nsge;
+        res->send_nsge = ibv_res_ptr->send_nsge;
+        res->pkt_size = ibv_res_ptr->pkt_size;
+        res->poll_n = ibv_res_ptr->poll_n;
+        res->pkt_info = info;
+        res->mcast_fd = -1;
+        int ret = mcast ? (res->mcast_fd = ipv4_mcast_join(-1, info.dst_ip, mcast_if)) : 0;
+        if (ret >= 0) ret = setup_verbs_rx(res, ibv_res_ptr->recv_wr_num);
+        if (ret < 0) {
+            printf("[RoCEv2Dada] ERROR: failed to set up QP/flow for port %u (%d)\n", info.dst_port, ret);
+            res->pd = NULL;
+            destroy_ib_res(res);
+            free(res->mem_buf);
+            memset(res, 0, sizeof(*res));
+            return RDMA_ERROR;
+        }
+        t = new IbvRxTransport(res, res->pkt_size, 0,
+                               this->param.pool_kb > 0 && this->param.RdmaDirectGpu == 0 ? pool_working_set(&this->param) : 0);
+    }
+    char name[32];
+    uint8_t * ip = (uint8_t *)&info.dst_ip;
+    snprintf(name, sizeof(name), "%d.%d.%d.%d:%u", ip[0], ip[1], ip[2], ip[3], info.dst_port);
+    int idx = this->streams->Add(name, t, stream.GetBuffPtr, stream.DataSendBuff, stream.PeekBuffPtr);
+    printf("[RoCEv2Dada] Added stream %d: %s\n", idx, name);
+    fflush(stdout);
+    return RDMA_OK;
+}
+
+// 接受发送端连接，交换 QP/GID 和 ring 地址、rkey、block 大小，连好 QP 后投递 0-SGE 接收 WR
+int RoCEv2Dada::ConnectRc()
+{
+    struct ibv_utils_res * ibv_res_ptr = (struct ibv_utils_res *)this->ibv_res;
+    struct ibv_mr * mr = ibv_res_ptr->mr;
+    if (!mr || !(mr->rkey) || this->param.RingBlockBytes == 0) {
+        printf("[RoCEv2Dada] RC mode needs the whole ring registered with REMOTE_WRITE (dada_db --contig).\n");
+        return RDMA_ERROR;
+    }
+    struct ibv_rc_info local, remote;
+    if (rc_local_info(ibv_res_ptr, this->param.gid_index, &local) < 0) return RDMA_ERROR;
+    local.ring_addr = (uint64_t)(uintptr_t)mr->addr;
+    local.ring_bytes = mr->length;
+    local.block_bytes = this->param.RingBlockBytes;
+    local.rkey = mr->rkey;
+    local.nblocks = (uint32_t)(mr->length / this->param.RingBlockBytes);
+
+    this->rc_sock = rc_listen((uint16_t)this->param.rc_port);
+    if (this->rc_sock < 0) return RDMA_ERROR;
+    if (rc_exchange(this->rc_sock, &local, &remote) < 0) return RDMA_ERROR;
+    if (init_rc_res(ibv_res_ptr, this->param.gid_index, &local, &remote) < 0) return RDMA_ERROR;
+    for (int i = 0; i < ibv_res_ptr->recv_wr_num; i++) {
+        ibv_res_ptr->recv_wr->wr_id = i;
+        ibv_res_ptr->recv_wr->sg_list = NULL;
+        ibv_res_ptr->recv_wr->num_sge = 0;
+        ibv_res_ptr->recv_wr->next = NULL;
+        if (ibv_post_recv(ibv_res_ptr->qp, ibv_res_ptr->recv_wr, &ibv_res_ptr->bad_recv_wr)) {
+            printf("[RoCEv2Dada] Failed to post RC recv WR %d.\n", i);
+            return RDMA_ERROR;
+        }
+    }
+    printf("[RoCEv2Dada] RC sender connected: ring=0x%lx rkey=0x%x %u blocks x %lu bytes\n",
+           (unsigned long)local.ring_addr, local.rkey, local.nblocks, (unsigned long)local.block_bytes);
+    fflush(stdout);
     return RDMA_OK;
 }
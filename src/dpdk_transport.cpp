@@ -0,0 +1,260 @@
+//DPDK poll-mode 接收后端：每个 RX 队列一个 worker lcore，接收线程把 mbuf 拷进 ring block
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_cycles.h>
+#include <rte_memcpy.h>
+#include <rte_byteorder.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "dpdk_transport.h"
+#include "pkt_gen.h"
+
+#define DPDK_MAX_EAL_ARGS 64
+#define DPDK_RX_DESC 4096
+#define DPDK_RX_BURST 64
+#define DPDK_QUEUE_RING_SIZE 4096
+#define DPDK_MBUF_CACHE 256
+#define DPDK_ETH_HDR_LEN 14
+
+DpdkRxTransport::DpdkRxTransport(): eal_ready(false), port_started(false), workers_running(false), stop(false),
+    port_id(0), nb_queues(0), next_queue(0), pkt_size(0), batch(0), pool(NULL), burst(NULL),
+    copied(0), truncated(0), inline_filtered(0)
+{
+    memset(&pkt_info, 0, sizeof(pkt_info));
+    memset(queues, 0, sizeof(queues));
+}
+
+DpdkRxTransport::~DpdkRxTransport()
+{
+    if (workers_running) {
+        stop = true;
+        rte_eal_mp_wait_lcore();
+    }
+    if (eal_ready) PrintStats();
+    for (unsigned int q = 0; q < nb_queues; q++) {
+        if (!queues[q].ring) continue;
+        void *m;
+        while (rte_ring_sc_dequeue(queues[q].ring, &m) == 0) rte_pktmbuf_free((struct rte_mbuf *)m);
+        rte_ring_free(queues[q].ring);
+    }
+    if (port_started) {
+        rte_eth_dev_stop(port_id);
+        rte_eth_dev_close(port_id);
+    }
+    if (pool) rte_mempool_free(pool);
+    free(burst);
+    if (eal_ready) rte_eal_cleanup();
+}
+
+void DpdkRxTransport::PrintStats() const
+{
+    double hz = (double)rte_get_tsc_hz();
+    for (unsigned int q = 0; q < nb_queues; q++) {
+        const Queue *qu = &queues[q];
+        double secs = qu->tsc_last > qu->tsc_first ? (qu->tsc_last - qu->tsc_first) / hz : 0.0;
+        char who[32];
+        if (qu->lcore == LCORE_ID_ANY) snprintf(who, sizeof(who), "receive thread");
+        else snprintf(who, sizeof(who), "lcore %u", qu->lcore);
+        printf("[DpdkRxTransport] queue %u %s: %lu pkts, %.3f Mpps, filtered %lu, ring full %lu\n",
+               q, who, (unsigned long)qu->rx_pkts, secs > 0 ? qu->rx_pkts / secs / 1e6 : 0.0,
+               (unsigned long)qu->filtered, (unsigned long)qu->ring_full);
+    }
+    printf("[DpdkRxTransport] copied to ring: %lu, truncated: %lu, filtered on receive thread: %lu\n",
+           (unsigned long)copied, (unsigned long)truncated, (unsigned long)inline_filtered);
+}
+
+// 只保留 IPv4/UDP 且四元组与配置一致的帧，其余释放；返回保留的个数（原地压缩）
+unsigned int DpdkRxTransport::Filter(struct rte_mbuf ** bufs, unsigned int n, uint64_t * filtered) const
+{
+    unsigned int keep = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        struct rte_mbuf *m = bufs[i];
+        if (match_udp_flow(rte_pktmbuf_mtod(m, const uint8_t *), rte_pktmbuf_data_len(m),
+                           pkt_info.src_ip, pkt_info.dst_ip, pkt_info.src_port, pkt_info.dst_port)) {
+            bufs[keep++] = m;
+        } else {
+            rte_pktmbuf_free(m);
+            (*filtered)++;
+        }
+    }
+    return keep;
+}
+
+int DpdkRxTransport::WorkerMain(void * arg)
+{
+    Queue *q = (Queue *)arg;
+    DpdkRxTransport *self = q->owner;
+    struct rte_mbuf *bufs[DPDK_RX_BURST];
+    while (!self->stop) {
+        uint16_t n = rte_eth_rx_burst(self->port_id, q->id, bufs, DPDK_RX_BURST);
+        if (n == 0) continue;
+        unsigned int keep = self->Filter(bufs, n, &q->filtered);
+        if (keep == 0) continue;
+        uint64_t now = rte_rdtsc();
+        if (q->rx_pkts == 0) q->tsc_first = now;
+        q->tsc_last = now;
+        q->rx_pkts += keep;
+        unsigned int sent = rte_ring_sp_enqueue_burst(q->ring, (void **)bufs, keep, NULL);
+        if (sent < keep) {
+            rte_pktmbuf_free_bulk(bufs + sent, keep - sent);
+            q->ring_full += keep - sent;
+        }
+    }
+    return 0;
+}
+
+int DpdkRxTransport::Open(const char * eal_args, uint16_t port_id, unsigned int nb_queues,
+                          const struct ibv_pkt_info * pkt_info, unsigned int pkt_size, unsigned int batch)
+{
+    if (!pkt_info || pkt_size <= 42 || batch == 0 || nb_queues == 0 || nb_queues > DPDK_MAX_QUEUES) {
+        ibv_utils_error("Invalid DPDK transport parameters.");
+        return -1;
+    }
+    this->port_id = port_id;
+    this->nb_queues = nb_queues;
+    this->pkt_size = pkt_size;
+    this->batch = batch;
+    this->pkt_info = *pkt_info;
+
+    // EAL 参数按空格切分，例如 "-l 0-2 --no-huge --vdev=net_pcap0,rx_pcap=in.pcap"
+    static char args_buf[1024];
+    char *argv[DPDK_MAX_EAL_ARGS];
+    int argc = 0;
+    argv[argc++] = (char *)"rdma_dada";
+    strncpy(args_buf, eal_args ? eal_args : "", sizeof(args_buf) - 1);
+    for (char *tok = strtok(args_buf, " "); tok && argc < DPDK_MAX_EAL_ARGS - 1; tok = strtok(NULL, " ")) argv[argc++] = tok;
+    argv[argc] = NULL;
+    if (rte_eal_init(argc, argv) < 0) { fprintf(stderr, "[DpdkRxTransport] rte_eal_init failed: %s\n", rte_strerror(rte_errno)); return -2; }
+    eal_ready = true;
+
+    if (!rte_eth_dev_is_valid_port(port_id)) {
+        fprintf(stderr, "[DpdkRxTransport] port %u not found (%u ports available)\n", port_id, rte_eth_dev_count_avail());
+        return -3;
+    }
+    unsigned int workers = rte_lcore_count() - 1;
+    if (nb_queues > 1 && workers < nb_queues) {
+        fprintf(stderr, "[DpdkRxTransport] %u RX queues need %u worker lcores, EAL has %u\n", nb_queues, nb_queues, workers);
+        return -3;
+    }
+
+    struct rte_eth_dev_info dev_info;
+    if (rte_eth_dev_info_get(port_id, &dev_info) != 0) { ibv_utils_error("Failed to query DPDK port."); return -3; }
+    if (nb_queues > dev_info.max_rx_queues) {
+        fprintf(stderr, "[DpdkRxTransport] port %u supports at most %u RX queues\n", port_id, dev_info.max_rx_queues);
+        return -3;
+    }
+
+    int socket_id = rte_eth_dev_socket_id(port_id);
+    if (socket_id < 0) socket_id = (int)rte_socket_id();
+    unsigned int data_room = RTE_PKTMBUF_HEADROOM + pkt_size;
+    if (data_room < RTE_MBUF_DEFAULT_BUF_SIZE) data_room = RTE_MBUF_DEFAULT_BUF_SIZE;
+    unsigned int nb_mbufs = nb_queues * (DPDK_RX_DESC + DPDK_QUEUE_RING_SIZE) + batch + DPDK_MBUF_CACHE * rte_lcore_count();
+    pool = rte_pktmbuf_pool_create("rdma_dada_rx", nb_mbufs, DPDK_MBUF_CACHE, 0, (uint16_t)data_room, socket_id);
+    if (!pool) { fprintf(stderr, "[DpdkRxTransport] mbuf pool: %s\n", rte_strerror(rte_errno)); return -4; }
+
+    // 多队列时用 RSS 在队列间分流；虚拟 PMD 不支持 RSS 时每个队列各自有输入源（如多个 rx_pcap）
+    struct rte_eth_conf port_conf;
+    memset(&port_conf, 0, sizeof(port_conf));
+    uint64_t rss_hf = (RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+    if (nb_queues > 1 && rss_hf) {
+        port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+        port_conf.rx_adv_conf.rss_conf.rss_hf = rss_hf;
+    }
+    if (pkt_size > RTE_ETHER_MAX_LEN - RTE_ETHER_CRC_LEN) port_conf.rxmode.mtu = pkt_size - DPDK_ETH_HDR_LEN;
+    if (rte_eth_dev_configure(port_id, (uint16_t)nb_queues, 0, &port_conf) < 0) { ibv_utils_error("Failed to configure DPDK port."); return -5; }
+
+    uint16_t nb_rxd = DPDK_RX_DESC, nb_txd = 0;
+    rte_eth_dev_adjust_nb_rx_tx_desc(port_id, &nb_rxd, &nb_txd);
+    for (unsigned int q = 0; q < nb_queues; q++) {
+        if (rte_eth_rx_queue_setup(port_id, (uint16_t)q, nb_rxd, socket_id, NULL, pool) < 0) {
+            fprintf(stderr, "[DpdkRxTransport] Failed to set up RX queue %u\n", q);
+            return -5;
+        }
+    }
+    if (rte_eth_dev_start(port_id) < 0) { ibv_utils_error("Failed to start DPDK port."); return -6; }
+    port_started = true;
+    rte_eth_promiscuous_enable(port_id);
+    // 部分 PMD 的混杂模式不含组播；DPDK 不发 IGMP，交换机需静态组播表或关闭 snooping
+    if (ipv4_is_multicast(pkt_info->dst_ip)) rte_eth_allmulticast_enable(port_id);
+
+    burst = (struct rte_mbuf **)calloc(batch, sizeof(struct rte_mbuf *));
+    if (!burst) { ibv_utils_error("Failed to allocate DPDK burst array."); return -7; }
+
+    // 每个队列一个 worker lcore；没有 worker 时由接收线程直接轮询唯一的队列。
+    // 接收线程是普通 pthread 而不是 EAL lcore（Open 所在线程的 rte_lcore_id() 与它无关），统计中标为 receive thread
+    unsigned int lcore = rte_get_next_lcore(-1, 1, 0);
+    for (unsigned int q = 0; q < nb_queues; q++) {
+        Queue *qu = &queues[q];
+        qu->owner = this;
+        qu->id = (uint16_t)q;
+        qu->lcore = workers ? lcore : LCORE_ID_ANY;
+        if (!workers) continue;
+        char name[RTE_RING_NAMESIZE];
+        snprintf(name, sizeof(name), "rdma_dada_q%u", q);
+        qu->ring = rte_ring_create(name, DPDK_QUEUE_RING_SIZE, socket_id, RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (!qu->ring) { fprintf(stderr, "[DpdkRxTransport] ring %s: %s\n", name, rte_strerror(rte_errno)); return -7; }
+        lcore = rte_get_next_lcore(lcore, 1, 0);
+    }
+    if (workers) {
+        for (unsigned int q = 0; q < nb_queues; q++) {
+            if (rte_eal_remote_launch(WorkerMain, &queues[q], queues[q].lcore) != 0) {
+                fprintf(stderr, "[DpdkRxTransport] Failed to launch worker on lcore %u\n", queues[q].lcore);
+                stop = true;
+                rte_eal_mp_wait_lcore();
+                return -8;
+            }
+            workers_running = true;
+        }
+    }
+
+    printf("[DpdkRxTransport] port %u (%s) started: %u RX queue(s), %s, RSS %s\n",
+           port_id, dev_info.driver_name, nb_queues,
+           workers ? "one worker lcore per queue" : "polled by receive thread",
+           port_conf.rxmode.mq_mode == RTE_ETH_MQ_RX_RSS ? "on" : "off");
+    for (unsigned int q = 0; workers && q < nb_queues; q++)
+        printf("  queue %u -> lcore %u (socket %d)\n", q, queues[q].lcore, (int)rte_lcore_to_socket_id(queues[q].lcore));
+    return 0;
+}
+
+int DpdkRxTransport::Recv(char * dst, unsigned int pkt_num)
+{
+    if (pkt_num > batch) pkt_num = batch;
+    unsigned int got = 0;
+    if (!workers_running) {
+        uint16_t n = rte_eth_rx_burst(port_id, 0, burst, (uint16_t)pkt_num);
+        got = Filter(burst, n, &inline_filtered);
+        if (got) {
+            uint64_t now = rte_rdtsc();
+            if (queues[0].rx_pkts == 0) queues[0].tsc_first = now;
+            queues[0].tsc_last = now;
+            queues[0].rx_pkts += got;
+        }
+    } else {
+        // 轮流从各队列取，避免某个队列长期占满批次
+        for (unsigned int i = 0; i < nb_queues && got < pkt_num; i++) {
+            unsigned int q = (next_queue + i) % nb_queues;
+            got += rte_ring_sc_dequeue_burst(queues[q].ring, (void **)(burst + got), pkt_num - got, NULL);
+        }
+        next_queue = (next_queue + 1) % nb_queues;
+    }
+
+    for (unsigned int i = 0; i < got; i++) {
+        struct rte_mbuf *m = burst[i];
+        char *slot = dst + (size_t)i * pkt_size;
+        uint32_t len = rte_pktmbuf_pkt_len(m);
+        if (len > pkt_size) { len = pkt_size; truncated++; }
+        // 单段 mbuf 返回指向数据的指针，多段时拼接到 slot 中
+        const void *data = rte_pktmbuf_read(m, 0, len, slot);
+        if (data != slot) rte_memcpy(slot, data, len);
+        if (len < pkt_size) memset(slot + len, 0, pkt_size - len);
+    }
+    if (got) rte_pktmbuf_free_bulk(burst, got);
+    copied += got;
+    return (int)got;
+}
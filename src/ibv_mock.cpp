@@ -0,0 +1,927 @@
+//ibverbs 软件模拟：链接时代替 libibverbs，按配置的速率完成接收 WR，用于无网卡环境下测试接收循环
+#include <infiniband/verbs.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <deque>
+#include <vector>
+
+#include "ibv_mock.h"
+
+#define MOCK_MAX_SGE 16
+#define MOCK_FRAME_HDR_LEN 42   // Ethernet + IPv4 + UDP
+#define MOCK_SEQ_LEN 8
+#define MOCK_MAX_DEVICES 4
+#define MOCK_MAX_FLOWS 64
+#define MOCK_CHANNEL_TICK_NS 20000   // 完成通道检查 arm 过的 CQ 的间隔
+
+struct mock_recv {
+    uint64_t wr_id;
+    int num_sge;
+    struct ibv_sge sge[MOCK_MAX_SGE];
+};
+
+struct mock_qp;
+struct mock_channel;
+
+struct mock_cq {
+    union {
+        struct ibv_cq cq;       // 必须是第一个成员
+        struct ibv_cq_ex cq_ex; // ibv_create_cq_ex 创建时使用扩展 poll 接口，前部与 ibv_cq 相同
+    };
+    pthread_mutex_t lock;  // RC 对端可能在另一个线程写入 wcs 和 rq；扩展 poll 从 start_poll 到 end_poll 持有
+    std::deque<struct ibv_wc> wcs;
+    std::deque<uint64_t> ts;    // 与 wcs 一一对应：完成到达的 wallclock 时间（ns）
+    struct ibv_wc cur;          // 扩展 poll 当前的完成
+    uint64_t cur_ts;
+    std::vector<mock_qp *> qps;  // 以此为 recv_cq 的 QP
+    mock_channel *channel;
+    bool armed;         // ibv_req_notify_cq 之后、事件产生之前
+};
+
+// 完成通道：后台线程按 MOCK_CHANNEL_TICK_NS 检查 arm 过的 CQ，有完成时产生一个事件（eventfd 计数加一）
+struct mock_channel {
+    struct ibv_comp_channel ch;  // 必须是第一个成员
+    pthread_mutex_t lock;
+    pthread_t tid;
+    volatile bool stop;
+    std::vector<mock_cq *> cqs;
+    std::deque<mock_cq *> fired;    // 已产生、还没被 ibv_get_cq_event 取走的事件
+};
+
+struct mock_qp {
+    struct ibv_qp qp;  // 必须是第一个成员
+    mock_cq *send_cq;
+    mock_cq *recv_cq;
+    std::deque<mock_recv> rq;
+    uint32_t max_recv_wr;
+    uint32_t dest_qpn;  // RC：RTR 时设置的对端 QP
+    uint8_t hdr[MOCK_MAX_FLOWS][MOCK_FRAME_HDR_LEN];
+    unsigned int nflows;    // 挂在 QP 上的 flow 规则数，帧按规则轮流生成
+    uint64_t t_start;   // 第一个 WR 投递的时刻，速率从此开始计算
+    uint64_t arrived;   // 已到达（含丢弃）的包数
+    uint64_t next_seq;
+    uint64_t held_seq;  // 乱序时推迟发出的序号
+    bool has_held;
+    bool unsteered;     // flow 规则被拒绝（IBV_MOCK_NO_STEERING），QP 也会收到其它流的帧
+    uint64_t rng;
+};
+
+static struct ibv_mock_config g_cfg;
+static struct ibv_mock_stats g_stats;
+static bool g_cfg_loaded = false;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<struct ibv_mr *> g_mrs;
+
+// 按 key 排序的 MR 快照，reg_mr/dereg_mr 在 g_lock 下重建后整体替换指针；数据路径校验 SGE 时只做一次
+// acquire 读和二分查找，不拿全局锁。旧快照可能仍有线程在读，放进 g_mr_retired 到进程结束才释放
+// （MR 只在初始化和退出时注册/注销，累积量很小）。
+struct mock_mr_entry { uint32_t key; uint32_t rkey; uint64_t addr; uint64_t length; };
+struct mock_mr_table { size_t n; mock_mr_entry e[1]; };
+static mock_mr_table *g_mr_table = NULL;
+static std::vector<mock_mr_table *> g_mr_retired;
+static std::vector<mock_qp *> g_qps;
+static uint32_t g_next_key = 1;
+static uint32_t g_next_qpn = 1;
+static struct ibv_device g_devices[MOCK_MAX_DEVICES];
+static struct ibv_device *g_device_list[MOCK_MAX_DEVICES + 1];
+
+static uint64_t mock_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 单调时钟换算到 wallclock（CLOCK_REALTIME），与 IBV_WC_EX_WITH_COMPLETION_TIMESTAMP_WALLCLOCK 同一时基
+static uint64_t mock_wallclock_ns(uint64_t mono)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t real = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    return real - (mock_now_ns() - mono);
+}
+
+static double env_double(const char *name, double def)
+{
+    const char *v = getenv(name);
+    return v ? atof(v) : def;
+}
+
+static void mock_load_config()
+{
+    if (g_cfg_loaded) return;
+    g_cfg.pps = env_double("IBV_MOCK_PPS", 0.0);
+    g_cfg.burst = (unsigned int)env_double("IBV_MOCK_BURST", 1);
+    g_cfg.drop = env_double("IBV_MOCK_DROP", 0.0);
+    g_cfg.reorder = env_double("IBV_MOCK_REORDER", 0.0);
+    g_cfg.error = env_double("IBV_MOCK_ERROR", 0.0);
+    g_cfg.frame_len = (unsigned int)env_double("IBV_MOCK_FRAME_LEN", 0);
+    g_cfg.seed = (unsigned int)env_double("IBV_MOCK_SEED", 1);
+    g_cfg.devices = (unsigned int)env_double("IBV_MOCK_DEVICES", 1);
+    g_cfg.no_steering = env_double("IBV_MOCK_NO_STEERING", 0) != 0;
+    g_cfg.stray = env_double("IBV_MOCK_STRAY", 0.0);
+    g_cfg.fill = env_double("IBV_MOCK_FILL", 0) != 0;
+    if (g_cfg.burst == 0) g_cfg.burst = 1;
+    g_cfg_loaded = true;
+}
+
+static double mock_rand(mock_qp *q)
+{
+    // xorshift64*
+    q->rng ^= q->rng >> 12;
+    q->rng ^= q->rng << 25;
+    q->rng ^= q->rng >> 27;
+    return (double)((q->rng * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+}
+
+// 调用者持有 g_lock：按当前 g_mrs 生成新快照并发布
+static void mock_mr_publish()
+{
+    size_t n = g_mrs.size();
+    mock_mr_table *t = (mock_mr_table *)malloc(sizeof(mock_mr_table) + n * sizeof(mock_mr_entry));
+    if (!t) return;  // 保留旧快照，新 MR 上的 SGE 会被判为保护错误
+    t->n = n;
+    for (size_t i = 0; i < n; i++) {
+        struct ibv_mr *mr = g_mrs[i];
+        t->e[i].key = mr->lkey;
+        t->e[i].rkey = mr->rkey;
+        t->e[i].addr = (uint64_t)(uintptr_t)mr->addr;
+        t->e[i].length = mr->length;
+    }
+    // key 单调分配、g_mrs 按注册顺序追加，这里只是保证有序，通常是线性的
+    for (size_t i = 1; i < n; i++) {
+        mock_mr_entry x = t->e[i];
+        size_t j = i;
+        for (; j > 0 && t->e[j - 1].key > x.key; j--) t->e[j] = t->e[j - 1];
+        t->e[j] = x;
+    }
+    mock_mr_table *old = __atomic_exchange_n(&g_mr_table, t, __ATOMIC_ACQ_REL);
+    if (old) g_mr_retired.push_back(old);
+}
+
+static const mock_mr_entry *mock_mr_find(uint32_t key)
+{
+    const mock_mr_table *t = __atomic_load_n(&g_mr_table, __ATOMIC_ACQUIRE);
+    if (!t) return NULL;
+    size_t lo = 0, hi = t->n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (t->e[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < t->n && t->e[lo].key == key ? &t->e[lo] : NULL;
+}
+
+// SGE 必须完整落在某个 lkey 相同的 MR 内
+static bool mock_sge_valid(const struct ibv_sge *sge)
+{
+    const mock_mr_entry *m = mock_mr_find(sge->lkey);
+    return m && sge->addr >= m->addr && sge->addr + sge->length <= m->addr + m->length;
+}
+
+// RDMA WRITE 的目标范围必须落在 rkey 对应、允许远端写的 MR 内（rkey 非 0 时与 lkey 相同）
+static bool mock_rkey_valid(uint32_t rkey, uint64_t addr, uint64_t len)
+{
+    const mock_mr_entry *m = rkey ? mock_mr_find(rkey) : NULL;
+    return m && m->rkey == rkey && addr >= m->addr && addr + len <= m->addr + m->length;
+}
+
+static mock_qp *mock_find_qp(uint32_t qpn)
+{
+    pthread_mutex_lock(&g_lock);
+    mock_qp *q = NULL;
+    for (size_t i = 0; i < g_qps.size() && !q; i++) {
+        if (g_qps[i]->qp.qp_num == qpn) q = g_qps[i];
+    }
+    pthread_mutex_unlock(&g_lock);
+    return q;
+}
+
+// 把帧头和序号按 SGE 顺序写入，返回帧长。
+// 多条 flow 规则时第 k 个包来自规则 k % nflows，序号为 k / nflows（每个源各自从 0 计数）
+static uint32_t mock_write_frame(mock_qp *q, const mock_recv *r, uint64_t seq)
+{
+    uint8_t head[MOCK_FRAME_HDR_LEN + MOCK_SEQ_LEN];
+    unsigned int nflows = q->nflows ? q->nflows : 1;
+    memcpy(head, q->hdr[seq % nflows], MOCK_FRAME_HDR_LEN);
+    seq /= nflows;
+    uint64_t wire = htobe64(seq);  // 与真实发送端相同的网络字节序
+    memcpy(head + MOCK_FRAME_HDR_LEN, &wire, MOCK_SEQ_LEN);
+    uint32_t total = 0, copied = 0;
+    for (int i = 0; i < r->num_sge; i++) total += r->sge[i].length;
+    if (g_cfg.frame_len && g_cfg.frame_len < total) total = g_cfg.frame_len;
+    uint32_t off = 0;
+    for (int i = 0; i < r->num_sge && off < total; i++) {
+        uint32_t len = r->sge[i].length < total - off ? r->sge[i].length : total - off;
+        uint32_t n = 0;
+        if (copied < sizeof(head)) {
+            n = sizeof(head) - copied < len ? sizeof(head) - copied : len;
+            memcpy((void *)(uintptr_t)r->sge[i].addr, head + copied, n);
+            copied += n;
+        }
+        // 整帧写入：像网卡 DMA 一样写满缓冲，缓冲的缓存行随之被写分配
+        if (g_cfg.fill && len > n) memset((uint8_t *)(uintptr_t)r->sge[i].addr + n, (uint8_t)seq, len - n);
+        off += len;
+    }
+    // IP/UDP 长度字段与帧长一致
+    if (total >= MOCK_FRAME_HDR_LEN && r->num_sge > 0 && r->sge[0].length >= MOCK_FRAME_HDR_LEN) {
+        uint8_t *p = (uint8_t *)(uintptr_t)r->sge[0].addr;
+        uint16_t ip_len = htons((uint16_t)(total - 14)), udp_len = htons((uint16_t)(total - 34));
+        memcpy(p + 16, &ip_len, 2);
+        memcpy(p + 38, &udp_len, 2);
+    }
+    return total;
+}
+
+// 按速率生成到达的包，消耗 WR 并放入 CQ
+static void mock_generate(mock_cq *cq, mock_qp *q, uint64_t now)
+{
+    if (q->t_start == 0) return;
+    uint64_t due;
+    if (g_cfg.pps > 0) {
+        due = (uint64_t)((now - q->t_start) / 1e9 * g_cfg.pps);
+        due -= due % g_cfg.burst;
+    } else {
+        due = q->arrived + q->rq.size();
+    }
+    uint64_t wall = mock_wallclock_ns(now);
+    while (q->arrived < due && cq->wcs.size() < (size_t)cq->cq.cqe) {
+        // 按速率推算的到达时刻：第 k 个包在它所在的突发凑满时到达
+        uint64_t t_arr = now;
+        if (g_cfg.pps > 0) {
+            t_arr = q->t_start + (uint64_t)((q->arrived / g_cfg.burst + 1) * g_cfg.burst / g_cfg.pps * 1e9);
+            if (t_arr > now) t_arr = now;
+        }
+        q->arrived++;
+        // 没有 steering 时混入的其它流的帧，不占用本流的序号
+        bool stray = q->unsteered && g_cfg.stray > 0 && mock_rand(q) < g_cfg.stray;
+        uint64_t seq;
+        if (stray) {
+            seq = 0;
+        } else if (q->has_held) {
+            seq = q->held_seq;
+            q->has_held = false;
+        } else {
+            seq = q->next_seq++;
+            if (g_cfg.reorder > 0 && mock_rand(q) < g_cfg.reorder) {
+                q->held_seq = seq;
+                q->has_held = true;
+                seq = q->next_seq++;
+                __atomic_fetch_add(&g_stats.reordered, 1, __ATOMIC_RELAXED);
+            }
+        }
+        if (g_cfg.drop > 0 && mock_rand(q) < g_cfg.drop) {
+            __atomic_fetch_add(&g_stats.wire_drops, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (q->rq.empty()) {
+            // 接收队列空：本包及积压的包都在网卡上被丢弃
+            __atomic_fetch_add(&g_stats.no_wr_drops, due - q->arrived + 1, __ATOMIC_RELAXED);
+            q->next_seq += due - q->arrived;
+            q->arrived = due;
+            break;
+        }
+        mock_recv r = q->rq.front();
+        q->rq.pop_front();
+        struct ibv_wc wc;
+        memset(&wc, 0, sizeof(wc));
+        wc.wr_id = r.wr_id;
+        wc.opcode = IBV_WC_RECV;
+        wc.qp_num = q->qp.qp_num;
+        bool valid = true;
+        for (int i = 0; i < r.num_sge && valid; i++) valid = mock_sge_valid(&r.sge[i]);
+        if (!valid) {
+            wc.status = IBV_WC_LOC_PROT_ERR;
+            __atomic_fetch_add(&g_stats.prot_errors, 1, __ATOMIC_RELAXED);
+        } else if (g_cfg.error > 0 && mock_rand(q) < g_cfg.error) {
+            wc.status = IBV_WC_GENERAL_ERR;
+            __atomic_fetch_add(&g_stats.errors, 1, __ATOMIC_RELAXED);
+        } else {
+            wc.status = IBV_WC_SUCCESS;
+            wc.byte_len = mock_write_frame(q, &r, seq);
+            if (stray && r.sge[0].length >= MOCK_FRAME_HDR_LEN) {
+                ((uint8_t *)(uintptr_t)r.sge[0].addr)[37] ^= 1;  // 目的端口不同
+                __atomic_fetch_add(&g_stats.strays, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_fetch_add(&g_stats.completed, 1, __ATOMIC_RELAXED);
+        }
+        cq->wcs.push_back(wc);
+        cq->ts.push_back(wall - (now - t_arr));
+    }
+}
+
+static int mock_poll_cq(struct ibv_cq *ibcq, int num_entries, struct ibv_wc *wc)
+{
+    mock_cq *cq = (mock_cq *)ibcq;
+    pthread_mutex_lock(&cq->lock);
+    if (cq->wcs.size() < (size_t)num_entries) {
+        uint64_t now = mock_now_ns();
+        for (size_t i = 0; i < cq->qps.size(); i++) mock_generate(cq, cq->qps[i], now);
+    }
+    int n = 0;
+    while (n < num_entries && !cq->wcs.empty()) {
+        wc[n++] = cq->wcs.front();
+        cq->wcs.pop_front();
+        cq->ts.pop_front();
+    }
+    pthread_mutex_unlock(&cq->lock);
+    return n;
+}
+
+// 扩展 poll：start_poll 取第一个完成并持有 CQ 锁，next_poll 取下一个，end_poll 释放
+static int mock_next_wc(mock_cq *cq)
+{
+    if (cq->wcs.empty()) return ENOENT;
+    cq->cur = cq->wcs.front();
+    cq->cur_ts = cq->ts.front();
+    cq->wcs.pop_front();
+    cq->ts.pop_front();
+    cq->cq_ex.wr_id = cq->cur.wr_id;
+    cq->cq_ex.status = cq->cur.status;
+    return 0;
+}
+
+static int mock_start_poll(struct ibv_cq_ex *ibcq, struct ibv_poll_cq_attr *attr)
+{
+    (void)attr;
+    mock_cq *cq = (mock_cq *)ibcq;
+    pthread_mutex_lock(&cq->lock);
+    if (cq->wcs.empty()) {
+        uint64_t now = mock_now_ns();
+        for (size_t i = 0; i < cq->qps.size(); i++) mock_generate(cq, cq->qps[i], now);
+    }
+    int ret = mock_next_wc(cq);
+    if (ret) pthread_mutex_unlock(&cq->lock);  // ENOENT 时调用方不会再调 end_poll
+    return ret;
+}
+
+static int mock_next_poll(struct ibv_cq_ex *ibcq) { return mock_next_wc((mock_cq *)ibcq); }
+static void mock_end_poll(struct ibv_cq_ex *ibcq) { pthread_mutex_unlock(&((mock_cq *)ibcq)->lock); }
+static enum ibv_wc_opcode mock_read_opcode(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.opcode; }
+static uint32_t mock_read_vendor_err(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.vendor_err; }
+static uint32_t mock_read_byte_len(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.byte_len; }
+static __be32 mock_read_imm_data(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.imm_data; }
+static uint32_t mock_read_qp_num(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.qp_num; }
+static uint32_t mock_read_src_qp(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.src_qp; }
+static unsigned int mock_read_wc_flags(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur.wc_flags; }
+static uint64_t mock_read_wallclock(struct ibv_cq_ex *ibcq) { return ((mock_cq *)ibcq)->cur_ts; }
+
+static int mock_req_notify_cq(struct ibv_cq *ibcq, int solicited_only)
+{
+    (void)solicited_only;
+    mock_cq *cq = (mock_cq *)ibcq;
+    if (!cq->channel) return EINVAL;
+    pthread_mutex_lock(&cq->lock);
+    cq->armed = true;
+    pthread_mutex_unlock(&cq->lock);
+    return 0;
+}
+
+static void *mock_channel_thread(void *arg)
+{
+    mock_channel *c = (mock_channel *)arg;
+    struct timespec tick = { 0, MOCK_CHANNEL_TICK_NS };
+    while (!c->stop) {
+        nanosleep(&tick, NULL);
+        uint64_t now = mock_now_ns();
+        pthread_mutex_lock(&c->lock);
+        for (size_t i = 0; i < c->cqs.size(); i++) {
+            mock_cq *cq = c->cqs[i];
+            pthread_mutex_lock(&cq->lock);
+            if (cq->armed) {
+                for (size_t k = 0; k < cq->qps.size(); k++) mock_generate(cq, cq->qps[k], now);
+                if (!cq->wcs.empty()) {
+                    uint64_t one = 1;
+                    cq->armed = false;
+                    c->fired.push_back(cq);
+                    if (write(c->ch.fd, &one, sizeof(one)) != sizeof(one)) perror("[ibv-mock] eventfd write");
+                }
+            }
+            pthread_mutex_unlock(&cq->lock);
+        }
+        pthread_mutex_unlock(&c->lock);
+    }
+    return NULL;
+}
+
+static int mock_post_recv(struct ibv_qp *ibqp, struct ibv_recv_wr *wr, struct ibv_recv_wr **bad_wr)
+{
+    mock_qp *q = (mock_qp *)ibqp;
+    pthread_mutex_lock(&q->recv_cq->lock);
+    for (; wr; wr = wr->next) {
+        if (wr->num_sge > MOCK_MAX_SGE || q->rq.size() >= q->max_recv_wr) {
+            *bad_wr = wr;
+            pthread_mutex_unlock(&q->recv_cq->lock);
+            return wr->num_sge > MOCK_MAX_SGE ? EINVAL : ENOMEM;
+        }
+        mock_recv r;
+        r.wr_id = wr->wr_id;
+        r.num_sge = wr->num_sge;
+        memcpy(r.sge, wr->sg_list, sizeof(struct ibv_sge) * wr->num_sge);
+        q->rq.push_back(r);
+        __atomic_fetch_add(&g_stats.posted, 1, __ATOMIC_RELAXED);
+    }
+    // RC QP 的接收 WR 只由对端的 SEND/WRITE_WITH_IMM 消耗
+    if (q->t_start == 0 && q->qp.qp_type != IBV_QPT_RC) q->t_start = mock_now_ns();
+    pthread_mutex_unlock(&q->recv_cq->lock);
+    return 0;
+}
+
+// RC：同进程内的对端 QP 立即"收到"数据。RDMA WRITE 直接拷进 rkey 指向的内存，
+// WRITE_WITH_IMM 再消耗对端一个接收 WR 并在对端 recv CQ 上产生 IBV_WC_RECV_RDMA_WITH_IMM
+static enum ibv_wc_status mock_rc_deliver(mock_qp *q, const struct ibv_send_wr *wr)
+{
+    mock_qp *peer = mock_find_qp(q->dest_qpn);
+    if (!peer || q->qp.state != IBV_QPS_RTS) return IBV_WC_RETRY_EXC_ERR;
+    if (wr->opcode != IBV_WR_RDMA_WRITE && wr->opcode != IBV_WR_RDMA_WRITE_WITH_IMM) return IBV_WC_REM_INV_REQ_ERR;
+    uint64_t len = 0;
+    for (int i = 0; i < wr->num_sge; i++) {
+        if (!mock_sge_valid(&wr->sg_list[i])) return IBV_WC_LOC_PROT_ERR;
+        len += wr->sg_list[i].length;
+    }
+    if (len && !mock_rkey_valid(wr->wr.rdma.rkey, wr->wr.rdma.remote_addr, len)) return IBV_WC_REM_ACCESS_ERR;
+    uint64_t off = 0;
+    for (int i = 0; i < wr->num_sge; i++) {
+        memcpy((void *)(uintptr_t)(wr->wr.rdma.remote_addr + off), (void *)(uintptr_t)wr->sg_list[i].addr, wr->sg_list[i].length);
+        off += wr->sg_list[i].length;
+    }
+    if (wr->opcode == IBV_WR_RDMA_WRITE_WITH_IMM) {
+        mock_cq *rcq = peer->recv_cq;
+        pthread_mutex_lock(&rcq->lock);
+        if (peer->rq.empty()) {
+            pthread_mutex_unlock(&rcq->lock);
+            __atomic_fetch_add(&g_stats.no_wr_drops, 1, __ATOMIC_RELAXED);
+            return IBV_WC_RNR_RETRY_EXC_ERR;
+        }
+        struct ibv_wc wc;
+        memset(&wc, 0, sizeof(wc));
+        wc.wr_id = peer->rq.front().wr_id;
+        peer->rq.pop_front();
+        wc.status = IBV_WC_SUCCESS;
+        wc.opcode = IBV_WC_RECV_RDMA_WITH_IMM;
+        wc.wc_flags = IBV_WC_WITH_IMM;
+        wc.imm_data = wr->imm_data;
+        wc.byte_len = (uint32_t)len;
+        wc.qp_num = peer->qp.qp_num;
+        wc.src_qp = q->qp.qp_num;
+        rcq->wcs.push_back(wc);
+        rcq->ts.push_back(mock_wallclock_ns(mock_now_ns()));
+        pthread_mutex_unlock(&rcq->lock);
+        __atomic_fetch_add(&g_stats.completed, 1, __ATOMIC_RELAXED);
+    }
+    return IBV_WC_SUCCESS;
+}
+
+static int mock_post_send(struct ibv_qp *ibqp, struct ibv_send_wr *wr, struct ibv_send_wr **bad_wr)
+{
+    mock_qp *q = (mock_qp *)ibqp;
+    (void)bad_wr;
+    for (; wr; wr = wr->next) {
+        struct ibv_wc wc;
+        memset(&wc, 0, sizeof(wc));
+        wc.wr_id = wr->wr_id;
+        wc.status = IBV_WC_SUCCESS;
+        wc.opcode = IBV_WC_SEND;
+        wc.qp_num = q->qp.qp_num;
+        if (q->qp.qp_type == IBV_QPT_RC) {
+            wc.status = mock_rc_deliver(q, wr);
+            wc.opcode = IBV_WC_RDMA_WRITE;
+            // 未请求完成的成功 WR 不产生 CQE
+            if (wc.status == IBV_WC_SUCCESS && !(wr->send_flags & IBV_SEND_SIGNALED)) continue;
+        }
+        pthread_mutex_lock(&q->send_cq->lock);
+        q->send_cq->wcs.push_back(wc);
+        q->send_cq->ts.push_back(mock_wallclock_ns(mock_now_ns()));
+        pthread_mutex_unlock(&q->send_cq->lock);
+        __atomic_fetch_add(&g_stats.sent, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+static int mock_query_port(struct ibv_context *context, uint8_t port_num, struct ibv_port_attr *port_attr, size_t port_attr_len)
+{
+    (void)context;
+    if (port_num != 1) return EINVAL;
+    memset(port_attr, 0, port_attr_len);
+    port_attr->state = IBV_PORT_ACTIVE;
+    port_attr->link_layer = IBV_LINK_LAYER_ETHERNET;
+    port_attr->max_mtu = IBV_MTU_4096;
+    port_attr->active_mtu = IBV_MTU_4096;
+    port_attr->gid_tbl_len = 1;
+    return 0;
+}
+
+// 从 ETH/IPv4/UDP 规则取出帧头，作为该 QP 收到的包的头部
+static struct ibv_flow *mock_create_flow(struct ibv_qp *ibqp, struct ibv_flow_attr *attr)
+{
+    mock_qp *q = (mock_qp *)ibqp;
+    if (q->nflows == MOCK_MAX_FLOWS) { errno = ENOSPC; return NULL; }
+    uint8_t *p = q->hdr[q->nflows];
+    memset(p, 0, MOCK_FRAME_HDR_LEN);
+    p[12] = 0x08; p[13] = 0x00;
+    p[14] = 0x45; p[22] = 64; p[23] = 17;
+    uint8_t *spec = (uint8_t *)(attr + 1);
+    for (int i = 0; i < attr->num_of_specs; i++) {
+        struct ibv_flow_spec *s = (struct ibv_flow_spec *)spec;
+        if (s->hdr.type == IBV_FLOW_SPEC_ETH) {
+            memcpy(p, s->eth.val.dst_mac, 6);
+            memcpy(p + 6, s->eth.val.src_mac, 6);
+        } else if (s->hdr.type == IBV_FLOW_SPEC_IPV4) {
+            memcpy(p + 26, &s->ipv4.val.src_ip, 4);
+            memcpy(p + 30, &s->ipv4.val.dst_ip, 4);
+        } else if (s->hdr.type == IBV_FLOW_SPEC_UDP) {
+            memcpy(p + 34, &s->tcp_udp.val.src_port, 2);
+            memcpy(p + 36, &s->tcp_udp.val.dst_port, 2);
+        } else {
+            errno = EOPNOTSUPP;
+            return NULL;
+        }
+        spec += s->hdr.size;
+    }
+    q->nflows++;
+    if (g_cfg.no_steering) {
+        // 规则仍用来生成本流的帧头，但像不支持 steering 的网卡一样返回失败
+        q->unsteered = true;
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+    struct ibv_flow *flow = (struct ibv_flow *)calloc(1, sizeof(struct ibv_flow));
+    if (!flow) { errno = ENOMEM; return NULL; }
+    flow->context = ibqp->context;
+    return flow;
+}
+
+static int mock_destroy_flow(struct ibv_flow *flow)
+{
+    free(flow);
+    return 0;
+}
+
+extern "C" {
+
+void ibv_mock_configure(const struct ibv_mock_config *config)
+{
+    g_cfg = *config;
+    if (g_cfg.burst == 0) g_cfg.burst = 1;
+    g_cfg_loaded = true;
+}
+
+void ibv_mock_get_stats(struct ibv_mock_stats *stats)
+{
+    stats->posted = __atomic_load_n(&g_stats.posted, __ATOMIC_RELAXED);
+    stats->completed = __atomic_load_n(&g_stats.completed, __ATOMIC_RELAXED);
+    stats->wire_drops = __atomic_load_n(&g_stats.wire_drops, __ATOMIC_RELAXED);
+    stats->no_wr_drops = __atomic_load_n(&g_stats.no_wr_drops, __ATOMIC_RELAXED);
+    stats->reordered = __atomic_load_n(&g_stats.reordered, __ATOMIC_RELAXED);
+    stats->errors = __atomic_load_n(&g_stats.errors, __ATOMIC_RELAXED);
+    stats->prot_errors = __atomic_load_n(&g_stats.prot_errors, __ATOMIC_RELAXED);
+    stats->sent = __atomic_load_n(&g_stats.sent, __ATOMIC_RELAXED);
+    stats->strays = __atomic_load_n(&g_stats.strays, __ATOMIC_RELAXED);
+}
+
+struct ibv_device **(ibv_get_device_list)(int *num_devices)
+{
+    mock_load_config();
+    unsigned int n = g_cfg.devices;
+    if (n == 0) n = 1;
+    if (n > MOCK_MAX_DEVICES) n = MOCK_MAX_DEVICES;
+    for (unsigned int i = 0; i < n; i++) {
+        snprintf(g_devices[i].name, sizeof(g_devices[i].name), "mock_%u", i);
+        snprintf(g_devices[i].dev_name, sizeof(g_devices[i].dev_name), "uverbs_mock%u", i);
+        g_devices[i].transport_type = IBV_TRANSPORT_IB;
+        g_device_list[i] = &g_devices[i];
+    }
+    g_device_list[n] = NULL;
+    if (num_devices) *num_devices = (int)n;
+    return g_device_list;
+}
+
+void ibv_free_device_list(struct ibv_device **list)
+{
+    (void)list;
+}
+
+const char *ibv_get_device_name(struct ibv_device *device)
+{
+    return device->name;
+}
+
+static struct ibv_cq_ex *mock_create_cq_ex(struct ibv_context *context, struct ibv_cq_init_attr_ex *attr);
+
+struct ibv_context *ibv_open_device(struct ibv_device *device)
+{
+    mock_load_config();
+    struct verbs_context *vctx = (struct verbs_context *)calloc(1, sizeof(struct verbs_context));
+    if (!vctx) { errno = ENOMEM; return NULL; }
+    vctx->sz = sizeof(struct verbs_context);
+    vctx->query_port = mock_query_port;
+    vctx->ibv_create_flow = mock_create_flow;
+    vctx->ibv_destroy_flow = mock_destroy_flow;
+    vctx->create_cq_ex = mock_create_cq_ex;
+    struct ibv_context *ctx = &vctx->context;
+    ctx->device = device;
+    ctx->abi_compat = __VERBS_ABI_IS_EXTENDED;
+    ctx->ops.poll_cq = mock_poll_cq;
+    ctx->ops.req_notify_cq = mock_req_notify_cq;
+    ctx->ops.post_recv = mock_post_recv;
+    ctx->ops.post_send = mock_post_send;
+    pthread_mutex_init(&ctx->mutex, NULL);
+    printf("[ibv-mock] opened %s: pps=%.0f burst=%u drop=%g reorder=%g error=%g frame_len=%u\n",
+           device->name, g_cfg.pps, g_cfg.burst, g_cfg.drop, g_cfg.reorder, g_cfg.error, g_cfg.frame_len);
+    return ctx;
+}
+
+int ibv_close_device(struct ibv_context *context)
+{
+    struct ibv_mock_stats s;
+    ibv_mock_get_stats(&s);
+    printf("[ibv-mock] posted=%lu completed=%lu wire_drops=%lu no_wr_drops=%lu reordered=%lu errors=%lu prot_errors=%lu sent=%lu strays=%lu\n",
+           (unsigned long)s.posted, (unsigned long)s.completed, (unsigned long)s.wire_drops,
+           (unsigned long)s.no_wr_drops, (unsigned long)s.reordered, (unsigned long)s.errors,
+           (unsigned long)s.prot_errors, (unsigned long)s.sent, (unsigned long)s.strays);
+    struct verbs_context *vctx = (struct verbs_context *)((uint8_t *)context - offsetof(struct verbs_context, context));
+    free(vctx);
+    return 0;
+}
+
+int (ibv_query_port)(struct ibv_context *context, uint8_t port_num, struct _compat_ibv_port_attr *port_attr)
+{
+    // 旧版结构体到 link_layer 为止
+    return mock_query_port(context, port_num, (struct ibv_port_attr *)port_attr, offsetof(struct ibv_port_attr, flags));
+}
+
+const char *ibv_wc_status_str(enum ibv_wc_status status)
+{
+    switch (status) {
+        case IBV_WC_SUCCESS: return "success";
+        case IBV_WC_LOC_PROT_ERR: return "local protection error";
+        case IBV_WC_REM_INV_REQ_ERR: return "remote invalid request error";
+        case IBV_WC_REM_ACCESS_ERR: return "remote access error";
+        case IBV_WC_RETRY_EXC_ERR: return "transport retry counter exceeded";
+        case IBV_WC_RNR_RETRY_EXC_ERR: return "RNR retry counter exceeded";
+        case IBV_WC_GENERAL_ERR: return "general error";
+        default: return "unknown";
+    }
+}
+
+// 唯一的 GID 是 ::ffff:127.0.0.1
+int ibv_query_gid(struct ibv_context *context, uint8_t port_num, int index, union ibv_gid *gid)
+{
+    (void)context;
+    if (port_num != 1 || index != 0) return EINVAL;
+    memset(gid, 0, sizeof(*gid));
+    gid->raw[10] = 0xff; gid->raw[11] = 0xff;
+    gid->raw[12] = 127; gid->raw[15] = 1;
+    return 0;
+}
+
+struct ibv_pd *ibv_alloc_pd(struct ibv_context *context)
+{
+    struct ibv_pd *pd = (struct ibv_pd *)calloc(1, sizeof(struct ibv_pd));
+    if (!pd) { errno = ENOMEM; return NULL; }
+    pd->context = context;
+    return pd;
+}
+
+int ibv_dealloc_pd(struct ibv_pd *pd)
+{
+    free(pd);
+    return 0;
+}
+
+struct ibv_mr *ibv_reg_mr_iova2(struct ibv_pd *pd, void *addr, size_t length, uint64_t iova, unsigned int access)
+{
+    (void)iova;
+    if (!pd || (!addr && length)) { errno = EINVAL; return NULL; }
+    struct ibv_mr *mr = (struct ibv_mr *)calloc(1, sizeof(struct ibv_mr));
+    if (!mr) { errno = ENOMEM; return NULL; }
+    mr->context = pd->context;
+    mr->pd = pd;
+    mr->addr = addr;
+    mr->length = length;
+    pthread_mutex_lock(&g_lock);
+    mr->handle = g_next_key;
+    mr->lkey = g_next_key;
+    mr->rkey = (access & (IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ)) ? g_next_key : 0;
+    g_next_key++;
+    g_mrs.push_back(mr);
+    mock_mr_publish();
+    pthread_mutex_unlock(&g_lock);
+    return mr;
+}
+
+struct ibv_mr *(ibv_reg_mr)(struct ibv_pd *pd, void *addr, size_t length, int access)
+{
+    return ibv_reg_mr_iova2(pd, addr, length, (uintptr_t)addr, (unsigned int)access);
+}
+
+int ibv_dereg_mr(struct ibv_mr *mr)
+{
+    pthread_mutex_lock(&g_lock);
+    for (size_t i = 0; i < g_mrs.size(); i++) {
+        if (g_mrs[i] == mr) { g_mrs.erase(g_mrs.begin() + i); break; }
+    }
+    mock_mr_publish();
+    pthread_mutex_unlock(&g_lock);
+    free(mr);
+    return 0;
+}
+
+struct ibv_comp_channel *ibv_create_comp_channel(struct ibv_context *context)
+{
+    mock_channel *c = new mock_channel();
+    c->ch.context = context;
+    c->ch.refcnt = 0;
+    c->ch.fd = eventfd(0, EFD_SEMAPHORE);
+    c->stop = false;
+    pthread_mutex_init(&c->lock, NULL);
+    if (c->ch.fd < 0 || pthread_create(&c->tid, NULL, mock_channel_thread, c) != 0) {
+        if (c->ch.fd >= 0) close(c->ch.fd);
+        pthread_mutex_destroy(&c->lock);
+        delete c;
+        errno = ENOMEM;
+        return NULL;
+    }
+    return &c->ch;
+}
+
+int ibv_destroy_comp_channel(struct ibv_comp_channel *channel)
+{
+    mock_channel *c = (mock_channel *)channel;
+    if (!c->cqs.empty()) return EBUSY;
+    c->stop = true;
+    pthread_join(c->tid, NULL);
+    close(c->ch.fd);
+    pthread_mutex_destroy(&c->lock);
+    delete c;
+    return 0;
+}
+
+int ibv_get_cq_event(struct ibv_comp_channel *channel, struct ibv_cq **cq, void **cq_context)
+{
+    mock_channel *c = (mock_channel *)channel;
+    uint64_t n;
+    if (read(c->ch.fd, &n, sizeof(n)) != sizeof(n)) return -1;
+    pthread_mutex_lock(&c->lock);
+    mock_cq *fired = c->fired.empty() ? NULL : c->fired.front();
+    if (fired) c->fired.pop_front();
+    pthread_mutex_unlock(&c->lock);
+    if (!fired) return -1;
+    *cq = &fired->cq;
+    *cq_context = fired->cq.cq_context;
+    return 0;
+}
+
+void ibv_ack_cq_events(struct ibv_cq *cq, unsigned int nevents)
+{
+    (void)cq;
+    (void)nevents;
+}
+
+struct ibv_cq *ibv_create_cq(struct ibv_context *context, int cqe, void *cq_context,
+                             struct ibv_comp_channel *channel, int comp_vector)
+{
+    (void)comp_vector;
+    if (cqe <= 0) { errno = EINVAL; return NULL; }
+    mock_cq *cq = new mock_cq();
+    pthread_mutex_init(&cq->lock, NULL);
+    cq->cq.context = context;
+    cq->cq.channel = channel;
+    cq->cq.cq_context = cq_context;
+    cq->cq.cqe = cqe;
+    cq->channel = (mock_channel *)channel;
+    cq->armed = false;
+    if (cq->channel) {
+        pthread_mutex_lock(&cq->channel->lock);
+        cq->channel->cqs.push_back(cq);
+        pthread_mutex_unlock(&cq->channel->lock);
+    }
+    return &cq->cq;
+}
+
+// 只支持标准字段和 wallclock 完成时间戳（按速率推算的到达时刻），用于测量睡眠唤醒的延迟
+static struct ibv_cq_ex *mock_create_cq_ex(struct ibv_context *context, struct ibv_cq_init_attr_ex *attr)
+{
+    if (attr->comp_mask || (attr->wc_flags & ~(uint64_t)(IBV_WC_STANDARD_FLAGS | IBV_WC_EX_WITH_COMPLETION_TIMESTAMP_WALLCLOCK))) {
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+    struct ibv_cq *ibcq = ibv_create_cq(context, (int)attr->cqe, attr->cq_context, attr->channel, (int)attr->comp_vector);
+    if (!ibcq) return NULL;
+    mock_cq *cq = (mock_cq *)ibcq;
+    cq->cq_ex.start_poll = mock_start_poll;
+    cq->cq_ex.next_poll = mock_next_poll;
+    cq->cq_ex.end_poll = mock_end_poll;
+    cq->cq_ex.read_opcode = mock_read_opcode;
+    cq->cq_ex.read_vendor_err = mock_read_vendor_err;
+    cq->cq_ex.read_byte_len = mock_read_byte_len;
+    cq->cq_ex.read_imm_data = mock_read_imm_data;
+    cq->cq_ex.read_qp_num = mock_read_qp_num;
+    cq->cq_ex.read_src_qp = mock_read_src_qp;
+    cq->cq_ex.read_wc_flags = mock_read_wc_flags;
+    cq->cq_ex.read_completion_wallclock_ns = mock_read_wallclock;
+    return &cq->cq_ex;
+}
+
+int ibv_destroy_cq(struct ibv_cq *cq)
+{
+    mock_cq *c = (mock_cq *)cq;
+    if (!c->qps.empty()) return EBUSY;
+    if (c->channel) {
+        pthread_mutex_lock(&c->channel->lock);
+        std::vector<mock_cq *> &cqs = c->channel->cqs;
+        for (size_t i = 0; i < cqs.size(); i++) {
+            if (cqs[i] == c) { cqs.erase(cqs.begin() + i); break; }
+        }
+        for (size_t i = 0; i < c->channel->fired.size(); i++) {
+            if (c->channel->fired[i] == c) { c->channel->fired.erase(c->channel->fired.begin() + i); break; }
+        }
+        pthread_mutex_unlock(&c->channel->lock);
+    }
+    pthread_mutex_destroy(&c->lock);
+    delete c;
+    return 0;
+}
+
+struct ibv_qp *ibv_create_qp(struct ibv_pd *pd, struct ibv_qp_init_attr *attr)
+{
+    if (!attr->send_cq || !attr->recv_cq || attr->cap.max_recv_sge > MOCK_MAX_SGE) { errno = EINVAL; return NULL; }
+    mock_qp *q = new mock_qp();
+    q->qp.context = pd->context;
+    q->qp.qp_context = attr->qp_context;
+    q->qp.pd = pd;
+    q->qp.send_cq = attr->send_cq;
+    q->qp.recv_cq = attr->recv_cq;
+    q->qp.qp_type = attr->qp_type;
+    q->qp.state = IBV_QPS_RESET;
+    pthread_mutex_lock(&g_lock);
+    q->qp.qp_num = g_next_qpn++;
+    g_qps.push_back(q);
+    pthread_mutex_unlock(&g_lock);
+    q->send_cq = (mock_cq *)attr->send_cq;
+    q->recv_cq = (mock_cq *)attr->recv_cq;
+    q->max_recv_wr = attr->cap.max_recv_wr;
+    q->dest_qpn = 0;
+    q->t_start = 0;
+    q->arrived = 0;
+    q->next_seq = 0;
+    q->held_seq = 0;
+    q->has_held = false;
+    q->unsteered = false;
+    q->rng = 0x9e3779b97f4a7c15ull ^ ((uint64_t)g_cfg.seed << 32) ^ q->qp.qp_num;
+    memset(q->hdr, 0, sizeof(q->hdr));
+    q->nflows = 0;
+    q->recv_cq->qps.push_back(q);
+    return &q->qp;
+}
+
+int ibv_modify_qp(struct ibv_qp *qp, struct ibv_qp_attr *attr, int attr_mask)
+{
+    if (attr_mask & IBV_QP_STATE) qp->state = attr->qp_state;
+    if (attr_mask & IBV_QP_DEST_QPN) ((mock_qp *)qp)->dest_qpn = attr->dest_qp_num;
+    return 0;
+}
+
+int ibv_query_qp(struct ibv_qp *qp, struct ibv_qp_attr *attr, int attr_mask, struct ibv_qp_init_attr *init_attr)
+{
+    (void)attr_mask;
+    memset(attr, 0, sizeof(*attr));
+    attr->qp_state = qp->state;
+    attr->cur_qp_state = qp->state;
+    if (init_attr) {
+        memset(init_attr, 0, sizeof(*init_attr));
+        init_attr->send_cq = qp->send_cq;
+        init_attr->recv_cq = qp->recv_cq;
+        init_attr->qp_type = qp->qp_type;
+    }
+    return 0;
+}
+
+int ibv_destroy_qp(struct ibv_qp *qp)
+{
+    mock_qp *q = (mock_qp *)qp;
+    pthread_mutex_lock(&g_lock);
+    for (size_t i = 0; i < g_qps.size(); i++) {
+        if (g_qps[i] == q) { g_qps.erase(g_qps.begin() + i); break; }
+    }
+    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_lock(&q->recv_cq->lock);
+    std::vector<mock_qp *> &qps = q->recv_cq->qps;
+    for (size_t i = 0; i < qps.size(); i++) {
+        if (qps[i] == q) { qps.erase(qps.begin() + i); break; }
+    }
+    pthread_mutex_unlock(&q->recv_cq->lock);
+    delete q;
+    return 0;
+}
+
+}
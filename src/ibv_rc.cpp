@@ -0,0 +1,249 @@
+//RC QP 建连工具：TCP 带外交换 QP/GID/ring 信息，RESET -> INIT -> RTR -> RTS，以及 block credit 收发
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <endian.h>
+#include <time.h>
+
+#include "ibv_rc.h"
+
+#define RC_WIRE_LEN 64
+
+static int write_all(int sock, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_all(int sock, void *buf, size_t len)
+{
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = recv(sock, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int rc_listen(uint16_t port)
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0) { ibv_utils_error("Failed to create RC listen socket."); return -1; }
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 1) < 0) {
+        fprintf(stderr, "[rc_listen] bind/listen on port %u failed: %s\n", port, strerror(errno));
+        close(lfd);
+        return -1;
+    }
+    printf("[rc_listen] Waiting for RC sender on TCP port %u...\n", port);
+    fflush(stdout);
+    int fd = accept(lfd, NULL, NULL);
+    close(lfd);
+    if (fd < 0) { ibv_utils_error("Failed to accept RC sender."); return -1; }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+int rc_connect(const char *host, uint16_t port)
+{
+    struct addrinfo hints, *res = NULL;
+    char service[8];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &res) != 0 || !res) {
+        fprintf(stderr, "[rc_connect] Cannot resolve %s\n", host);
+        return -1;
+    }
+    int fd = -1;
+    // 接收端可能还没进入 listen，重试 10 秒
+    for (int i = 0; i < 100 && fd < 0; i++) {
+        fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (fd < 0) break;
+        if (connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+            struct timespec ts = { 0, 100000000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) { fprintf(stderr, "[rc_connect] Failed to connect to %s:%u\n", host, port); return -1; }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// 线上格式固定为大端，两端可以是不同架构
+int rc_exchange(int sock, const struct ibv_rc_info *local, struct ibv_rc_info *remote)
+{
+    uint8_t buf[RC_WIRE_LEN];
+    memset(buf, 0, sizeof(buf));
+    uint32_t v32;
+    uint16_t v16;
+    uint64_t v64;
+    v32 = htobe32(local->qpn); memcpy(buf + 0, &v32, 4);
+    v32 = htobe32(local->psn); memcpy(buf + 4, &v32, 4);
+    v16 = htobe16(local->lid); memcpy(buf + 8, &v16, 2);
+    memcpy(buf + 10, local->gid, 16);
+    v64 = htobe64(local->ring_addr); memcpy(buf + 26, &v64, 8);
+    v64 = htobe64(local->ring_bytes); memcpy(buf + 34, &v64, 8);
+    v64 = htobe64(local->block_bytes); memcpy(buf + 42, &v64, 8);
+    v32 = htobe32(local->rkey); memcpy(buf + 50, &v32, 4);
+    v32 = htobe32(local->nblocks); memcpy(buf + 54, &v32, 4);
+    if (write_all(sock, buf, sizeof(buf)) < 0 || read_all(sock, buf, sizeof(buf)) < 0) {
+        ibv_utils_error("Failed to exchange RC connection info.");
+        return -1;
+    }
+    memcpy(&v32, buf + 0, 4); remote->qpn = be32toh(v32);
+    memcpy(&v32, buf + 4, 4); remote->psn = be32toh(v32);
+    memcpy(&v16, buf + 8, 2); remote->lid = be16toh(v16);
+    memcpy(remote->gid, buf + 10, 16);
+    memcpy(&v64, buf + 26, 8); remote->ring_addr = be64toh(v64);
+    memcpy(&v64, buf + 34, 8); remote->ring_bytes = be64toh(v64);
+    memcpy(&v64, buf + 42, 8); remote->block_bytes = be64toh(v64);
+    memcpy(&v32, buf + 50, 4); remote->rkey = be32toh(v32);
+    memcpy(&v32, buf + 54, 4); remote->nblocks = be32toh(v32);
+    return 0;
+}
+
+int rc_send_credit(int sock, uint32_t block_idx)
+{
+    uint32_t v = htonl(block_idx);
+    return write_all(sock, &v, sizeof(v));
+}
+
+int rc_recv_credit(int sock, uint32_t *block_idx)
+{
+    uint32_t v;
+    if (read_all(sock, &v, sizeof(v)) < 0) return -1;
+    *block_idx = ntohl(v);
+    return 0;
+}
+
+int create_rc_res(struct ibv_utils_res *ib_res, int send_wr_num, int recv_wr_num)
+{
+    int wr_num = send_wr_num > recv_wr_num ? send_wr_num : recv_wr_num;
+    ib_res->send_nsge = 1;
+    ib_res->recv_nsge = 1;
+    ib_res->send_wr_num = send_wr_num;
+    ib_res->recv_wr_num = recv_wr_num;
+    ib_res->pd = ibv_alloc_pd(ib_res->context);
+    if (!ib_res->pd) { ibv_utils_error("Failed to allocate PD."); return -1; }
+    ib_res->cq = ibv_create_cq(ib_res->context, wr_num, NULL, NULL, 0);
+    if(!ib_res->cq){ ibv_utils_error("Couldn't create CQ."); return -2; }
+    struct ibv_qp_init_attr qp_init_attr;
+    memset(&qp_init_attr, 0, sizeof(qp_init_attr));
+    qp_init_attr.send_cq = ib_res->cq;
+    qp_init_attr.recv_cq = ib_res->cq;
+    qp_init_attr.cap.max_send_wr = (uint32_t)(send_wr_num > 0 ? send_wr_num : 1);
+    qp_init_attr.cap.max_recv_wr = (uint32_t)(recv_wr_num > 0 ? recv_wr_num : 1);
+    qp_init_attr.cap.max_send_sge = 1;
+    qp_init_attr.cap.max_recv_sge = 1;
+    qp_init_attr.qp_type = IBV_QPT_RC;
+    ib_res->qp = ibv_create_qp(ib_res->pd, &qp_init_attr);
+    if(!ib_res->qp){ ibv_utils_error("Couldn't create RC QP."); return -4; }
+    ib_res->sge = (struct ibv_sge *)calloc(wr_num, sizeof(struct ibv_sge));
+    if(!ib_res->sge) { ibv_utils_error("Failed to allocate memory for sge."); return -5; }
+    if(ib_res->send_wr_num > 0) { ib_res->send_wr = (struct ibv_send_wr *)calloc(ib_res->send_wr_num, sizeof(struct ibv_send_wr)); if(!ib_res->send_wr){ ibv_utils_error("Failed to allocate memory for send_wr."); return -6; } }
+    if(ib_res->recv_wr_num > 0) { ib_res->recv_wr = (struct ibv_recv_wr *)calloc(ib_res->recv_wr_num, sizeof(struct ibv_recv_wr)); if(!ib_res->recv_wr){ ibv_utils_error("Failed to allocate memory for recv_wr."); return -7; } }
+    ib_res->wc = (struct ibv_wc *)malloc(wr_num * sizeof(struct ibv_wc)); if(!ib_res->wc){ ibv_utils_error("Failed to allocate memory for wc."); return -8; }
+    ib_res->wc_tmp = (struct ibv_wc *)malloc(wr_num * sizeof(struct ibv_wc)); if(!ib_res->wc_tmp){ ibv_utils_error("Failed to allocate memory for wc_tmp."); return -8; }
+    return 0;
+}
+
+int rc_local_info(struct ibv_utils_res *ib_res, int gid_index, struct ibv_rc_info *info)
+{
+    struct ibv_port_attr port_attr;
+    union ibv_gid gid;
+    memset(info, 0, sizeof(*info));
+    if (ibv_query_port(ib_res->context, 1, &port_attr) != 0) { ibv_utils_error("Failed to query port 1."); return -1; }
+    memset(&gid, 0, sizeof(gid));
+    if (gid_index >= 0 && ibv_query_gid(ib_res->context, 1, gid_index, &gid) != 0) {
+        ibv_utils_error("Failed to query GID.");
+        return -2;
+    }
+    if (port_attr.link_layer == IBV_LINK_LAYER_ETHERNET && gid_index < 0) {
+        ibv_utils_error("RoCE port requires a GID index.");
+        return -3;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    info->qpn = ib_res->qp->qp_num;
+    info->psn = (uint32_t)(ts.tv_nsec ^ ib_res->qp->qp_num) & 0xffffff;
+    info->lid = port_attr.lid;
+    memcpy(info->gid, gid.raw, 16);
+    return 0;
+}
+
+int init_rc_res(struct ibv_utils_res *ib_res, int gid_index, const struct ibv_rc_info *local, const struct ibv_rc_info *remote)
+{
+    struct ibv_qp_attr qp_attr;
+    struct ibv_port_attr port_attr;
+    if (ibv_query_port(ib_res->context, 1, &port_attr) != 0) { ibv_utils_error("Failed to query port 1."); return -1; }
+
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    qp_attr.qp_state = IBV_QPS_INIT;
+    qp_attr.pkey_index = 0;
+    qp_attr.port_num = 1;
+    qp_attr.qp_access_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE;
+    if (ibv_modify_qp(ib_res->qp, &qp_attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS)) {
+        ibv_utils_error("Failed to modify RC qp to INIT.");
+        return -1;
+    }
+
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    qp_attr.qp_state = IBV_QPS_RTR;
+    qp_attr.path_mtu = port_attr.active_mtu;
+    qp_attr.dest_qp_num = remote->qpn;
+    qp_attr.rq_psn = remote->psn;
+    qp_attr.max_dest_rd_atomic = 1;
+    qp_attr.min_rnr_timer = 12;
+    qp_attr.ah_attr.dlid = remote->lid;
+    qp_attr.ah_attr.port_num = 1;
+    if (gid_index >= 0) {
+        qp_attr.ah_attr.is_global = 1;
+        memcpy(qp_attr.ah_attr.grh.dgid.raw, remote->gid, 16);
+        qp_attr.ah_attr.grh.sgid_index = (uint8_t)gid_index;
+        qp_attr.ah_attr.grh.hop_limit = 64;
+    }
+    if (ibv_modify_qp(ib_res->qp, &qp_attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN |
+                      IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER)) {
+        ibv_utils_error("Failed to modify RC qp to RTR.");
+        return -2;
+    }
+
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    qp_attr.qp_state = IBV_QPS_RTS;
+    qp_attr.timeout = 14;
+    qp_attr.retry_cnt = 7;
+    qp_attr.rnr_retry = 7;
+    qp_attr.sq_psn = local->psn;
+    qp_attr.max_rd_atomic = 1;
+    if (ibv_modify_qp(ib_res->qp, &qp_attr, IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT |
+                      IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC)) {
+        ibv_utils_error("Failed to modify RC qp to RTS.");
+        return -3;
+    }
+    printf("[init_rc_res] RC QP %u connected to remote QP %u (mtu=%d)\n", local->qpn, remote->qpn, 128 << port_attr.active_mtu);
+    return 0;
+}
@@ -0,0 +1,380 @@
+//ibverbs 接收后端：RAW_PACKET QP 收包到内部缓冲，凑满一批后拷贝到 ring block
+#include <infiniband/verbs.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ibv_transport.h"
+
+#ifndef NO_CUDA
+#include <cuda_runtime.h>
+#define CUDA_CALL(x) do { cudaError_t err = (x); if (err != cudaSuccess) { fprintf(stderr, "CUDA error at %s:%d - %s\n", __FILE__, __LINE__, cudaGetErrorString(err)); } } while(0)
+#else
+#define CUDA_CALL(x) do {} while(0)
+#endif
+
+IbvRxTransport::IbvRxTransport(struct ibv_utils_res * ibv_res, unsigned int pkt_size, int RdmaDirectGpu, unsigned int pool_wr)
+    : res(ibv_res), pkt_size(pkt_size), RdmaDirectGpu(RdmaDirectGpu), lifo(NULL), nlifo(0),
+      posted((unsigned int)ibv_res->recv_wr_num), pool_wr(pool_wr), target(0)
+{
+    if (this->pool_wr > posted) this->pool_wr = posted;
+    target = this->pool_wr;
+    if (this->pool_wr) lifo = (uint32_t *)malloc(res->recv_wr_num * sizeof(uint32_t));
+}
+
+IbvRxTransport::~IbvRxTransport()
+{
+    free(lifo);
+}
+
+// 逐包拷贝：软件过滤时被拒绝的帧在 WR 序列中留下空洞；缓冲池模式下完成的包立即拷走。
+// 本次通过的 WR 串成一条链重新投递，返回的包数可以少于 pkt_num
+int IbvRxTransport::RecvEach(char * dst, unsigned int pkt_num)
+{
+    int want = (int)(pkt_num < res->poll_n ? pkt_num : res->poll_n);
+    int got = ib_poll_cq(res, want, res->wc);
+    int n = got;
+    res->recv_completed = n;
+    if (n <= 0) return n < 0 ? -1 : 0;
+    if (res->sw_filter) {
+        n = ibv_filter_completions(res, n);
+        if (n < 0) return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        struct ibv_sge * sge = &res->sge[res->wc[i].wr_id * res->recv_nsge];
+        if (res->wc[i].status != IBV_WC_SUCCESS) {
+            // 错误完成的缓冲内容无效，按丢包处理：slot 清零
+            if (this->RdmaDirectGpu != 0) CUDA_CALL(cudaMemset(dst + (long int)i * pkt_size, 0, pkt_size));
+            else memset(dst + (long int)i * pkt_size, 0, pkt_size);
+        } else if (this->RdmaDirectGpu != 0) {
+            CUDA_CALL(cudaMemcpy(dst + (long int)i * pkt_size, (void *)sge->addr, pkt_size, cudaMemcpyDefault));
+        } else {
+            memcpy(dst + (long int)i * pkt_size, (void *)sge->addr, pkt_size);
+        }
+        if (lifo) lifo[nlifo++] = (uint32_t)res->wc[i].wr_id;
+    }
+    if (!lifo) return ib_repost_chain(res, res->wc, 0, (unsigned int)n, 0) < 0 ? -1 : n;
+    // 被过滤掉的 WR 已经由 ibv_filter_completions 挂回去了
+    posted -= (unsigned int)n;
+    if (got < want) target = pool_wr;
+    else if (target < (unsigned int)res->recv_wr_num) target += (unsigned int)got;
+    unsigned int k = posted < target ? target - posted : 0;
+    if (k > nlifo) k = nlifo;
+    // 从栈顶取：刚拷完、缓存行还在 LLC 中的缓冲最先挂回接收队列
+    for (unsigned int i = 0; i < k; i++) {
+        struct ibv_recv_wr * wr = &res->recv_wr[i];
+        wr->wr_id = lifo[--nlifo];
+        wr->sg_list = &res->sge[wr->wr_id * res->recv_nsge];
+        wr->num_sge = res->recv_nsge;
+        wr->next = i + 1 < k ? &res->recv_wr[i + 1] : NULL;
+    }
+    if (k > 0 && ibv_post_recv(res->qp, res->recv_wr, &res->bad_recv_wr)) return -1;
+    posted += k;
+    return n;
+}
+
+// 完成环：wc_tmp 的 recv_wr_num 个槽位，wc_head 是最早一个未处理的完成，recv_sum_completed 是未处理数。
+// 完成直接 poll 到环的空闲处，凑满一批后拷贝出去并整批重新投递，不再在 wc 和 wc_tmp 之间来回搬。
+// 同时挂着的 WR 不超过 recv_wr_num，未处理的完成不会溢出环。
+int IbvRxTransport::Recv(char * dst, unsigned int pkt_num)
+{
+    if (res->sw_filter || lifo) return RecvEach(dst, pkt_num);
+    unsigned int ring = (unsigned int)res->recv_wr_num;
+    if (pkt_num > ring) {
+        printf("[IbvRxTransport] ERROR: batch of %u packets exceeds the %u receive WRs\n", pkt_num, ring);
+        return -1;
+    }
+    unsigned int pending = (unsigned int)res->recv_sum_completed;
+    if (pending < pkt_num) {
+        unsigned int tail = (res->wc_head + pending) % ring;
+        unsigned int room = ring - tail;    // 到环尾的连续空间
+        if (room > ring - pending) room = ring - pending;
+        if (room > res->poll_n) room = res->poll_n;
+        res->recv_completed = ib_poll_cq(res, room, res->wc_tmp + tail);
+        if (res->recv_completed < 0) return -1;
+        res->recv_sum_completed += res->recv_completed;
+        if ((unsigned int)res->recv_sum_completed < pkt_num) return 0;
+    }
+
+    // 内部缓冲中 WR 的 slot 步长是 nsge 个 SGE，比 pkt_size 大，按包拷贝；
+    // GPU 内存时 WR 号连续的一段用一次 cudaMemcpy2D。错误完成的缓冲内容无效，按丢包处理：slot 清零
+    unsigned int head = res->wc_head;
+    if (this->RdmaDirectGpu != 0) {
+        for (unsigned int i = 0; i < pkt_num;) {
+            const struct ibv_wc * wc = &res->wc_tmp[(head + i) % ring];
+            if (wc->status != IBV_WC_SUCCESS) {
+                CUDA_CALL(cudaMemset(dst + (long int)i * pkt_size, 0, pkt_size));
+                i++;
+                continue;
+            }
+            uint64_t id = wc->wr_id;
+            unsigned int run = 1;
+            while (i + run < pkt_num && res->wc_tmp[(head + i + run) % ring].wr_id == id + run &&
+                   res->wc_tmp[(head + i + run) % ring].status == IBV_WC_SUCCESS) run++;
+            CUDA_CALL(cudaMemcpy2D(dst + (long int)i * pkt_size, pkt_size, (void *)res->sge[id * res->recv_nsge].addr,
+                                   (size_t)res->recv_nsge * res->sge[0].length, pkt_size, run, cudaMemcpyDeviceToDevice));
+            i += run;
+        }
+    } else {
+        for (unsigned int i = 0; i < pkt_num; i++) {
+            const struct ibv_wc * wc = &res->wc_tmp[(head + i) % ring];
+            if (wc->status != IBV_WC_SUCCESS) memset(dst + (long int)i * pkt_size, 0, pkt_size);
+            else memcpy(dst + (long int)i * pkt_size, (void *)res->sge[wc->wr_id * res->recv_nsge].addr, pkt_size);
+        }
+    }
+
+    if (ib_repost_chain(res, res->wc_tmp, head, pkt_num, ring) < 0) return -1;
+    res->wc_head = (head + pkt_num) % ring;
+    res->recv_sum_completed -= pkt_num;
+    return (int)pkt_num;
+}
+
+static unsigned int add_segment(IbvDirectRing::Segment * seg, unsigned int n, uint32_t len, int kind)
+{
+    if (n < DIRECT_MAX_SGE) {
+        seg[n].len = len;
+        seg[n].kind = kind;
+    }
+    return n + 1;
+}
+
+unsigned int IbvDirectRing::Layout(const RoCEv2Dada::RdmaParam * param, const RxSubset * subset, Segment * seg)
+{
+    unsigned int n = 0;
+    uint32_t pos = 0;
+    unsigned int nruns = subset && subset->Active() ? subset->Runs() : 1;
+    for (unsigned int i = 0; i < nruns; i++) {
+        uint32_t off = subset && subset->Active() ? subset->GetRun(i).offset : 0;
+        uint32_t len = subset && subset->Active() ? subset->GetRun(i).len : param->pkt_size;
+        if (off > pos) n = add_segment(seg, n, off - pos, SEG_DROP);
+        // 第一段从包头开始
+        if (off == 0 && param->split_header) {
+            n = add_segment(seg, n, PKT_HEAD_LEN, SEG_HDR);
+            if (len > PKT_HEAD_LEN) n = add_segment(seg, n, len - PKT_HEAD_LEN, SEG_DATA);
+        } else {
+            n = add_segment(seg, n, len, SEG_DATA);
+        }
+        pos = off + len;
+    }
+    // 帧比 SGE 总长度长时网卡报 LOC_LEN_ERR，尾部不要的字节也要有去处
+    if (pos < param->pkt_size) n = add_segment(seg, n, param->pkt_size - pos, SEG_DROP);
+    return n;
+}
+
+IbvDirectRing::IbvDirectRing(const RoCEv2Dada::RdmaParam * param, struct ibv_utils_res * ibv_res, unsigned int depth,
+                             const RxSubset * subset)
+    : param(param), res(ibv_res), pkt_size(ibv_res->pkt_size), data_len(0), nsge(0), split(false), drop(NULL),
+      drop_mr(NULL), depth(depth), head(0), nblocks(0), next_gen(0), wr_gen(NULL), free_ids(NULL), nfree(0), blocks(0),
+      errors(0), dropped(0)
+{
+    if (this->depth == 0) this->depth = 1;
+    if (this->depth > DIRECT_MAX_DEPTH) this->depth = DIRECT_MAX_DEPTH;
+    memset(ring, 0, sizeof(ring));
+    // SGE 数不超过 QP 的上限（RoCEv2Dada::Start 已检查）
+    nsge = Layout(param, subset, seg);
+    if (nsge > DIRECT_MAX_SGE || (int)nsge > res->recv_nsge) {
+        printf("[IbvDirectRing] ERROR: %u SGEs per WR exceed the QP limit of %d\n", nsge, res->recv_nsge);
+        return;
+    }
+    uint32_t drop_len = 0;
+    for (unsigned int i = 0; i < nsge; i++) {
+        if (seg[i].kind == SEG_DATA) data_len += seg[i].len;
+        if (seg[i].kind == SEG_HDR) split = true;
+        if (seg[i].kind == SEG_DROP && seg[i].len > drop_len) drop_len = seg[i].len;
+    }
+    if (drop_len > 0) {
+        // 所有 WR 的丢弃段共用一块缓冲，内容无人读取
+        if (posix_memalign((void **)&drop, 4096, drop_len) != 0) drop = NULL;
+        if (drop) drop_mr = ibv_reg_mr(res->pd, drop, drop_len, IBV_ACCESS_LOCAL_WRITE);
+        if (!drop_mr) {
+            printf("[IbvDirectRing] ERROR: failed to register the %u-byte discard buffer\n", drop_len);
+            return;
+        }
+    }
+    wr_gen = (uint64_t *)calloc(res->recv_wr_num, sizeof(uint64_t));
+    free_ids = (uint32_t *)malloc(res->recv_wr_num * sizeof(uint32_t));
+    if (!wr_gen || !free_ids) return;
+    if (res->mem_buf) {
+        // 构造时还不是 DirectToRing：接收队列里挂的是内部缓冲的 WR，它们完成后丢弃并回收到 ring。
+        // SGE 改为每个 WR nsge 个，内部缓冲的 WR 保留帧起始的 SGE，供软件过滤读取帧头
+        for (int i = 0; i < res->recv_wr_num; i++) {
+            res->sge[i * nsge] = res->sge[i * res->recv_nsge];
+            wr_gen[i] = UINT64_MAX;
+        }
+    } else {
+        for (int i = res->recv_wr_num - 1; i >= 0; i--) free_ids[nfree++] = (uint32_t)i;
+    }
+    // 第一个 SGE 总是从帧起始开始（slot、包头数组或丢弃缓冲），软件过滤照样读帧头
+    res->recv_nsge = nsge;
+}
+
+IbvDirectRing::~IbvDirectRing()
+{
+    for (unsigned int i = 0; i < DIRECT_MAX_DEPTH; i++) {
+        if (ring[i].hdr_mr) ibv_dereg_mr(ring[i].hdr_mr);
+        free(ring[i].hdr);
+    }
+    if (drop_mr) ibv_dereg_mr(drop_mr);
+    free(drop);
+    free(wr_gen);
+    free(free_ids);
+}
+
+// 包头数组按 block 的 slot 数分配并注册；ring 项只在 block 提交后复用，重新分配时没有 WR 指向旧数组
+int IbvDirectRing::ReserveHeaders(Block * b)
+{
+    if (b->hdr_cap >= b->slots) return 0;
+    if (b->hdr_mr) ibv_dereg_mr(b->hdr_mr);
+    free(b->hdr);
+    b->hdr_mr = NULL;
+    b->hdr_cap = 0;
+    uint64_t bytes = b->slots * PKT_HEAD_LEN;
+    if (posix_memalign((void **)&b->hdr, 4096, bytes) != 0) {
+        b->hdr = NULL;
+        printf("[IbvDirectRing] ERROR: failed to allocate %lu bytes of packet headers\n", (unsigned long)bytes);
+        return -1;
+    }
+    b->hdr_mr = ibv_reg_mr(res->pd, b->hdr, bytes, IBV_ACCESS_LOCAL_WRITE);
+    if (!b->hdr_mr) {
+        printf("[IbvDirectRing] ERROR: failed to register the packet header array\n");
+        return -1;
+    }
+    b->hdr_cap = b->slots;
+    return 0;
+}
+
+// 把空闲 WR 挂到下一个未挂载的 slot，一次 ibv_post_recv 提交整条链
+int IbvDirectRing::Arm()
+{
+    int k = 0;
+    while (nfree > 0) {
+        Block * t = nblocks ? &ring[(head + nblocks - 1) % depth] : NULL;
+        if (!t || t->posted == t->slots) {
+            if (nblocks == depth) break;
+            long int bufsz = 0;
+            char * p = NULL;
+            if (nblocks == 0) p = param->GetBuffPtr(bufsz);
+            else if (param->PeekBuffPtr) p = param->PeekBuffPtr(nblocks, bufsz);
+            if (!p) {
+                if (nblocks > 0) break;     // 下一个 block 还没被读端清空，稍后再挂
+                printf("[IbvDirectRing] ERROR: failed to get a ring block\n");
+                return -1;
+            }
+            // 分块注册的 ring 按 block 索引直接取该 block 的 MR，否则用 SetDirectMr 的整块 MR
+            struct ibv_mr * mr = param->GetBlockMrPtr ? param->GetBlockMrPtr(nblocks) : NULL;
+            if (!mr) mr = res->mr;
+            uint64_t n = bufsz > 0 ? (uint64_t)bufsz / data_len : 0;
+            char * mr_begin = mr ? (char *)mr->addr : NULL;
+            if (n == 0 || !mr || p < mr_begin || p + n * data_len > mr_begin + mr->length) {
+                printf("[IbvDirectRing] ERROR: block %p (%ld bytes) does not fit %u-byte packets inside its MR\n",
+                       (void *)p, bufsz, data_len);
+                return -1;
+            }
+            t = &ring[(head + nblocks) % depth];
+            t->base = p;
+            t->gen = next_gen++;
+            t->slots = n;
+            t->lkey = mr->lkey;
+            if (split && ReserveHeaders(t) < 0) return -1;
+            t->posted = 0;
+            t->done = 0;
+            nblocks++;
+        }
+        uint32_t id = free_ids[--nfree];
+        struct ibv_sge * sge = &res->sge[id * nsge];
+        char * data = t->base + t->posted * data_len;
+        for (unsigned int i = 0; i < nsge; i++, sge++) {
+            sge->length = seg[i].len;
+            if (seg[i].kind == SEG_DATA) {
+                sge->addr = (uint64_t)(uintptr_t)data;
+                sge->lkey = t->lkey;
+                data += seg[i].len;
+            } else if (seg[i].kind == SEG_HDR) {
+                sge->addr = (uint64_t)(uintptr_t)(t->hdr + t->posted * PKT_HEAD_LEN);
+                sge->lkey = t->hdr_mr->lkey;
+            } else {
+                sge->addr = (uint64_t)(uintptr_t)drop;
+                sge->lkey = drop_mr->lkey;
+            }
+        }
+        wr_gen[id] = t->gen;
+        t->posted++;
+        struct ibv_recv_wr * wr = &res->recv_wr[k];
+        wr->wr_id = id;
+        wr->sg_list = &res->sge[id * nsge];
+        wr->num_sge = nsge;
+        wr->next = NULL;
+        if (k > 0) res->recv_wr[k - 1].next = wr;
+        k++;
+    }
+    if (k > 0 && ibv_post_recv(res->qp, res->recv_wr, &res->bad_recv_wr)) {
+        printf("[IbvDirectRing] ERROR: failed to post %d recv WRs\n", k);
+        return -1;
+    }
+    return 0;
+}
+
+// 提交最老的 block；后面已经挂好的 block 由 GetBuffPtr 正式取得，地址必须一致
+int IbvDirectRing::Commit()
+{
+    if (split && param->HeaderSendBuff && param->HeaderSendBuff(ring[head].hdr, ring[head].slots) < 0) {
+        printf("[IbvDirectRing] ERROR: failed to hand over packet headers\n");
+        return -1;
+    }
+    if (param->DataSendBuff() < 0) {
+        printf("[IbvDirectRing] ERROR: failed to mark block as written\n");
+        return -1;
+    }
+    blocks++;
+    head = (head + 1) % depth;
+    nblocks--;
+    if (nblocks > 0) {
+        long int bufsz = 0;
+        char * p = param->GetBuffPtr(bufsz);
+        if (p != ring[head].base) {
+            printf("[IbvDirectRing] ERROR: ring handed out block %p, but WRs were posted to %p\n",
+                   (void *)p, (void *)ring[head].base);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int IbvDirectRing::Poll()
+{
+    if (!wr_gen || !free_ids) return -1;
+    if (Arm() < 0) return -1;
+    int n = ib_poll_cq(res, res->poll_n, res->wc);
+    if (n <= 0) return n < 0 ? -1 : 0;
+    // 被拒绝的 WR 重新投递到同一个 slot，稍后由本流的包覆盖
+    if (res->sw_filter && (n = ibv_filter_completions(res, n)) < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        uint64_t id = res->wc[i].wr_id;
+        if (wr_gen[id] == UINT64_MAX) {
+            // 启动前挂在内部缓冲上的 WR
+            dropped++;
+            free_ids[nfree++] = (uint32_t)id;
+            continue;
+        }
+        if (res->wc[i].status != IBV_WC_SUCCESS) {
+            errors++;
+            res->recv_wr->wr_id = id;
+            res->recv_wr->sg_list = &res->sge[id * nsge];
+            res->recv_wr->num_sge = nsge;
+            res->recv_wr->next = NULL;
+            if (ibv_post_recv(res->qp, res->recv_wr, &res->bad_recv_wr)) return -1;
+            continue;
+        }
+        uint64_t off = wr_gen[id] - ring[head].gen;
+        if (nblocks == 0 || off >= nblocks) {
+            printf("[IbvDirectRing] ERROR: completion for block %lu outside the armed window\n", (unsigned long)wr_gen[id]);
+            return -1;
+        }
+        ring[(head + off) % depth].done++;
+        free_ids[nfree++] = (uint32_t)id;
+    }
+    while (nblocks > 0 && ring[head].done == ring[head].slots) {
+        if (Commit() < 0) return -1;
+    }
+    return n;
+}
@@ -1,4 +1,10 @@
 // Adapted from libsrc/udp_rdma/src/ibv_utils.cpp
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include "ibv_utils.h"
 
 void ibv_utils_info(const char *msg) { fprintf(stdout, "IBV-UTILS INFO: %s \n", msg); }
@@ -11,7 +17,7 @@ int open_ib_device(uint8_t device_id, struct ibv_utils_res *ib_res)
     int num_ib_devices;
     ib_global_devs = ibv_get_device_list(&num_ib_devices);
     if (!ib_global_devs) { ibv_utils_error("Failed to get IB devices list."); return -1; }
-    if(device_id > num_ib_devices) { ibv_utils_error("Invalid device id."); return -1; }
+    if(device_id >= num_ib_devices) { ibv_utils_error("Invalid device id."); return -1; }
     ib_res->dev = ib_global_devs[device_id];
     ib_res->context = ibv_open_device(ib_res->dev);
     if(!ib_res->context) { ibv_utils_error("Failed to open IB device."); return -1; }
@@ -27,9 +33,25 @@ int create_ib_res(struct ibv_utils_res *ib_res, int send_wr_num, int recv_wr_num
     int wr_num = send_wr_num > recv_wr_num ? send_wr_num : recv_wr_num;
     ib_res->send_wr_num = send_wr_num;
     ib_res->recv_wr_num = recv_wr_num;
-    ib_res->pd = ibv_alloc_pd(ib_res->context);
+    if (!ib_res->pd) ib_res->pd = ibv_alloc_pd(ib_res->context);  // 已设置时共用调用方的 PD
     if (!ib_res->pd) { ibv_utils_error("Failed to allocate PD."); return -1; }
-    ib_res->cq = ibv_create_cq(ib_res->context, wr_num, NULL, NULL, 0);
+    if (ib_res->cq_events) {
+        ib_res->recv_cc = ibv_create_comp_channel(ib_res->context);
+        if (!ib_res->recv_cc) { ibv_utils_error("Couldn't create completion channel."); return -2; }
+    }
+    ib_res->cq_ex = NULL;
+    if (ib_res->recv_cc) {
+        // 带完成时间戳时，睡眠唤醒的延迟可以从完成到达算起；网卡不支持时退回普通 CQ
+        struct ibv_cq_init_attr_ex cq_attr;
+        memset(&cq_attr, 0, sizeof(cq_attr));
+        cq_attr.cqe = (uint32_t)wr_num;
+        cq_attr.channel = ib_res->recv_cc;
+        cq_attr.wc_flags = IBV_WC_STANDARD_FLAGS | IBV_WC_EX_WITH_COMPLETION_TIMESTAMP_WALLCLOCK;
+        ib_res->cq_ex = ibv_create_cq_ex(ib_res->context, &cq_attr);
+        if (ib_res->cq_ex) ib_res->cq = ibv_cq_ex_to_cq(ib_res->cq_ex);
+        else ibv_utils_info("CQ without completion timestamps: wake-up latency is measured from the event.");
+    }
+    if (!ib_res->cq_ex) ib_res->cq = ibv_create_cq(ib_res->context, wr_num, NULL, ib_res->recv_cc, 0);
     if(!ib_res->cq){ ibv_utils_error("Couldn't create CQ."); return -2; }
     struct ibv_qp_init_attr qp_init_attr = { .qp_context = NULL, .send_cq = ib_res->cq, .recv_cq = ib_res->cq, .cap = { .max_send_wr = (uint32_t)send_wr_num, .max_recv_wr = (uint32_t)recv_wr_num, .max_send_sge = (uint32_t)ib_res->send_nsge, .max_recv_sge = (uint32_t)ib_res->recv_nsge, }, .qp_type = IBV_QPT_RAW_PACKET, };
     ib_res->qp = ibv_create_qp(ib_res->pd, &qp_init_attr);
@@ -149,20 +171,23 @@ int create_flow(struct ibv_utils_res *ib_res, struct ibv_pkt_info *pkt_info)
     flow_attr.spec_eth.mask.ether_type = 0xFFFF;        // Must match exactly
     memcpy(flow_attr.spec_eth.val.dst_mac, pkt_info->dst_mac, 6);
     memcpy(flow_attr.spec_eth.val.src_mac, pkt_info->src_mac, 6);
+    // 源 MAC/IP/端口为 0 时不匹配该字段（多块板卡发往同一目的地址时用一条规则接收）
+    static const uint8_t zero_mac[6] = {0};
+    bool any_src_mac = memcmp(pkt_info->src_mac, zero_mac, 6) == 0;
     memset(flow_attr.spec_eth.mask.dst_mac, 0xFF, 6);  // Match all MAC bits
-    memset(flow_attr.spec_eth.mask.src_mac, 0xFF, 6);
+    memset(flow_attr.spec_eth.mask.src_mac, any_src_mac ? 0 : 0xFF, 6);
     
     // Set IPv4 header matching
     flow_attr.spec_ipv4.val.dst_ip = pkt_info->dst_ip;
     flow_attr.spec_ipv4.val.src_ip = pkt_info->src_ip;
     flow_attr.spec_ipv4.mask.dst_ip = 0xFFFFFFFF;       // Match full IP
-    flow_attr.spec_ipv4.mask.src_ip = 0xFFFFFFFF;
+    flow_attr.spec_ipv4.mask.src_ip = pkt_info->src_ip ? 0xFFFFFFFF : 0;
     
     // Set UDP port matching
     flow_attr.spec_udp.val.dst_port = htons(pkt_info->dst_port);
     flow_attr.spec_udp.val.src_port = htons(pkt_info->src_port);
     flow_attr.spec_udp.mask.dst_port = 0xFFFF;          // Match full port
-    flow_attr.spec_udp.mask.src_port = 0xFFFF;
+    flow_attr.spec_udp.mask.src_port = pkt_info->src_port ? 0xFFFF : 0;
     
     // Debug: print flow rule details before creation
     printf("[create_flow] Attempting to create flow steering rule:\n");
@@ -222,11 +247,64 @@ int ib_send(struct ibv_utils_res *ibv_res)
 
 int ib_recv(struct ibv_utils_res *ibv_res)
 {
-    if(ibv_res->recv_completed > 0){ for(int i = 0; i < ibv_res->recv_completed; i++){ ibv_res->recv_wr->wr_id = ibv_res->wc[i].wr_id; ibv_res->recv_wr->sg_list = &ibv_res->sge[ibv_res->wc[i].wr_id*ibv_res->recv_nsge]; ibv_res->recv_wr->num_sge = ibv_res->recv_nsge; ibv_res->recv_wr->next = NULL; ibv_post_recv(ibv_res->qp, ibv_res->recv_wr, &ibv_res->bad_recv_wr); } }
+    // 上一次完成的 WR 串成一条链，一次 ibv_post_recv 重新投递
+    if(ibv_res->recv_completed > 0){ for(int i = 0; i < ibv_res->recv_completed; i++){ ibv_res->recv_wr[i].wr_id = ibv_res->wc[i].wr_id; ibv_res->recv_wr[i].sg_list = &ibv_res->sge[ibv_res->wc[i].wr_id*ibv_res->recv_nsge]; ibv_res->recv_wr[i].num_sge = ibv_res->recv_nsge; ibv_res->recv_wr[i].next = i + 1 < ibv_res->recv_completed ? &ibv_res->recv_wr[i + 1] : NULL; } if(ibv_post_recv(ibv_res->qp, ibv_res->recv_wr, &ibv_res->bad_recv_wr)){ ibv_utils_error("Failed to repost recv WRs."); return -1; } }
     ibv_res->recv_completed = ibv_poll_cq(ibv_res->cq, ibv_res->poll_n, ibv_res->wc);
     return ibv_res->recv_completed;
 }
 
+// 把完成环 wc 中从 first 开始的 n 个 WR 串成一条链，一次 ibv_post_recv 重新投递（一次门铃）；ring 为 0 时 wc 是普通数组
+int ib_repost_chain(struct ibv_utils_res *ibv_res, const struct ibv_wc *wc, unsigned int first, unsigned int n, unsigned int ring)
+{
+    if (n == 0) return 0;
+    for (unsigned int i = 0; i < n; i++) {
+        struct ibv_recv_wr *wr = &ibv_res->recv_wr[i];
+        wr->wr_id = wc[ring ? (first + i) % ring : first + i].wr_id;
+        wr->sg_list = &ibv_res->sge[wr->wr_id * ibv_res->recv_nsge];
+        wr->num_sge = ibv_res->recv_nsge;
+        wr->next = i + 1 < n ? &ibv_res->recv_wr[i + 1] : NULL;
+    }
+    return ibv_post_recv(ibv_res->qp, ibv_res->recv_wr, &ibv_res->bad_recv_wr) ? -1 : 0;
+}
+
+// 扩展 poll 一次，字段填回 ibv_wc，第一个完成的 wallclock 时间存到 stamp_ns；取到完成后清除 stamp_next
+int ib_poll_cq_stamped(struct ibv_utils_res *ib_res, int n, struct ibv_wc *wc)
+{
+    if (!ib_res->cq_ex) {
+        ib_res->stamp_next = false;
+        ib_res->stamp_ns = 0;
+        return ibv_poll_cq(ib_res->cq, n, wc);
+    }
+    if (n <= 0) return 0;
+    struct ibv_poll_cq_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    int ret = ibv_start_poll(ib_res->cq_ex, &attr);
+    if (ret == ENOENT) return 0;
+    if (ret) return -1;
+    ib_res->stamp_ns = ibv_wc_read_completion_wallclock_ns(ib_res->cq_ex);
+    ib_res->stamp_next = false;
+    int got = 0;
+    do {
+        struct ibv_wc *w = &wc[got++];
+        memset(w, 0, sizeof(*w));
+        w->wr_id = ib_res->cq_ex->wr_id;
+        w->status = ib_res->cq_ex->status;
+        // 出错的完成只有 wr_id、status 和 vendor_err 有效
+        if (w->status != IBV_WC_SUCCESS) {
+            w->vendor_err = ibv_wc_read_vendor_err(ib_res->cq_ex);
+            continue;
+        }
+        w->opcode = ibv_wc_read_opcode(ib_res->cq_ex);
+        w->byte_len = ibv_wc_read_byte_len(ib_res->cq_ex);
+        w->qp_num = ibv_wc_read_qp_num(ib_res->cq_ex);
+        w->src_qp = ibv_wc_read_src_qp(ib_res->cq_ex);
+        w->wc_flags = ibv_wc_read_wc_flags(ib_res->cq_ex);
+        if (w->wc_flags & IBV_WC_WITH_IMM) w->imm_data = ibv_wc_read_imm_data(ib_res->cq_ex);
+    } while (got < n && ibv_next_poll(ib_res->cq_ex) == 0);
+    ibv_end_poll(ib_res->cq_ex);
+    return got;
+}
+
 int destroy_ib_res(struct ibv_utils_res *ib_res)
 {
     int ret = 0;
@@ -254,6 +332,11 @@ int destroy_ib_res(struct ibv_utils_res *ib_res)
             ibv_utils_error("Failed to destroy CQ");
             ret = -1;
         }
+        ib_res->cq_ex = NULL;
+    }
+    if (ib_res->recv_cc) {
+        ibv_destroy_comp_channel(ib_res->recv_cc);
+        ib_res->recv_cc = NULL;
     }
     
     // 4. 释放PD（最后释放）
@@ -270,12 +353,161 @@ int destroy_ib_res(struct ibv_utils_res *ib_res)
     if(ib_res->recv_wr_num > 0) free(ib_res->recv_wr);
     free(ib_res->wc);
     free(ib_res->wc_tmp);
+    free(ib_res->sw_filter);
+    ib_res->sw_filter = NULL;
+    if (ib_res->mcast_fd > 0) {
+        close(ib_res->mcast_fd);  // 关闭即退出组播组
+        ib_res->mcast_fd = -1;
+    }
     
     return ret;
 }
 
 int close_ib_device(struct ibv_utils_res *ib_res)
 {
+    if (!ib_res->context) return 0;  // 非 verbs 后端不会打开设备
     ibv_close_device(ib_res->context);
     return 0;
 }
+
+// ip 为网络字节序
+bool ipv4_is_multicast(uint32_t ip) { return (ntohl(ip) & 0xf0000000) == 0xe0000000; }
+
+// RFC 1112：01:00:5e + 组地址低 23 位
+void ipv4_multicast_mac(uint32_t ip, uint8_t *mac)
+{
+    uint32_t h = ntohl(ip);
+    mac[0] = 0x01; mac[1] = 0x00; mac[2] = 0x5e;
+    mac[3] = (h >> 16) & 0x7f;
+    mac[4] = (h >> 8) & 0xff;
+    mac[5] = h & 0xff;
+}
+
+// 在 ifaddr 所在网卡（INADDR_ANY 则按路由）上加入组播组，内核据此发 IGMP 报告并放开网卡的组播 MAC 过滤。
+// fd < 0 时新建一个只用于加入的 UDP socket。返回持有成员关系的 fd，关闭即退出。
+int ipv4_mcast_join(int fd, uint32_t group, uint32_t ifaddr)
+{
+    bool own = fd < 0;
+    if (own) fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) { ibv_utils_error("Failed to create multicast socket."); return -1; }
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = group;
+    mreq.imr_interface.s_addr = ifaddr;
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        fprintf(stderr, "IBV-UTILS ERROR: IP_ADD_MEMBERSHIP failed: %s \n", strerror(errno));
+        if (own) close(fd);
+        return -1;
+    }
+    uint8_t *g = (uint8_t *)&group, *i = (uint8_t *)&ifaddr;
+    printf("[ipv4_mcast_join] Joined %d.%d.%d.%d on interface %d.%d.%d.%d\n", g[0], g[1], g[2], g[3], i[0], i[1], i[2], i[3]);
+    return fd;
+}
+
+// 模板按线上字节序排列：dst_mac(0) src_mac(6) ethertype(12) 协议(23) src_ip(26) dst_ip(30) 端口(34, 36)
+void ibv_pkt_filter_init(struct ibv_pkt_filter *filter, const struct ibv_pkt_info *pkt_info)
+{
+    memset(filter, 0, sizeof(*filter));
+    uint8_t *t = filter->tmpl, *m = filter->mask;
+    memcpy(t, pkt_info->dst_mac, 6);
+    memcpy(t + 6, pkt_info->src_mac, 6);
+    t[12] = 0x08; t[13] = 0x00;
+    t[23] = 17;
+    memcpy(t + 26, &pkt_info->src_ip, 4);
+    memcpy(t + 30, &pkt_info->dst_ip, 4);
+    t[34] = pkt_info->src_port >> 8; t[35] = pkt_info->src_port & 0xff;
+    t[36] = pkt_info->dst_port >> 8; t[37] = pkt_info->dst_port & 0xff;
+    // 与 create_flow 相同：为 0 的源字段不参与比较
+    static const uint8_t zero_mac[6] = {0};
+    memset(m, 0xff, 14);
+    if (memcmp(pkt_info->src_mac, zero_mac, 6) == 0) memset(m + 6, 0, 6);
+    m[23] = 0xff;
+    memset(m + 26, 0xff, 12);
+    if (pkt_info->src_ip == 0) memset(m + 26, 0, 4);
+    if (pkt_info->src_port == 0) memset(m + 34, 0, 2);
+}
+
+// 判断 n（<= 64）个帧是否属于本流，返回接受位图（第 i 位对应 frames[i]）。
+// 每个帧缓冲至少 IBV_FILTER_BYTES 字节；lens 为实际帧长，短于 UDP 头的帧直接拒绝。
+uint64_t ibv_pkt_filter_batch(const struct ibv_pkt_filter *filter, const uint8_t *const *frames, const uint32_t *lens, int n)
+{
+    uint64_t accept = 0;
+#if defined(__AVX2__)
+    const __m256i t0 = _mm256_loadu_si256((const __m256i *)filter->tmpl);
+    const __m256i m0 = _mm256_loadu_si256((const __m256i *)filter->mask);
+    const __m128i t1 = _mm_loadu_si128((const __m128i *)(filter->tmpl + 32));
+    const __m128i m1 = _mm_loadu_si128((const __m128i *)(filter->mask + 32));
+    for (int i = 0; i < n; i++) {
+        __m256i x0 = _mm256_and_si256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i *)frames[i]), t0), m0);
+        __m128i x1 = _mm_and_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)(frames[i] + 32)), t1), m1);
+        bool ok = _mm256_testz_si256(x0, x0) && _mm_testz_si128(x1, x1) && lens[i] >= 42;
+        accept |= (uint64_t)ok << i;
+    }
+#elif defined(__SSE2__)
+    const __m128i t0 = _mm_loadu_si128((const __m128i *)filter->tmpl);
+    const __m128i t1 = _mm_loadu_si128((const __m128i *)(filter->tmpl + 16));
+    const __m128i t2 = _mm_loadu_si128((const __m128i *)(filter->tmpl + 32));
+    const __m128i m0 = _mm_loadu_si128((const __m128i *)filter->mask);
+    const __m128i m1 = _mm_loadu_si128((const __m128i *)(filter->mask + 16));
+    const __m128i m2 = _mm_loadu_si128((const __m128i *)(filter->mask + 32));
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < n; i++) {
+        const uint8_t *p = frames[i];
+        __m128i x = _mm_and_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)p), t0), m0);
+        x = _mm_or_si128(x, _mm_and_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 16)), t1), m1));
+        x = _mm_or_si128(x, _mm_and_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 32)), t2), m2));
+        bool ok = _mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) == 0xffff && lens[i] >= 42;
+        accept |= (uint64_t)ok << i;
+    }
+#else
+    uint64_t t[IBV_FILTER_BYTES / 8], m[IBV_FILTER_BYTES / 8];
+    memcpy(t, filter->tmpl, sizeof(t));
+    memcpy(m, filter->mask, sizeof(m));
+    for (int i = 0; i < n; i++) {
+        uint64_t x = 0, w;
+        for (int k = 0; k < IBV_FILTER_BYTES / 8; k++) {
+            memcpy(&w, frames[i] + k * 8, 8);
+            x |= (w ^ t[k]) & m[k];
+        }
+        accept |= (uint64_t)(x == 0 && lens[i] >= 42) << i;
+    }
+#endif
+    return accept;
+}
+
+// 对 ib_res->wc 中刚 poll 到的 n 个完成做软件过滤：不属于本流的帧和错误完成串成一条链，整批一次重新投递（同 ib_repost_chain），
+// 保留的完成按原顺序压缩到 wc 前部。返回保留的个数，<0 表示重新投递失败。
+int ibv_filter_completions(struct ibv_utils_res *ib_res, int n)
+{
+    const uint8_t *frames[64];
+    uint32_t lens[64];
+    int kept = 0, rejected = 0;
+    for (int base = 0; base < n; base += 64) {
+        int cnt = n - base < 64 ? n - base : 64;
+        for (int i = 0; i < cnt; i++) {
+            struct ibv_wc *wc = &ib_res->wc[base + i];
+            frames[i] = (const uint8_t *)(uintptr_t)ib_res->sge[wc->wr_id * ib_res->recv_nsge].addr;
+            lens[i] = wc->status == IBV_WC_SUCCESS ? wc->byte_len : 0;
+        }
+        uint64_t accept = ibv_pkt_filter_batch(ib_res->sw_filter, frames, lens, cnt);
+        for (int i = 0; i < cnt; i++) {
+            struct ibv_wc *wc = &ib_res->wc[base + i];
+            if (accept >> i & 1) {
+                if (kept != base + i) ib_res->wc[kept] = *wc;
+                kept++;
+                continue;
+            }
+            if (wc->status == IBV_WC_SUCCESS) ib_res->sw_rejected++;
+            struct ibv_recv_wr *wr = &ib_res->recv_wr[rejected];
+            wr->wr_id = wc->wr_id;
+            wr->sg_list = &ib_res->sge[wc->wr_id * ib_res->recv_nsge];
+            wr->num_sge = ib_res->recv_nsge;
+            if (rejected > 0) ib_res->recv_wr[rejected - 1].next = wr;
+            rejected++;
+        }
+    }
+    if (rejected > 0) {
+        ib_res->recv_wr[rejected - 1].next = NULL;
+        if (ibv_post_recv(ib_res->qp, ib_res->recv_wr, &ib_res->bad_recv_wr)) { ibv_utils_error("Failed to repost filtered recv WRs."); return -1; }
+    }
+    return kept;
+}
@@ -0,0 +1,278 @@
+//pcap/pcapng 回放后端：mmap 抓包文件，按原始时间、固定速率或最大速度把帧写入 ring block
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "pcap_transport.h"
+#include "pkt_gen.h"
+
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_BYTE_ORDER 0x1a2b3c4d
+#define PCAPNG_IDB 1
+#define PCAPNG_SPB 3
+#define PCAPNG_EPB 6
+#define PCAPNG_OPT_TSRESOL 9
+#define LINKTYPE_ETHERNET 1
+#define PCAP_SPIN_NS 50000      // 距下一帧不足该时间时忙等，否则睡眠
+#define PCAP_MAX_SLEEP_NS 1000000
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t rd32(const uint8_t *p, bool swap)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+// pcapng 时间戳换算成 ns：if_tsresol 最高位为 0 时单位是 10^-r 秒，为 1 时是 2^-r 秒。
+// 全程整数运算，不经过 double（ns 级的 64 位时间戳在 double 中只剩约 256 ns 的精度）
+static uint64_t pcapng_ts_ns(uint64_t ts, uint8_t resol)
+{
+    unsigned int r = resol & 0x7f;
+    if (resol & 0x80) return (uint64_t)(((unsigned __int128)ts * 1000000000u) >> r);
+    if (r <= 9) {
+        uint64_t mul = 1;
+        for (unsigned int i = r; i < 9; i++) mul *= 10;
+        return ts * mul;
+    }
+    unsigned __int128 div = 1;
+    for (unsigned int i = 9; i < r && i < 48; i++) div *= 10;
+    return (uint64_t)(ts / div);
+}
+
+static uint16_t rd16(const uint8_t *p, bool swap)
+{
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+PcapRxTransport::PcapRxTransport(): fd(-1), map(NULL), map_len(0), pkt_size(0), mode(PCAP_REPLAY_MAX), gbps(0.0),
+    loop(false), filtered(0), snapped(0), cur(0), started(false), finished(false), t0_ns(0), loop_ts_ns(0),
+    bits_sent(0), replayed(0), loops(0), truncated(0)
+{
+    memset(&pkt_info, 0, sizeof(pkt_info));
+}
+
+PcapRxTransport::~PcapRxTransport()
+{
+    if (started) {
+        double secs = (now_ns() - t0_ns) / 1e9;
+        printf("[PcapRxTransport] replayed %lu frames (%lu loops) in %.3f s: %.3f Mpps, %.3f Gbps, truncated %lu\n",
+               (unsigned long)replayed, (unsigned long)loops, secs,
+               secs > 0 ? replayed / secs / 1e6 : 0.0, secs > 0 ? bits_sent / secs / 1e9 : 0.0,
+               (unsigned long)truncated);
+    }
+    if (map) munmap((void *)map, map_len);
+    if (fd >= 0) close(fd);
+}
+
+void PcapRxTransport::AddFrame(uint64_t offset, uint32_t caplen, uint32_t origlen, uint64_t ts_ns)
+{
+    if (!match_udp_flow(map + offset, caplen, pkt_info.src_ip, pkt_info.dst_ip, pkt_info.src_port, pkt_info.dst_port)) {
+        filtered++;
+        return;
+    }
+    if (caplen < origlen) snapped++;
+    Frame f = { offset, caplen, ts_ns };
+    frames.push_back(f);
+}
+
+int PcapRxTransport::IndexPcap()
+{
+    uint32_t magic;
+    memcpy(&magic, map, 4);
+    bool swap = (magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS));
+    if (swap) magic = __builtin_bswap32(magic);
+    uint64_t frac_ns = (magic == PCAP_MAGIC_NS) ? 1 : 1000;
+    uint32_t linktype = rd32(map + 20, swap) & 0xffff;
+    if (linktype != LINKTYPE_ETHERNET) {
+        fprintf(stderr, "[PcapRxTransport] unsupported link type %u (Ethernet only)\n", linktype);
+        return -1;
+    }
+    uint64_t off = 24;
+    while (off + 16 <= map_len) {
+        uint64_t ts = (uint64_t)rd32(map + off, swap) * 1000000000ull + (uint64_t)rd32(map + off + 4, swap) * frac_ns;
+        uint32_t caplen = rd32(map + off + 8, swap);
+        uint32_t origlen = rd32(map + off + 12, swap);
+        off += 16;
+        if (off + caplen > map_len) { ibv_utils_warn("Truncated pcap record at end of file."); break; }
+        AddFrame(off, caplen, origlen, ts);
+        off += caplen;
+    }
+    return 0;
+}
+
+int PcapRxTransport::IndexPcapng()
+{
+    // 每个接口的链路类型和时间戳单位（if_tsresol 原值）
+    std::vector<uint16_t> if_link;
+    std::vector<uint8_t> if_resol;
+    bool swap = false;
+    uint64_t off = 0;
+    while (off + 12 <= map_len) {
+        uint32_t type = rd32(map + off, swap);
+        if (type == PCAPNG_SHB) {
+            uint32_t bom;
+            memcpy(&bom, map + off + 8, 4);
+            swap = (bom == __builtin_bswap32(PCAPNG_BYTE_ORDER));
+            if_link.clear();
+            if_resol.clear();
+        }
+        uint32_t blen = rd32(map + off + 4, swap);
+        if (blen < 12 || off + blen > map_len) { ibv_utils_warn("Truncated pcapng block at end of file."); break; }
+        const uint8_t *body = map + off + 8;
+        uint32_t body_len = blen - 12;
+        if (type == PCAPNG_IDB && body_len >= 8) {
+            if_link.push_back(rd16(body, swap));
+            uint8_t resol = 6;  // 默认微秒
+            for (uint32_t o = 8; o + 4 <= body_len;) {
+                uint16_t code = rd16(body + o, swap), olen = rd16(body + o + 2, swap);
+                if (code == 0) break;
+                if (code == PCAPNG_OPT_TSRESOL && olen >= 1) resol = body[o + 4];
+                o += 4 + ((olen + 3) & ~3u);
+            }
+            if_resol.push_back(resol);
+        } else if (type == PCAPNG_EPB && body_len >= 20) {
+            uint32_t ifid = rd32(body, swap);
+            uint64_t ts = ((uint64_t)rd32(body + 4, swap) << 32) | rd32(body + 8, swap);
+            uint32_t caplen = rd32(body + 12, swap);
+            uint32_t origlen = rd32(body + 16, swap);
+            if (ifid < if_link.size() && caplen <= body_len - 20) {
+                if (if_link[ifid] == LINKTYPE_ETHERNET) AddFrame(off + 28, caplen, origlen, pcapng_ts_ns(ts, if_resol[ifid]));
+                else filtered++;
+            }
+        } else if (type == PCAPNG_SPB && body_len >= 4 && !if_link.empty()) {
+            uint32_t origlen = rd32(body, swap);
+            uint32_t caplen = origlen < body_len - 4 ? origlen : body_len - 4;
+            if (if_link[0] == LINKTYPE_ETHERNET) AddFrame(off + 12, caplen, origlen, 0);
+            else filtered++;
+        }
+        off += blen;
+    }
+    return 0;
+}
+
+int PcapRxTransport::Open(const char * path, const struct ibv_pkt_info * pkt_info, unsigned int pkt_size,
+                          int mode, double gbps, bool loop)
+{
+    if (!path || !pkt_info || pkt_size == 0 || (mode == PCAP_REPLAY_RATE && gbps <= 0.0)) {
+        ibv_utils_error("Invalid pcap transport parameters.");
+        return -1;
+    }
+    this->pkt_size = pkt_size;
+    this->pkt_info = *pkt_info;
+    this->mode = mode;
+    this->gbps = gbps;
+    this->loop = loop;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) { perror("[PcapRxTransport] open"); return -1; }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 24) { fprintf(stderr, "[PcapRxTransport] %s is not a capture file\n", path); return -1; }
+    map_len = (uint64_t)st.st_size;
+    map = (const uint8_t *)mmap(NULL, map_len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED) { map = NULL; perror("[PcapRxTransport] mmap"); return -2; }
+    madvise((void *)map, map_len, MADV_SEQUENTIAL);
+
+    uint32_t magic;
+    memcpy(&magic, map, 4);
+    int ret;
+    if (magic == PCAPNG_SHB) {
+        ret = IndexPcapng();
+    } else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+               magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS)) {
+        ret = IndexPcap();
+    } else {
+        fprintf(stderr, "[PcapRxTransport] %s: unknown capture format (magic 0x%08x)\n", path, magic);
+        return -3;
+    }
+    if (ret < 0) return -3;
+    if (frames.empty()) {
+        fprintf(stderr, "[PcapRxTransport] %s: no frames match the configured flow (%lu filtered)\n", path, (unsigned long)filtered);
+        return -4;
+    }
+
+    double span = (frames.back().ts_ns - frames.front().ts_ns) / 1e9;
+    printf("[PcapRxTransport] %s: %lu frames indexed (%lu filtered, %lu snapped), capture span %.3f s\n",
+           path, (unsigned long)frames.size(), (unsigned long)filtered, (unsigned long)snapped, span);
+    printf("[PcapRxTransport] replay: %s%s\n",
+           mode == PCAP_REPLAY_ORIGINAL ? "original timing" : (mode == PCAP_REPLAY_RATE ? "fixed rate" : "max speed"),
+           loop ? ", looping" : "");
+    if (mode == PCAP_REPLAY_RATE) printf("[PcapRxTransport] target rate: %.3f Gbps\n", gbps);
+    return 0;
+}
+
+// 帧 idx 的计划发出时刻（单调时钟 ns）
+uint64_t PcapRxTransport::DueTime(size_t idx) const
+{
+    if (mode == PCAP_REPLAY_ORIGINAL) {
+        uint64_t ts = frames[idx].ts_ns, first = frames.front().ts_ns;
+        return t0_ns + loop_ts_ns + (ts > first ? ts - first : 0);
+    } else if (mode == PCAP_REPLAY_RATE) {
+        return t0_ns + (uint64_t)(bits_sent / gbps);  // bit / Gbps = ns
+    }
+    return 0;
+}
+
+int PcapRxTransport::Recv(char * dst, unsigned int pkt_num)
+{
+    if (finished) return 0;  // 接收循环看到 Finished() 后提交最后一个 block 并退出
+    uint64_t now = now_ns();
+    if (!started) {
+        t0_ns = now;
+        started = true;
+    }
+
+    unsigned int got = 0;
+    while (got < pkt_num) {
+        if (cur == frames.size()) {
+            if (!loop) {
+                finished = true;
+                printf("[PcapRxTransport] end of capture after %lu frames\n", (unsigned long)replayed);
+                break;
+            }
+            // 下一轮接在本轮之后，间隔取平均帧间隔
+            uint64_t span = frames.back().ts_ns - frames.front().ts_ns;
+            loop_ts_ns += span + (frames.size() > 1 ? span / (frames.size() - 1) : 0);
+            cur = 0;
+            loops++;
+        }
+        uint64_t due = DueTime(cur);
+        if (due > now) {
+            if (got) break;
+            uint64_t wait = due - now;
+            if (wait > PCAP_SPIN_NS) {
+                struct timespec ts = { 0, (long)(wait < PCAP_MAX_SLEEP_NS ? wait - PCAP_SPIN_NS : PCAP_MAX_SLEEP_NS) };
+                nanosleep(&ts, NULL);
+                return 0;
+            }
+            now = now_ns();
+            continue;
+        }
+        const Frame &f = frames[cur];
+        char *slot = dst + (size_t)got * pkt_size;
+        uint32_t len = f.len;
+        if (len > pkt_size) { len = pkt_size; truncated++; }
+        memcpy(slot, map + f.offset, len);
+        if (len < pkt_size) memset(slot + len, 0, pkt_size - len);
+        bits_sent += (uint64_t)f.len * 8;
+        cur++;
+        got++;
+    }
+    replayed += got;
+    return (int)got;
+}
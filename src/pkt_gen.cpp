@@ -1,4 +1,5 @@
 #include "pkt_gen.h"
+#include <string.h>
 
 void set_dest_mac(struct udp_pkt *pkt, uint8_t *mac) { for (int i = 0; i < 6; i++) pkt->dst_mac[i] = mac[i]; }
 void set_src_mac(struct udp_pkt *pkt, uint8_t *mac) { for (int i = 0; i < 6; i++) pkt->src_mac[i] = mac[i]; }
@@ -10,3 +11,10 @@ void set_udp_src_port(struct udp_pkt *pkt, uint16_t port) { pkt->udp_hdr[0] = (p
 void set_udp_dst_port(struct udp_pkt *pkt, uint16_t port) { pkt->udp_hdr[2] = (port >> 8) & 0xFF; pkt->udp_hdr[3] = port & 0xFF; }
 void set_pkt_len(struct udp_pkt *pkt, uint16_t len) { set_ip_hdrs(pkt, (uint8_t *)"\x45\x00\x00\x1f\x54\x00\x00\x00\x40\x11\xaf\xb6"); pkt->udp_hdr[4] = (len >> 8) & 0xFF; pkt->udp_hdr[5] = len & 0xFF; pkt->ip_hdrs[2] = (len + 20) >> 8; pkt->ip_hdrs[3] = (len + 20) & 0xFF; }
 void set_payload(struct udp_pkt *pkt, uint8_t *payload, int len) { for (int i = 0; i < len; i++) pkt->payload[i] = payload[i]; }
+bool match_udp_flow(const uint8_t *frame, uint32_t len, uint32_t src_ip, uint32_t dst_ip, uint16_t src_port, uint16_t dst_port) {
+    const struct udp_pkt *pkt = (const struct udp_pkt *)frame;
+    if (len < 42 || pkt->eth_type[0] != 0x08 || pkt->eth_type[1] != 0x00 || pkt->ip_hdrs[9] != 17) return false;
+    if (memcmp(pkt->src_ip, &src_ip, 4) != 0 || memcmp(pkt->dst_ip, &dst_ip, 4) != 0) return false;
+    return (((uint16_t)pkt->udp_hdr[0] << 8) | pkt->udp_hdr[1]) == src_port &&
+           (((uint16_t)pkt->udp_hdr[2] << 8) | pkt->udp_hdr[3]) == dst_port;
+}
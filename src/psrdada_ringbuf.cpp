@@ -18,6 +18,7 @@ extern "C" {
 #include <infiniband/verbs.h>
 #include "dada_header.h"
 #include "dada_def.h"
+#include "rx_numa.h"
 
 // 注意：data_block和hdu改为成员变量，不再使用全局变量
 
@@ -135,6 +136,17 @@ int PsrdadaRingBuf::MarkWritten(uint64_t bytes)
     return 0;
 }
 
+char* PsrdadaRingBuf::PeekWriteBuffer(uint64_t ahead)
+{
+    if (!is_initialized || (!current_ptr && ahead > 0)) return NULL;
+    // 当前（或下一个要取的）block 的序号是 write_count；序号为 k 的 block 在 k < read_count + nbufs 时已被读端清空
+    ipcbuf_t *buf = (ipcbuf_t*)data_block;
+    uint64_t nbufs = ipcbuf_get_nbufs(buf);
+    uint64_t next = ipcbuf_get_write_count(buf) + ahead;
+    if (next >= ipcbuf_get_read_count(buf) + nbufs) return NULL;
+    return buf->shm_addr[next % nbufs];
+}
+
 int PsrdadaRingBuf::StartBlock()
 {
     if (!is_initialized) return -1;
@@ -340,6 +352,48 @@ struct ibv_mr* PsrdadaRingBuf::RegisterWholeRing(struct ibv_pd *pd, int access)
     return mr;
 }
 
+char* PsrdadaRingBuf::GetContiguousRing(uint64_t *total_bytes)
+{
+    if (!is_initialized) return NULL;
+    dada_hdu_t *hdu_ptr = (dada_hdu_t *)hdu;
+    ipcio_t *ipc = (ipcio_t *)hdu_ptr->data_block;
+    if (!ipc) return NULL;
+    ipcbuf_t *buf = &ipc->buf;
+    if (!buf->shm_addr || !buf->sync) return NULL;
+    uint64_t nbufs = buf->sync->nbufs;
+    uint64_t bufsz = buf->sync->bufsz;
+    if (nbufs == 0 || bufsz == 0) return NULL;
+    char *base = buf->shm_addr[0];
+    if (!base) return NULL;
+    for (uint64_t i = 1; i < nbufs; i++) {
+        if (buf->shm_addr[i] != base + i * bufsz) return NULL;
+    }
+    if (total_bytes) *total_bytes = nbufs * bufsz;
+    return base;
+}
+
+int PsrdadaRingBuf::BindNode(int node)
+{
+    if (!is_initialized || node < 0) return -1;
+    dada_hdu_t *hdu_ptr = (dada_hdu_t *)hdu;
+    ipcio_t *ipc = (ipcio_t *)hdu_ptr->data_block;
+    if (!ipc) return -1;
+    ipcbuf_t *buf = &ipc->buf;
+    if (!buf->shm_addr || !buf->sync) return -1;
+    uint64_t nbufs = buf->sync->nbufs;
+    uint64_t bufsz = buf->sync->bufsz;
+    int bound = 0;
+    // 共享段的策略属于段本身，之后 dbdisk 等读端看到的也是同一份放置；
+    // 只被本进程映射的页才能迁移，被其他进程映射的页留在原节点
+    for (uint64_t i = 0; i < nbufs; i++) {
+        if (buf->shm_addr[i] && rx_numa_bind(buf->shm_addr[i], bufsz, node, true) == 0) bound++;
+    }
+    if ((uint64_t)bound < nbufs) {
+        printf("[PsrdadaRingBuf] WARNING: only %d of %lu blocks bound to NUMA node %d\n", bound, (unsigned long)nbufs, node);
+    }
+    return bound;
+}
+
 int PsrdadaRingBuf::DumpToDada(const char *out_path, const char *header_template_path)
 {
     if (!is_initialized || !out_path) return -1;
@@ -550,15 +604,8 @@ struct ibv_mr* PsrdadaRingBuf::GetCurrentBlockMr()
         return NULL;
     }
     
-    // 通过地址查找对应的MR
-    for (size_t i = 0; i < block_mrs.size(); i++) {
-        if (block_mrs[i].addr == current_ptr) {
-            return block_mrs[i].mr;
-        }
-    }
-    
-    // 如果通过地址找不到，使用block_idx
-    if (current_block < block_mrs.size()) {
+    // block_mrs按shm_addr顺序注册，直接用block索引取MR
+    if (current_block < block_mrs.size() && block_mrs[current_block].addr == current_ptr) {
         return block_mrs[current_block].mr;
     }
     
@@ -567,6 +614,19 @@ struct ibv_mr* PsrdadaRingBuf::GetCurrentBlockMr()
     return NULL;
 }
 
+struct ibv_mr* PsrdadaRingBuf::GetBlockMr(uint64_t ahead)
+{
+    if (ahead == 0) return GetCurrentBlockMr();
+    if (!use_block_registration || block_mrs.empty() || !current_ptr) return NULL;
+    ipcbuf_t *buf = (ipcbuf_t*)data_block;
+    uint64_t idx = (ipcbuf_get_write_count(buf) + ahead) % ipcbuf_get_nbufs(buf);
+    if (idx >= block_mrs.size() || block_mrs[idx].addr != buf->shm_addr[idx]) {
+        fprintf(stderr, "[GetBlockMr] Block MR not found for idx=%lu\n", (unsigned long)idx);
+        return NULL;
+    }
+    return block_mrs[idx].mr;
+}
+
 // 清理所有已注册的block MRs
 void PsrdadaRingBuf::UnregisterAllBlocks()
 {
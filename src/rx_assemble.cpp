@@ -0,0 +1,269 @@
+//多源拼帧：一个绑核线程 poll 同一个 QP 上各源的包，按 (源, 包序号) 放到 block 中固定的位置
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rx_assemble.h"
+#include "rx_thread.h"
+
+RxAssembler::RxAssembler(const RoCEv2Dada::RdmaParam * param, struct ibv_utils_res * res, unsigned int nsources)
+    : param(param), res(res), nsources(nsources), blk(param, nsources, "RxAssembler"), base(UINT64_MAX), deferred(NULL),
+      ndeferred(0), max_deferred(0), t_hold(0), committed(false), stale_run(0), t_stale(0), started(false), stop(false),
+      packets(0), unknown(0), stale(0), outliers(0), resyncs(0), dups(0), errors(0)
+{
+    memset(src_ip, 0, sizeof(src_ip));
+    memset(src_port, 0, sizeof(src_port));
+}
+
+RxAssembler::~RxAssembler()
+{
+    Stop();
+    free(deferred);
+}
+
+void RxAssembler::SetSource(unsigned int idx, uint32_t ip, uint16_t port)
+{
+    if (idx >= nsources) return;
+    src_ip[idx] = ip;
+    src_port[idx] = port;
+}
+
+const uint8_t * RxAssembler::Frame(uint64_t wr_id) const
+{
+    return (const uint8_t *)(uintptr_t)res->sge[wr_id * res->recv_nsge].addr;
+}
+
+int RxAssembler::Repost(uint64_t wr_id)
+{
+    res->recv_wr->wr_id = wr_id;
+    res->recv_wr->sg_list = &res->sge[wr_id * res->recv_nsge];
+    res->recv_wr->num_sge = res->recv_nsge;
+    res->recv_wr->next = NULL;
+    if (ibv_post_recv(res->qp, res->recv_wr, &res->bad_recv_wr)) {
+        printf("[RxAssembler] ERROR: failed to repost recv WR %lu\n", (unsigned long)wr_id);
+        return -1;
+    }
+    return 0;
+}
+
+// 返回帧所属的段号，-1 表示不属于任何源
+int RxAssembler::Locate(const uint8_t * frame) const
+{
+    if (param->seq_place) return 0;
+    if (param->source_id_offset > 0) {
+        unsigned int id = ((unsigned int)frame[param->source_id_offset] << 8) | frame[param->source_id_offset + 1];
+        return id < nsources ? (int)id : -1;
+    }
+    uint32_t ip;
+    memcpy(&ip, frame + 26, sizeof(ip));
+    uint16_t port = (uint16_t)((frame[34] << 8) | frame[35]);
+    for (unsigned int i = 0; i < nsources; i++) {
+        if (src_ip[i] == ip && (src_port[i] == 0 || src_port[i] == port)) return (int)i;
+    }
+    return -1;
+}
+
+// 提交当前 block（空槽位清零、交出丢失位图）并打开下一个，base 前进一个 block
+int RxAssembler::Commit()
+{
+    uint64_t prev_slots = blk.slots;
+    if (blk.Commit() < 0) return -1;
+    base += prev_slots;
+    committed = true;
+    return 0;
+}
+
+// 0：已处理（放入或丢弃），可以重新投递；1：属于后面的 block，暂留；2：旧包已连续到达太多，需要 Resync；<0：出错
+int RxAssembler::Place(uint64_t wr_id)
+{
+    const uint8_t * frame = Frame(wr_id);
+    int src = Locate(frame);
+    if (src < 0) {
+        unknown++;
+        return 0;
+    }
+    uint64_t seq = pkt_seq_get(frame);
+    // 起点按 slots 对齐，同一序号总是落在相同的 block 位置
+    if (base == UINT64_MAX) base = seq - seq % blk.slots;
+    if (seq < base) {
+        stale++;
+        // 零星迟到的包照常丢弃；只剩旧序号的包时说明计数器回退了
+        uint64_t now = rx_now_ns();
+        if (stale_run++ == 0) t_stale = now;
+        return stale_run >= RX_ASSEMBLE_STALE_RUN || now - t_stale >= RX_ASSEMBLE_HOLD_NS ? 2 : 0;
+    }
+    stale_run = 0;
+    uint64_t off = seq - base;
+    if (off >= blk.slots) return 1;
+    uint64_t idx = (uint64_t)src * blk.slots + off;
+    uint64_t bit = 1ull << (idx & 63);
+    if (blk.bitmap[idx >> 6] & bit) {
+        dups++;
+        return 0;
+    }
+    blk.bitmap[idx >> 6] |= bit;
+    memcpy(blk.block + idx * param->pkt_size, frame, param->pkt_size);
+    packets++;
+    if (++blk.filled == blk.slots * nsources && Commit() < 0) return -1;
+    return 0;
+}
+
+// 计数器回退：已收到的部分照常提交，丢掉暂留的旧流包，base 对齐到触发回退的包的序号
+int RxAssembler::Resync(uint64_t wr_id)
+{
+    uint64_t seq = pkt_seq_get(Frame(wr_id));
+    printf("[RxAssembler] sequence counter went back to %lu (block base %lu) after %lu stale packets, resynchronising\n",
+           (unsigned long)seq, (unsigned long)base, (unsigned long)stale_run);
+    if (blk.filled > 0 && Commit() < 0) return -1;
+    committed = false;
+    for (unsigned int i = 0; i < ndeferred; i++) {
+        if (Repost(deferred[i]) < 0) return -1;
+    }
+    ndeferred = 0;
+    t_hold = 0;
+    base = seq - seq % blk.slots;
+    stale_run = 0;
+    resyncs++;
+    return 0;
+}
+
+// block 提交后把暂留的 WR 重新放一遍；暂留的包都超出下一个 block 时整块跳过
+int RxAssembler::Replay()
+{
+    while (committed) {
+        committed = false;
+        uint64_t min_seq = UINT64_MAX;
+        for (unsigned int i = 0; i < ndeferred; i++) {
+            uint64_t seq = pkt_seq_get(Frame(deferred[i]));
+            if (seq < min_seq) min_seq = seq;
+        }
+        if (ndeferred > 0 && min_seq >= base + blk.slots) {
+            uint64_t skip = (min_seq - base) / blk.slots;
+            if (skip <= RX_FILL_BLOCKS) {
+                // 整块丢失：补交全零 block，保持时间对齐
+                for (uint64_t k = 0; k < skip; k++) {
+                    if (Commit() < 0) return -1;
+                }
+            } else {
+                // 跳得太远时要有多个包落在同一目标 block，单个坏序号不能把 base 带走
+                uint64_t target = base + skip * blk.slots;
+                unsigned int agree = 0;
+                for (unsigned int i = 0; i < ndeferred; i++) {
+                    uint64_t seq = pkt_seq_get(Frame(deferred[i]));
+                    if (seq - target < blk.slots) agree++;
+                }
+                if (agree < RX_ASSEMBLE_JUMP_AGREE) {
+                    unsigned int kept = 0;
+                    for (unsigned int i = 0; i < ndeferred; i++) {
+                        uint64_t seq = pkt_seq_get(Frame(deferred[i]));
+                        if (seq - target >= blk.slots) deferred[kept++] = deferred[i];
+                        else if (Repost(deferred[i]) < 0) return -1;
+                    }
+                    outliers += ndeferred - kept;
+                    ndeferred = kept;
+                    committed = true;
+                    continue;
+                }
+                printf("[RxAssembler] sequence counter jumped %lu blocks ahead to %lu, resynchronising\n",
+                       (unsigned long)skip, (unsigned long)min_seq);
+                blk.missing += skip * blk.slots * nsources;
+                base = target;
+                resyncs++;
+            }
+        }
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < ndeferred; i++) {
+            int ret = Place(deferred[i]);
+            if (ret < 0) return -1;
+            if (ret == 1) deferred[kept++] = deferred[i];
+            else if (Repost(deferred[i]) < 0) return -1;
+        }
+        ndeferred = kept;
+        t_hold = ndeferred ? rx_now_ns() : 0;
+    }
+    return 0;
+}
+
+int RxAssembler::Run()
+{
+    RxRate rate;
+    uint64_t packets_pre = 0;
+    while (!stop) {
+        int n = ibv_poll_cq(res->cq, res->poll_n, res->wc);
+        if (n < 0) {
+            printf("[RxAssembler] ERROR: failed to poll CQ\n");
+            return -1;
+        }
+        // 单流时网卡不支持 steering 也可用：软件过滤掉其它流的帧
+        if (res->sw_filter && n > 0 && (n = ibv_filter_completions(res, n)) < 0) return -1;
+        for (int i = 0; i < n; i++) {
+            int ret = 0;
+            if (res->wc[i].status == IBV_WC_SUCCESS) ret = Place(res->wc[i].wr_id);
+            else errors++;
+            if (ret == 2) ret = Resync(res->wc[i].wr_id) < 0 ? -1 : Place(res->wc[i].wr_id);
+            if (ret < 0) return -1;
+            if (ret == 1) {
+                if (ndeferred == 0) t_hold = rx_now_ns();
+                deferred[ndeferred++] = res->wc[i].wr_id;
+            } else if (Repost(res->wc[i].wr_id) < 0) {
+                return -1;
+            }
+        }
+        // 其它源迟迟补不齐当前 block，或暂留的 WR 太多会让接收队列见底：带着空洞提交
+        if (!committed && ndeferred > 0 &&
+            (ndeferred >= max_deferred || rx_now_ns() - t_hold >= RX_ASSEMBLE_HOLD_NS)) {
+            if (Commit() < 0) return -1;
+        }
+        if (committed && Replay() < 0) return -1;
+
+        if (rate.Due()) {
+            printf("[RxAssembler] %.3f Gbps, %lu blocks, %lu missing slots, unknown %lu, stale %lu, resync %lu, outlier %lu, "
+                   "dup %lu, err %lu\n", rate.Gbps(RxRate::Delta(packets, &packets_pre) * param->pkt_size),
+                   (unsigned long)blk.blocks, (unsigned long)blk.missing, (unsigned long)unknown, (unsigned long)stale,
+                   (unsigned long)resyncs, (unsigned long)outliers, (unsigned long)dups, (unsigned long)errors);
+        }
+    }
+    return 0;
+}
+
+void * RxAssembler::Thread(void * arg)
+{
+    RxAssembler * a = (RxAssembler *)arg;
+    if (a->Run() < 0) a->stop = true;
+    return NULL;
+}
+
+int RxAssembler::Start(const RxThreadPlace & place)
+{
+    if (nsources == 0 || nsources > RX_MAX_SOURCES) return -1;
+    max_deferred = res->recv_wr_num / 2;
+    if (max_deferred == 0) max_deferred = 1;
+    deferred = (uint64_t *)malloc(res->recv_wr_num * sizeof(uint64_t));
+    if (!deferred) { printf("[RxAssembler] ERROR: failed to allocate deferred WR list\n"); return -1; }
+    if (blk.Open() < 0) return -1;
+    for (unsigned int i = 0; i < nsources && param->source_id_offset == 0 && !param->seq_place; i++) {
+        uint8_t * ip = (uint8_t *)&src_ip[i];
+        printf("[RxAssembler] source %u: %d.%d.%d.%d:%u -> block offset %lu\n", i, ip[0], ip[1], ip[2], ip[3],
+               src_port[i], (unsigned long)(i * blk.slots * param->pkt_size));
+    }
+    if (param->seq_place) {
+        printf("[RxAssembler] single flow placed by sequence number, lost slots zero-filled\n");
+    } else if (param->source_id_offset > 0) {
+        printf("[RxAssembler] %u sources selected by the 16-bit id at header offset %u\n", nsources,
+               param->source_id_offset);
+    }
+    printf("[RxAssembler] %lu slots per source per block, ordered by the sequence counter at offset %d\n",
+           (unsigned long)blk.slots, PKT_SEQ_OFFSET);
+    if (rx_thread_start(&tid, Thread, this, place, "RxAssembler") < 0) {
+        printf("[RxAssembler] ERROR: failed to create receive thread\n");
+        return -1;
+    }
+    started = true;
+    return 0;
+}
+
+void RxAssembler::Stop()
+{
+    stop = true;
+    rx_thread_join(tid, &started);
+}
@@ -0,0 +1,145 @@
+//变长包压缩放置：一个绑核线程 poll QP，按 byte_len 把帧首尾相接地拷贝进 block，并记录每帧的偏移和长度
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rx_compact.h"
+#include "rx_thread.h"
+
+RxCompactor::RxCompactor(const RoCEv2Dada::RdmaParam * param, struct ibv_utils_res * res)
+    : param(param), res(res), block(NULL), block_bytes(0), used(0), index(NULL), nindex(0), index_cap(0),
+      started(false), stop(false), frames(0), bytes(0), blocks(0), truncated(0), errors(0) {}
+
+RxCompactor::~RxCompactor()
+{
+    Stop();
+    free(index);
+}
+
+int RxCompactor::OpenBlock()
+{
+    long int bufsz = 0;
+    char * p = param->GetBuffPtr(bufsz);
+    if (!p || bufsz < (long int)param->pkt_size) {
+        printf("[RxCompactor] ERROR: block %p of %ld bytes cannot hold a %u-byte frame\n", (void *)p, bufsz, param->pkt_size);
+        return -1;
+    }
+    // 每帧至少 PKT_HEAD_LEN 字节，索引按最坏情况分配
+    uint64_t cap = (uint64_t)bufsz / PKT_HEAD_LEN;
+    if (cap > index_cap) {
+        free(index);
+        index = (RoCEv2Dada::FrameIndex *)malloc(cap * sizeof(RoCEv2Dada::FrameIndex));
+        index_cap = index ? cap : 0;
+        if (!index) { printf("[RxCompactor] ERROR: failed to allocate frame index\n"); return -1; }
+    }
+    block = p;
+    block_bytes = (uint64_t)bufsz;
+    used = 0;
+    nindex = 0;
+    return 0;
+}
+
+// 尾部不足一帧的空间清零，交出索引后提交并打开下一个 block
+int RxCompactor::Commit()
+{
+    memset(block + used, 0, block_bytes - used);
+    if (param->FrameIndexSend && param->FrameIndexSend(index, nindex) < 0) {
+        printf("[RxCompactor] ERROR: failed to hand over the frame index\n");
+        return -1;
+    }
+    if (param->DataSendBuff() < 0) {
+        printf("[RxCompactor] ERROR: failed to mark block as written\n");
+        return -1;
+    }
+    blocks++;
+    return OpenBlock();
+}
+
+int RxCompactor::Place(const struct ibv_wc * wc)
+{
+    if (wc->status != IBV_WC_SUCCESS) {
+        if (wc->status == IBV_WC_LOC_LEN_ERR) truncated++;
+        else errors++;
+        return 0;
+    }
+    uint32_t len = wc->byte_len;
+    if (len < PKT_HEAD_LEN || len > param->pkt_size) {
+        truncated++;
+        return 0;
+    }
+    if (used + len > block_bytes && Commit() < 0) return -1;
+    memcpy(block + used, (const void *)(uintptr_t)res->sge[wc->wr_id * res->recv_nsge].addr, len);
+    index[nindex].offset = (uint32_t)used;
+    index[nindex].len = len;
+    nindex++;
+    used += len;
+    frames++;
+    bytes += len;
+    return 0;
+}
+
+int RxCompactor::Run()
+{
+    RxRate rate;
+    uint64_t bytes_pre = 0;
+    while (!stop) {
+        int n = ibv_poll_cq(res->cq, res->poll_n, res->wc);
+        if (n < 0) {
+            printf("[RxCompactor] ERROR: failed to poll CQ\n");
+            return -1;
+        }
+        // 软件过滤会把错误完成直接重新投递，超长帧要在此之前计数
+        if (res->sw_filter && n > 0) {
+            for (int i = 0; i < n; i++) truncated += res->wc[i].status == IBV_WC_LOC_LEN_ERR;
+            if ((n = ibv_filter_completions(res, n)) < 0) return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (Place(&res->wc[i]) < 0) return -1;
+            struct ibv_recv_wr * wr = &res->recv_wr[i];
+            wr->wr_id = res->wc[i].wr_id;
+            wr->sg_list = &res->sge[wr->wr_id * res->recv_nsge];
+            wr->num_sge = res->recv_nsge;
+            wr->next = NULL;
+            if (i > 0) res->recv_wr[i - 1].next = wr;
+        }
+        // 一批帧拷贝完后整条链一次重新投递
+        if (n > 0 && ibv_post_recv(res->qp, res->recv_wr, &res->bad_recv_wr)) {
+            printf("[RxCompactor] ERROR: failed to repost recv WRs\n");
+            return -1;
+        }
+
+        if (rate.Due()) {
+            printf("[RxCompactor] %.3f Gbps, %lu blocks, %lu frames, truncated %lu, err %lu\n",
+                   rate.Gbps(RxRate::Delta(bytes, &bytes_pre)), (unsigned long)blocks, (unsigned long)frames,
+                   (unsigned long)truncated, (unsigned long)errors);
+            if (res->sw_filter) printf("[RxCompactor] software filter: %lu frames rejected\n", (unsigned long)res->sw_rejected);
+        }
+    }
+    return 0;
+}
+
+void * RxCompactor::Thread(void * arg)
+{
+    RxCompactor * c = (RxCompactor *)arg;
+    if (c->Run() < 0) c->stop = true;
+    return NULL;
+}
+
+int RxCompactor::Start(const RxThreadPlace & place)
+{
+    if (OpenBlock() < 0) return -1;
+    printf("[RxCompactor] frames of %d..%u bytes packed back-to-back, up to %lu per block\n",
+           PKT_HEAD_LEN, param->pkt_size, (unsigned long)(block_bytes / PKT_HEAD_LEN));
+    if (rx_thread_start(&tid, Thread, this, place, "RxCompactor") < 0) {
+        printf("[RxCompactor] ERROR: failed to create receive thread\n");
+        return -1;
+    }
+    started = true;
+    return 0;
+}
+
+void RxCompactor::Stop()
+{
+    stop = true;
+    rx_thread_join(tid, &started);
+}
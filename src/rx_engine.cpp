@@ -0,0 +1,86 @@
+//编译期特化的接收循环：PSRDADA sink 的 block 记账，以及按 pkt_size/send_n 选择预先实例化版本的分派
+#include <infiniband/verbs.h>
+#include <stdio.h>
+
+#include "rx_engine.h"
+
+PsrdadaSink::PsrdadaSink(PsrdadaRingBuf * ring, uint64_t batch_bytes)
+    : ring(ring), block_bytes(ring->GetBlockSize()), batch_bytes(batch_bytes), left(0), blocks(0), last_print(0) {}
+
+char * PsrdadaSink::Acquire()
+{
+    if (batch_bytes == 0 || block_bytes < batch_bytes) {
+        printf("[PsrdadaSink] ERROR: %lu-byte blocks cannot hold a %lu-byte batch\n",
+               (unsigned long)block_bytes, (unsigned long)batch_bytes);
+        return NULL;
+    }
+    char * ptr = ring->GetWriteBuffer(block_bytes);
+    if (!ptr) {
+        printf("[PsrdadaSink] ERROR: failed to get the next block\n");
+        return NULL;
+    }
+    left = block_bytes / batch_bytes;
+    return ptr;
+}
+
+int PsrdadaSink::Submit()
+{
+    if (ring->MarkWritten(block_bytes) < 0) {
+        printf("[PsrdadaSink] ERROR: failed to mark block as written\n");
+        return -1;
+    }
+    blocks++;
+    time_t now = time(NULL);
+    if (now - last_print >= 2) {
+        last_print = now;
+        uint64_t used = ring->GetUsedSpace();
+        uint64_t total = used + ring->GetFreeSpace();
+        printf("[PsrdadaSink] Blocks written: %lu | Ring buffer: %.1f%% full (%lu/%lu MB)\n", (unsigned long)blocks,
+               total > 0 ? used * 100.0 / total : 0.0, (unsigned long)(used >> 20), (unsigned long)(total >> 20));
+    }
+    return 0;
+}
+
+template <unsigned int PKT, unsigned int NPKT>
+static int run_variant(struct ibv_utils_res * res, PsrdadaSink * sink, unsigned int pkt_size, unsigned int send_n, unsigned int idle_us,
+                       const volatile bool * stop)
+{
+    RxEngine<PsrdadaSink, RxGeometry<PKT, NPKT> > engine(res, sink, RxGeometry<PKT, NPKT>(pkt_size, send_n), idle_us, stop);
+    return engine.Run();
+}
+
+typedef int (*RxEngineFn)(struct ibv_utils_res *, PsrdadaSink *, unsigned int, unsigned int, unsigned int, const volatile bool *);
+struct RxEngineVariant { unsigned int pkt_size; unsigned int send_n; RxEngineFn run; };
+
+// 预先实例化的组合：run_demo.sh 的 8192 字节载荷（带/不带 64 字节包头）和半长包，常用的批次大小
+#define RX_ENGINE_VARIANT(P, N) { P, N, &run_variant<P, N> }
+static const RxEngineVariant variants[] = {
+    RX_ENGINE_VARIANT(8256, 32), RX_ENGINE_VARIANT(8256, 64), RX_ENGINE_VARIANT(8256, 128),
+    RX_ENGINE_VARIANT(8192, 32), RX_ENGINE_VARIANT(8192, 64), RX_ENGINE_VARIANT(8192, 128),
+    RX_ENGINE_VARIANT(4160, 32), RX_ENGINE_VARIANT(4160, 64), RX_ENGINE_VARIANT(4160, 128),
+};
+
+static const RxEngineVariant * find_variant(unsigned int pkt_size, unsigned int send_n)
+{
+    for (unsigned int i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        if (variants[i].pkt_size == pkt_size && variants[i].send_n == send_n) return &variants[i];
+    }
+    return NULL;
+}
+
+bool rx_engine_specialised(unsigned int pkt_size, unsigned int send_n)
+{
+    return find_variant(pkt_size, send_n) != NULL;
+}
+
+int rx_engine_run(struct ibv_utils_res * res, PsrdadaSink * sink, unsigned int pkt_size, unsigned int send_n, unsigned int idle_us,
+                  const volatile bool * stop)
+{
+    const RxEngineVariant * v = find_variant(pkt_size, send_n);
+    if (v) {
+        printf("[RxEngine] Running the loop specialised for %u x %u-byte packets\n", send_n, pkt_size);
+        return v->run(res, sink, pkt_size, send_n, idle_us, stop);
+    }
+    printf("[RxEngine] No variant for %u x %u-byte packets, running the generic loop\n", send_n, pkt_size);
+    return run_variant<0, 0>(res, sink, pkt_size, send_n, idle_us, stop);
+}
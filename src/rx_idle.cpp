@@ -0,0 +1,129 @@
+//混合轮询：忙轮询 CQ，空闲超过阈值后 arm 完成通道并睡眠，流量恢复后回到忙轮询
+#include <infiniband/verbs.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#if defined(__WAITPKG__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "rx_idle.h"
+#include "rx_thread.h"
+
+// 与完成时间戳（IBV_WC_EX_WITH_COMPLETION_TIMESTAMP_WALLCLOCK）同一时基
+static inline uint64_t wallclock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 空闲但还没睡眠时的自旋：tpause 进入 C0.2 约 1 us，否则 pause
+static inline void relax()
+{
+#if defined(__WAITPKG__)
+    _tpause(0, __rdtsc() + 2000);
+#elif defined(__SSE2__)
+    _mm_pause();
+#endif
+}
+
+RxIdle::RxIdle(struct ibv_utils_res * res, unsigned int idle_us)
+    : res(res), idle_ns((uint64_t)idle_us * 1000), t_idle(0), armed(false), t_wake(0), stamped(0), t_report(rx_now_ns()),
+      sleeps(0), slept_ns(0), wakes(0), wake_ns(0), wake_ns_max(0) {}
+
+int RxIdle::After(int n)
+{
+    if (!Enabled()) return 0;
+    if (n > 0) {
+        if (t_wake) {
+            uint64_t d = rx_now_ns() - t_wake;
+            // 网卡时钟没有与系统时钟同步（phc2sys）时时间戳不可比，差值离谱时退回从唤醒算起
+            uint64_t wall = wallclock_ns();
+            if (res->stamp_ns && res->stamp_ns <= wall && wall - res->stamp_ns < (uint64_t)RX_IDLE_SLEEP_MS * 1000000) {
+                d = wall - res->stamp_ns;
+                stamped++;
+            }
+            res->stamp_ns = 0;
+            res->stamp_next = false;
+            wakes++;
+            wake_ns += d;
+            if (d > wake_ns_max) wake_ns_max = d;
+            t_wake = 0;
+        }
+        t_idle = 0;
+        return 0;
+    }
+    uint64_t now = rx_now_ns();
+    if (t_idle == 0) {
+        t_idle = now;
+        return 0;
+    }
+    if (now - t_idle < idle_ns) {
+        relax();
+        return 0;
+    }
+    // 通知是一次性的：arm 之后流量恢复也会留下一个事件，下次睡眠时立即返回，取走后重新 arm
+    if (!armed) {
+        if (ibv_req_notify_cq(res->cq, 0)) {
+            printf("[RxIdle] ERROR: failed to arm the CQ\n");
+            return -1;
+        }
+        armed = true;
+        return 0;
+    }
+    struct pollfd pfd;
+    pfd.fd = res->recv_cc->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    t_wake = 0;
+    // arm 之后流量恢复过，事件已经就绪：先不等待地取走，不算一次唤醒，调用方再 poll 一次后重新 arm
+    int r = poll(&pfd, 1, 0);
+    bool blocked = r == 0;
+    if (blocked) r = poll(&pfd, 1, RX_IDLE_SLEEP_MS);
+    uint64_t t = rx_now_ns();
+    if (blocked) {
+        sleeps++;
+        slept_ns += t - now;
+    }
+    if (r < 0) {
+        if (errno == EINTR) return 0;
+        printf("[RxIdle] ERROR: failed to wait on the completion channel\n");
+        return -1;
+    }
+    if (r == 0) return 0;
+    struct ibv_cq * cq = NULL;
+    void * ctx = NULL;
+    if (ibv_get_cq_event(res->recv_cc, &cq, &ctx)) {
+        printf("[RxIdle] ERROR: failed to get the CQ event\n");
+        return -1;
+    }
+    ibv_ack_cq_events(cq, 1);
+    armed = false;
+    if (blocked) {
+        t_wake = t;
+        res->stamp_ns = 0;
+        res->stamp_next = res->cq_ex != NULL;
+    }
+    return 0;
+}
+
+void RxIdle::Report(const char * who)
+{
+    if (!Enabled()) return;
+    uint64_t now = rx_now_ns();
+    double span = (double)(now - t_report);
+    if (sleeps > 0 || wakes > 0) {
+        printf("[%s] idle: %lu sleeps, asleep %.1f%% of the time, wake-up latency avg %.1f us max %.1f us over %lu wakes "
+               "(%lu from completion timestamps)\n", who, (unsigned long)sleeps, span > 0 ? slept_ns * 100.0 / span : 0.0,
+               wakes ? wake_ns / 1e3 / wakes : 0.0, wake_ns_max / 1e3, (unsigned long)wakes, (unsigned long)stamped);
+    }
+    t_report = now;
+    sleeps = 0;
+    slept_ns = 0;
+    wakes = 0;
+    wake_ns = 0;
+    wake_ns_max = 0;
+    stamped = 0;
+}
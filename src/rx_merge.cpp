@@ -0,0 +1,328 @@
+//多网卡聚合：每个设备一个 QP 和一个绑核线程，按包序号把各链路的包放进同一个 block，重复包去重
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rx_merge.h"
+#include "rx_thread.h"
+#include "rx_numa.h"
+
+RxMergeGroup::RxMergeGroup(const RoCEv2Dada::RdmaParam * param, unsigned int nlinks)
+    : param(param), nlinks(nlinks), blk(param, 1, "RxMergeGroup"), base(UINT64_MAX), gen(0), epoch(0), resyncs(0),
+      stale_run(0), stale_since(0), stop(false)
+{
+    memset(links, 0, sizeof(links));
+    for (unsigned int i = 0; i < RX_MAX_LINKS; i++) {
+        links[i].group = this;
+        links[i].idx = i;
+    }
+    // 读锁在每次 poll 后都会释放，写者优先避免切换 block 时被读者饿死
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+}
+
+RxMergeGroup::~RxMergeGroup()
+{
+    Stop();
+    pthread_rwlock_destroy(&lock);
+    for (unsigned int i = 0; i < RX_MAX_LINKS; i++) free(links[i].parked);
+}
+
+void RxMergeGroup::SetLink(unsigned int idx, struct ibv_utils_res * res)
+{
+    if (idx < nlinks) links[idx].res = res;
+}
+
+static inline const char * frame_of(struct ibv_utils_res * res, uint64_t wr_id)
+{
+    return (const char *)(uintptr_t)res->sge[wr_id * res->recv_nsge].addr;
+}
+
+int RxMergeGroup::Repost(Link * l, uint64_t wr_id)
+{
+    struct ibv_utils_res * res = l->res;
+    res->recv_wr->wr_id = wr_id;
+    res->recv_wr->sg_list = &res->sge[wr_id * res->recv_nsge];
+    res->recv_wr->num_sge = res->recv_nsge;
+    res->recv_wr->next = NULL;
+    if (ibv_post_recv(res->qp, res->recv_wr, &res->bad_recv_wr)) {
+        printf("[RxMergeGroup] ERROR: link %u failed to repost recv WR\n", l->idx);
+        return -1;
+    }
+    return 0;
+}
+
+// 提交当前 block（空槽位清零、交出丢失位图）并打开下一个，调用方持有写锁
+int RxMergeGroup::Commit()
+{
+    uint64_t prev_slots = blk.slots;
+    if (blk.Commit() < 0) return -1;
+    base += prev_slots;
+    return 0;
+}
+
+// 提交当前 block；seq 不为 UINT64_MAX 时越过中间的 block：不超过 RX_FILL_BLOCKS 个时补交全零 block 保持时间对齐，
+// 更远（调用方已有多个包佐证）视为发送端重启，整段计入缺失后重新对齐。base 始终按 block 前进
+int RxMergeGroup::Advance(uint64_t seen_gen, uint64_t seq)
+{
+    int ret = 0;
+    pthread_rwlock_wrlock(&lock);
+    if (gen == seen_gen) {
+        ret = Commit();
+        if (ret == 0 && seq != UINT64_MAX && seq >= base + blk.slots) {
+            uint64_t skip = (seq - base) / blk.slots;
+            if (skip <= RX_FILL_BLOCKS) {
+                // 整块丢失：补交全零 block
+                for (uint64_t k = 0; k < skip && ret == 0; k++) ret = Commit();
+            } else {
+                printf("[RxMergeGroup] sequence counter jumped %lu blocks ahead to %lu, resynchronising\n",
+                       (unsigned long)skip, (unsigned long)seq);
+                blk.missing += skip * blk.slots;
+                base += skip * blk.slots;
+                resyncs++;
+            }
+        }
+        if (ret == 0) __atomic_store_n(&gen, seen_gen + 1, __ATOMIC_RELEASE);
+    }
+    pthread_rwlock_unlock(&lock);
+    return ret;
+}
+
+// 计数器回退：已收到的部分照常提交，base 对齐到触发回退的包，各链路暂留的旧流包随 epoch 作废
+int RxMergeGroup::Resync(uint64_t seen_gen, uint64_t seq)
+{
+    int ret = 0;
+    pthread_rwlock_wrlock(&lock);
+    // 其它链路已经重新对齐，或期间又收到了新包
+    if (gen == seen_gen && __atomic_load_n(&stale_since, __ATOMIC_ACQUIRE) != 0) {
+        printf("[RxMergeGroup] sequence counter went back to %lu (block base %lu) after %lu stale packets, resynchronising\n",
+               (unsigned long)seq, (unsigned long)base, (unsigned long)__atomic_load_n(&stale_run, __ATOMIC_RELAXED));
+        if (blk.filled > 0) ret = Commit();
+        base = seq;
+        resyncs++;
+        __atomic_store_n(&stale_run, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&stale_since, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&epoch, epoch + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&gen, seen_gen + 1, __ATOMIC_RELEASE);
+    }
+    pthread_rwlock_unlock(&lock);
+    return ret;
+}
+
+// 0：已处理（放入或丢弃），可以重新投递；1：属于后面的 block，暂留；2：旧包已连续到达太多，需要 Resync；<0：出错
+int RxMergeGroup::Place(Link * l, const char * pkt)
+{
+    unsigned int pkt_len = param->pkt_size;
+    uint64_t seq = pkt_seq_get(pkt);
+    pthread_rwlock_rdlock(&lock);
+    if (base == UINT64_MAX) {
+        // 第一个到达的包决定序号起点
+        pthread_rwlock_unlock(&lock);
+        pthread_rwlock_wrlock(&lock);
+        if (base == UINT64_MAX) base = seq;
+        pthread_rwlock_unlock(&lock);
+        pthread_rwlock_rdlock(&lock);
+    }
+    uint64_t g = gen;
+    l->seen_gen = g;
+    if (seq < base) {
+        l->stale++;
+        bool far = base - seq > RX_MERGE_LAG_BLOCKS * blk.slots;
+        pthread_rwlock_unlock(&lock);
+        // 零星迟到的包和慢链路的副本照常丢弃；所有链路都只剩远落后的包时说明计数器回退了
+        if (!far) return 0;
+        uint64_t now = rx_now_ns();
+        uint64_t run = __atomic_add_fetch(&stale_run, 1, __ATOMIC_ACQ_REL);
+        uint64_t since = 0;
+        if (!__atomic_compare_exchange_n(&stale_since, &since, now, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            if (since != 0 && now - since >= RX_MERGE_HOLD_NS) return 2;
+        }
+        return run >= RX_MERGE_STALE_RUN ? 2 : 0;
+    }
+    if (__atomic_load_n(&stale_since, __ATOMIC_RELAXED) != 0) {
+        __atomic_store_n(&stale_run, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&stale_since, 0, __ATOMIC_RELEASE);
+    }
+    uint64_t off = seq - base;
+    if (off >= blk.slots) {
+        pthread_rwlock_unlock(&lock);
+        return 1;
+    }
+    uint64_t bit = 1ull << (off & 63);
+    if (__atomic_fetch_or(&blk.bitmap[off >> 6], bit, __ATOMIC_ACQ_REL) & bit) {
+        l->dups++;
+        pthread_rwlock_unlock(&lock);
+        return 0;
+    }
+    memcpy(blk.block + off * pkt_len, pkt, pkt_len);
+    l->packets++;
+    bool full = __atomic_add_fetch(&blk.filled, 1, __ATOMIC_ACQ_REL) == blk.slots;
+    pthread_rwlock_unlock(&lock);
+    return full ? Advance(g, UINT64_MAX) : 0;
+}
+
+// 暂留超时或暂留的 WR 太多：带着空洞提交当前 block，暂留的包越过的 block 不超过 RX_FILL_BLOCKS 个时补交全零 block。
+// 跳得更远时要有 RX_MERGE_JUMP_AGREE 个包落在同一目标 block 才整段跳过，否则这些包丢弃，不让单个坏序号带走 base
+int RxMergeGroup::Release(Link * l)
+{
+    pthread_rwlock_rdlock(&lock);
+    uint64_t g = gen, b = base, n = blk.slots;
+    pthread_rwlock_unlock(&lock);
+    if (g != l->park_gen) return 0;  // 其它链路已经推进，重放即可
+    while (l->nparked > 0) {
+        uint64_t min_seq = UINT64_MAX;
+        for (unsigned int i = 0; i < l->nparked; i++) {
+            uint64_t seq = pkt_seq_get(frame_of(l->res, l->parked[i]));
+            if (seq < min_seq) min_seq = seq;
+        }
+        if ((min_seq - b) / n <= RX_FILL_BLOCKS) return Advance(g, min_seq);
+        uint64_t target = min_seq - (min_seq - b) % n;
+        unsigned int agree = 0;
+        for (unsigned int i = 0; i < l->nparked; i++) {
+            if (pkt_seq_get(frame_of(l->res, l->parked[i])) - target < n) agree++;
+        }
+        if (agree >= RX_MERGE_JUMP_AGREE) return Advance(g, min_seq);
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < l->nparked; i++) {
+            if (pkt_seq_get(frame_of(l->res, l->parked[i])) - target >= n) l->parked[kept++] = l->parked[i];
+            else if (Repost(l, l->parked[i]) < 0) return -1;
+        }
+        l->outliers += l->nparked - kept;
+        l->nparked = kept;
+    }
+    return 0;
+}
+
+// block 切换后把暂留的 WR 重新放一遍；重新对齐过时暂留的是旧流的包，直接作废
+int RxMergeGroup::Replay(Link * l)
+{
+    bool expired = l->park_epoch != __atomic_load_n(&epoch, __ATOMIC_ACQUIRE);
+    l->park_gen = __atomic_load_n(&gen, __ATOMIC_ACQUIRE);
+    l->park_epoch = __atomic_load_n(&epoch, __ATOMIC_ACQUIRE);
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < l->nparked; i++) {
+        int ret = 0;
+        if (expired) l->stale++;
+        else ret = Place(l, frame_of(l->res, l->parked[i]));
+        if (ret < 0) return -1;
+        if (ret == 1) l->parked[kept++] = l->parked[i];
+        else if (Repost(l, l->parked[i]) < 0) return -1;
+    }
+    l->nparked = kept;
+    l->t_hold = kept ? rx_now_ns() : 0;
+    return 0;
+}
+
+int RxMergeGroup::Run(Link * l)
+{
+    struct ibv_utils_res * res = l->res;
+    RxRate rate;
+    uint64_t packets_pre = 0, blocks_pre = 0;
+    while (!stop) {
+        int n = ibv_poll_cq(res->cq, res->poll_n, res->wc);
+        if (n < 0) {
+            printf("[RxMergeGroup] ERROR: link %u failed to poll CQ\n", l->idx);
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t wr_id = res->wc[i].wr_id;
+            int ret = 0;
+            if (res->wc[i].status == IBV_WC_SUCCESS) {
+                const char * pkt = frame_of(res, wr_id);
+                ret = Place(l, pkt);
+                if (ret == 2) ret = Resync(l->seen_gen, pkt_seq_get(pkt)) < 0 ? -1 : Place(l, pkt);
+            } else {
+                l->errors++;
+            }
+            if (ret < 0) return -1;
+            if (ret == 1) {
+                // 包属于后面的 block：先不重新投递，继续 poll，等其它链路补齐当前 block
+                if (l->nparked == 0) {
+                    l->t_hold = rx_now_ns();
+                    l->park_gen = l->seen_gen;
+                    l->park_epoch = __atomic_load_n(&epoch, __ATOMIC_ACQUIRE);
+                }
+                l->parked[l->nparked++] = wr_id;
+            } else if (Repost(l, wr_id) < 0) {
+                return -1;
+            }
+        }
+        if (l->nparked > 0) {
+            if (__atomic_load_n(&gen, __ATOMIC_ACQUIRE) == l->park_gen &&
+                (l->nparked >= l->max_parked || rx_now_ns() - l->t_hold >= RX_MERGE_HOLD_NS) && Release(l) < 0) {
+                return -1;
+            }
+            if (__atomic_load_n(&gen, __ATOMIC_ACQUIRE) != l->park_gen && Replay(l) < 0) return -1;
+        }
+
+        if (rate.Due()) {
+            uint64_t pkts = RxRate::Delta(l->packets, &packets_pre);
+            printf("[RxMerge %u] %s cpu %d: %.3f Gbps, dup %lu, stale %lu, outlier %lu, err %lu\n", l->idx,
+                   ibv_get_device_name(res->dev), param->bind_cpu_id >= 0 ? param->bind_cpu_id + (int)l->idx : -1,
+                   rate.Gbps(pkts * (uint64_t)param->pkt_size), (unsigned long)l->dups,
+                   (unsigned long)l->stale, (unsigned long)l->outliers, (unsigned long)l->errors);
+            if (l->idx == 0) {
+                uint64_t b = __atomic_load_n(&blk.blocks, __ATOMIC_RELAXED);
+                printf("[RxMerge] %lu blocks (%.1f/s), %lu missing slots, resync %lu\n", (unsigned long)b,
+                       RxRate::Delta(b, &blocks_pre) / rate.Secs(), (unsigned long)__atomic_load_n(&blk.missing, __ATOMIC_RELAXED),
+                       (unsigned long)__atomic_load_n(&resyncs, __ATOMIC_RELAXED));
+            }
+        }
+    }
+    return 0;
+}
+
+void * RxMergeGroup::LinkThread(void * arg)
+{
+    Link * l = (Link *)arg;
+    RxMergeGroup * g = l->group;
+    if (g->Run(l) < 0) {
+        // 其余链路无法单独推进 block 的提交顺序，全部停止
+        g->stop = true;
+    }
+    return NULL;
+}
+
+int RxMergeGroup::Start(const RxThreadPlace & place)
+{
+    for (unsigned int i = 0; i < nlinks; i++) {
+        if (!links[i].res) { printf("[RxMergeGroup] ERROR: link %u has no device\n", i); return -1; }
+        // 暂留的 WR 最多占接收队列的一半
+        links[i].max_parked = links[i].res->recv_wr_num / 2 ? links[i].res->recv_wr_num / 2 : 1;
+        links[i].parked = (uint64_t *)malloc(links[i].res->recv_wr_num * sizeof(uint64_t));
+        if (!links[i].parked) { printf("[RxMergeGroup] ERROR: failed to allocate parked WR list\n"); return -1; }
+    }
+    if (blk.Open() < 0) return -1;
+    for (unsigned int i = 0; i < nlinks; i++) {
+        printf("[RxMergeGroup] link %u: device %s, cpu %d\n", i, ibv_get_device_name(links[i].res->dev),
+               param->bind_cpu_id >= 0 ? param->bind_cpu_id + (int)i : -1);
+    }
+    printf("[RxMergeGroup] %lu slots per block, ordered by the sequence counter at offset %d\n",
+           (unsigned long)blk.slots, PKT_SEQ_OFFSET);
+    for (unsigned int i = 0; i < nlinks; i++) {
+        Link * l = &links[i];
+        // 各链路的网卡可能在不同节点上：做 NUMA 放置时每个线程放到自己网卡的节点
+        RxThreadPlace p = place;
+        if (p.cpu >= 0) p.cpu += (int)i;
+        if (p.numa_node >= 0) {
+            int node = rx_numa_node_of_ibdev(ibv_get_device_name(l->res->dev));
+            if (node >= 0) p.numa_node = node;
+        }
+        if (rx_thread_start(&l->tid, LinkThread, l, p, "RxMergeGroup") < 0) {
+            printf("[RxMergeGroup] ERROR: failed to create thread for link %u\n", i);
+            Stop();
+            return -1;
+        }
+        l->started = true;
+    }
+    return 0;
+}
+
+void RxMergeGroup::Stop()
+{
+    stop = true;
+    for (unsigned int i = 0; i < nlinks; i++) rx_thread_join(links[i].tid, &links[i].started);
+}
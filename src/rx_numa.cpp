@@ -0,0 +1,177 @@
+//NUMA 放置和实时线程配置：sysfs 读网卡节点，mbind/set_mempolicy 放内存，SCHED_FIFO/mlockall
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "rx_numa.h"
+
+// <numaif.h> 属于 libnuma 的开发包，这里只用到几个常量
+#define RX_MPOL_DEFAULT    0
+#define RX_MPOL_PREFERRED  1
+#define RX_MPOL_MF_MOVE    (1 << 1)
+#define RX_HUGE_PAGE       (2ul << 20)
+
+static int read_node(const char * path)
+{
+    FILE * fp = fopen(path, "r");
+    if (!fp) return -1;
+    int node = -1;
+    if (fscanf(fp, "%d", &node) != 1) node = -1;
+    fclose(fp);
+    return node;  // 单节点机器或虚拟设备上为 -1
+}
+
+int rx_numa_node_of_ibdev(const char * ibdev)
+{
+    if (!ibdev || !ibdev[0]) return -1;
+    char path[256];
+    snprintf(path, sizeof(path), "/sys/class/infiniband/%s/device/numa_node", ibdev);
+    return read_node(path);
+}
+
+int rx_numa_node_of_netdev(const char * ifname)
+{
+    if (!ifname || !ifname[0]) return -1;
+    char path[256];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", ifname);
+    return read_node(path);
+}
+
+int rx_numa_cpus(int node, cpu_set_t * cpus)
+{
+    if (node < 0 || !cpus) return -1;
+    char path[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE * fp = fopen(path, "r");
+    if (!fp) return -1;
+    char list[4096];
+    if (!fgets(list, sizeof(list), fp)) list[0] = '\0';
+    fclose(fp);
+    // cpulist 形如 "0-15,32-47"
+    CPU_ZERO(cpus);
+    int n = 0;
+    char * save = NULL;
+    for (char * tok = strtok_r(list, ",\n", &save); tok; tok = strtok_r(NULL, ",\n", &save)) {
+        int lo = 0, hi = 0;
+        int k = sscanf(tok, "%d-%d", &lo, &hi);
+        if (k < 1) continue;
+        if (k == 1) hi = lo;
+        for (int c = lo; c <= hi && c < CPU_SETSIZE; c++) {
+            CPU_SET(c, cpus);
+            n++;
+        }
+    }
+    return n > 0 ? n : -1;
+}
+
+int rx_numa_bind(void * addr, size_t bytes, int node, bool move)
+{
+    if (!addr || bytes == 0 || node < 0 || node >= RX_NUMA_MAX_NODES) return -1;
+    unsigned long mask[RX_NUMA_MASK_WORDS];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    // mbind 要求起点按页对齐
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    size_t len = (uintptr_t)addr + bytes - start;
+    return (int)syscall(SYS_mbind, (void *)start, len, RX_MPOL_PREFERRED, mask, (unsigned long)RX_NUMA_MAX_NODES + 1,
+                        move ? RX_MPOL_MF_MOVE : 0);
+}
+
+int rx_numa_prefer(int node)
+{
+    if (node < 0) return (int)syscall(SYS_set_mempolicy, RX_MPOL_DEFAULT, NULL, 0ul);
+    if (node >= RX_NUMA_MAX_NODES) return -1;
+    unsigned long mask[RX_NUMA_MASK_WORDS];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    return (int)syscall(SYS_set_mempolicy, RX_MPOL_PREFERRED, mask, (unsigned long)RX_NUMA_MAX_NODES + 1);
+}
+
+int rx_numa_get_policy(int * mode, unsigned long * mask)
+{
+    memset(mask, 0, RX_NUMA_MASK_WORDS * sizeof(unsigned long));
+    return (int)syscall(SYS_get_mempolicy, mode, mask, (unsigned long)RX_NUMA_MAX_NODES + 1, NULL, 0ul);
+}
+
+int rx_numa_set_policy(int mode, const unsigned long * mask)
+{
+    return (int)syscall(SYS_set_mempolicy, mode, mask, (unsigned long)RX_NUMA_MAX_NODES + 1);
+}
+
+RxNumaScope::RxNumaScope(int node) : active(false), mode(RX_MPOL_DEFAULT)
+{
+    if (node < 0) return;
+    // 读不到原来的策略就无法恢复，不改动
+    if (rx_numa_get_policy(&mode, mask) < 0) {
+        printf("[RxNuma] WARNING: get_mempolicy failed (%s), allocations are not steered to node %d\n", strerror(errno), node);
+        return;
+    }
+    active = rx_numa_prefer(node) == 0;
+}
+
+RxNumaScope::~RxNumaScope()
+{
+    if (active && rx_numa_set_policy(mode, mask) < 0) {
+        printf("[RxNuma] WARNING: failed to restore the thread's memory policy (%s)\n", strerror(errno));
+    }
+}
+
+void * rx_numa_alloc(size_t bytes, int node, size_t * mapped, bool * huge)
+{
+    if (bytes == 0 || !mapped) return NULL;
+    size_t len = (bytes + RX_HUGE_PAGE - 1) & ~(RX_HUGE_PAGE - 1);
+    bool is_huge = true;
+    void * p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+        // 没有预留大页（vm.nr_hugepages = 0）时退回普通页，由透明大页尽量合并
+        is_huge = false;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        len = (bytes + page - 1) & ~(page - 1);
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+        madvise(p, len, MADV_HUGEPAGE);
+    }
+    // 先设策略再写零，页在 node 上落地（节点内存不够时内核退到其他节点，不会失败）
+    if (node >= 0 && rx_numa_bind(p, len, node, false) < 0) {
+        printf("[RxNuma] WARNING: mbind to node %d failed (%s), buffer placed by the default policy\n", node, strerror(errno));
+    }
+    memset(p, 0, len);
+    *mapped = len;
+    if (huge) *huge = is_huge;
+    return p;
+}
+
+void rx_numa_free(void * addr, size_t mapped)
+{
+    if (addr && mapped) munmap(addr, mapped);
+}
+
+int rx_rt_attr(pthread_attr_t * attr, int rt_priority)
+{
+    if (!attr || rt_priority <= 0) return 0;
+    int lo = sched_get_priority_min(SCHED_FIFO), hi = sched_get_priority_max(SCHED_FIFO);
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = rt_priority < lo ? lo : (rt_priority > hi ? hi : rt_priority);
+    if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) || pthread_attr_setschedpolicy(attr, SCHED_FIFO)
+        || pthread_attr_setschedparam(attr, &sp)) {
+        printf("[RxNuma] ERROR: failed to set SCHED_FIFO priority %d on the thread attributes\n", sp.sched_priority);
+        return -1;
+    }
+    return 0;
+}
+
+int rx_mlock_all()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        printf("[RxNuma] WARNING: mlockall failed (%s), raise RLIMIT_MEMLOCK or run with CAP_IPC_LOCK\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+//分片接收：N 个后端实例各由一个绑核线程轮询，分别写 block 中互不重叠的一段，屏障保证每个 block 只 MarkWritten 一次
+#include <string.h>
+#include <stdio.h>
+
+#include "rx_shard.h"
+#include "rx_thread.h"
+
+RxShardGroup::RxShardGroup(const RoCEv2Dada::RdmaParam * param, unsigned int nshards)
+    : param(param), nshards(nshards), batch_bytes((long int)param->send_n * param->pkt_size), block(NULL),
+      block_batches(0), gen(0), arrived(0), stop(false)
+{
+    memset(shards, 0, sizeof(shards));
+    for (unsigned int i = 0; i < RX_MAX_SHARDS; i++) {
+        shards[i].group = this;
+        shards[i].idx = i;
+    }
+}
+
+RxShardGroup::~RxShardGroup()
+{
+    Stop();
+    for (unsigned int i = 0; i < nshards; i++) {
+        delete shards[i].transport;
+        shards[i].transport = NULL;
+    }
+}
+
+void RxShardGroup::SetShard(unsigned int idx, RxTransport * transport)
+{
+    if (idx < nshards) shards[idx].transport = transport;
+}
+
+// 取下一个 block；block 至少要容纳每个分片一个批次
+int RxShardGroup::OpenBlock()
+{
+    long int bufsz = 0;
+    char * p = param->GetBuffPtr(bufsz);
+    if (!p || bufsz < batch_bytes * (long int)nshards) {
+        printf("[RxShardGroup] ERROR: block %p of %ld bytes cannot hold %u shards x %ld-byte batches\n",
+               (void *)p, bufsz, nshards, batch_bytes);
+        return -1;
+    }
+    block = p;
+    block_batches = bufsz / batch_bytes;
+    return 0;
+}
+
+void RxShardGroup::Range(unsigned int idx, char ** begin, long int * bytes) const
+{
+    long int first = block_batches * idx / nshards;
+    long int last = block_batches * (idx + 1) / nshards;
+    *begin = block + first * batch_bytes;
+    *bytes = (last - first) * batch_bytes;
+}
+
+int RxShardGroup::Run(Shard * s)
+{
+    unsigned int send_n = param->send_n;
+    unsigned int pkt_len = param->pkt_size;
+    uint64_t my_gen = __atomic_load_n(&gen, __ATOMIC_ACQUIRE);
+    char * dst;
+    long int bytes, filled = 0;
+    unsigned int batch_filled = 0;
+    Range(s->idx, &dst, &bytes);
+    if (s->transport->BeginBlock(dst, bytes) < 0) return -1;
+
+    RxRate rate;
+    uint64_t packets_pre = 0, wait_pre = 0;
+    while (!stop) {
+        if (filled < bytes) {
+            int ret = s->transport->Recv(dst + filled + (long int)batch_filled * pkt_len, send_n - batch_filled);
+            if (ret < 0) {
+                printf("[RxShardGroup] ERROR: shard %u failed to recv (transport=%s)\n", s->idx, s->transport->Name());
+                return -1;
+            }
+            batch_filled += ret;
+            s->packets += ret;
+            if (batch_filled >= send_n) {
+                filled += batch_bytes;
+                batch_filled = 0;
+            }
+        } else {
+            // 本段写满：最后一个到达的分片提交 block 并打开下一个
+            uint64_t t0 = rx_now_ns();
+            if (__atomic_add_fetch(&arrived, 1, __ATOMIC_ACQ_REL) == nshards) {
+                __atomic_store_n(&arrived, 0, __ATOMIC_RELAXED);
+                if (param->DataSendBuff() < 0) {
+                    printf("[RxShardGroup] ERROR: failed to mark block as written\n");
+                    return -1;
+                }
+                if (OpenBlock() < 0) return -1;
+                __atomic_store_n(&gen, my_gen + 1, __ATOMIC_RELEASE);
+            } else {
+                while (__atomic_load_n(&gen, __ATOMIC_ACQUIRE) == my_gen) {
+                    if (stop) return 0;
+                    rx_cpu_relax();
+                }
+            }
+            s->wait_ns += rx_now_ns() - t0;
+            my_gen++;
+            Range(s->idx, &dst, &bytes);
+            filled = 0;
+            if (s->transport->BeginBlock(dst, bytes) < 0) return -1;
+        }
+
+        if (rate.Due()) {
+            uint64_t pkts = RxRate::Delta(s->packets, &packets_pre);
+            printf("[RxShard %u] cpu %d: %.3f Gbps, %.3f Mpps, barrier wait %.1f%%\n", s->idx,
+                   param->bind_cpu_id >= 0 ? param->bind_cpu_id + (int)s->idx : -1,
+                   rate.Gbps(pkts * (uint64_t)pkt_len), pkts / rate.Secs() / 1e6,
+                   RxRate::Delta(s->wait_ns, &wait_pre) / 1e7 / rate.Secs());
+        }
+    }
+    return 0;
+}
+
+void * RxShardGroup::ShardThread(void * arg)
+{
+    Shard * s = (Shard *)arg;
+    RxShardGroup * g = s->group;
+    if (g->Run(s) < 0) {
+        // 一个分片出错时其它分片也无法完成 block，全部停止
+        g->stop = true;
+    }
+    return NULL;
+}
+
+int RxShardGroup::Start(const RxThreadPlace & place)
+{
+    for (unsigned int i = 0; i < nshards; i++) {
+        if (!shards[i].transport) { printf("[RxShardGroup] ERROR: shard %u has no transport\n", i); return -1; }
+    }
+    if (OpenBlock() < 0) return -1;
+    for (unsigned int i = 0; i < nshards; i++) {
+        char * begin;
+        long int bytes;
+        Range(i, &begin, &bytes);
+        printf("[RxShardGroup] shard %u: transport=%s, block offset %ld (%ld bytes), cpu %d\n", i,
+               shards[i].transport->Name(), (long int)(begin - block), bytes,
+               param->bind_cpu_id >= 0 ? param->bind_cpu_id + (int)i : -1);
+    }
+    for (unsigned int i = 0; i < nshards; i++) {
+        Shard * s = &shards[i];
+        RxThreadPlace p = place;
+        if (p.cpu >= 0) p.cpu += (int)i;
+        if (rx_thread_start(&s->tid, ShardThread, s, p, "RxShardGroup") < 0) {
+            printf("[RxShardGroup] ERROR: failed to create thread for shard %u\n", i);
+            Stop();
+            return -1;
+        }
+        s->started = true;
+    }
+    return 0;
+}
+
+void RxShardGroup::Stop()
+{
+    stop = true;
+    for (unsigned int i = 0; i < nshards; i++) rx_thread_join(shards[i].tid, &shards[i].started);
+}
@@ -0,0 +1,114 @@
+//按序号放置的 block：到达位图、提交时空槽位清零和丢失位图，多源拼帧与多网卡聚合共用
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "rx_slots.h"
+
+// 清零丢失的槽位：整段用非临时存储写零，不把即将交给读端的 block 拉进缓存
+static void zero_bytes(char * p, uint64_t n)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    uint64_t head = (16 - ((uintptr_t)p & 15)) & 15;
+    if (head > n) head = n;
+    memset(p, 0, head);
+    p += head;
+    n -= head;
+#if defined(__AVX2__)
+    if (n >= 32 && ((uintptr_t)p & 31)) {
+        _mm_stream_si128((__m128i *)p, _mm_setzero_si128());
+        p += 16;
+        n -= 16;
+    }
+    const __m256i z = _mm256_setzero_si256();
+    for (; n >= 32; p += 32, n -= 32) _mm256_stream_si256((__m256i *)p, z);
+#endif
+    const __m128i z16 = _mm_setzero_si128();
+    for (; n >= 16; p += 16, n -= 16) _mm_stream_si128((__m128i *)p, z16);
+#endif
+    memset(p, 0, n);
+}
+
+RxSlotBlock::RxSlotBlock(const RoCEv2Dada::RdmaParam * param, unsigned int nsegs, const char * who)
+    : block(NULL), slots(0), bitmap(NULL), filled(0), blocks(0), missing(0), param(param), nsegs(nsegs), who(who),
+      loss(NULL), bitmap_words(0)
+{
+}
+
+RxSlotBlock::~RxSlotBlock()
+{
+    free(bitmap);
+    free(loss);
+}
+
+int RxSlotBlock::Open()
+{
+    long int bufsz = 0;
+    char * p = param->GetBuffPtr(bufsz);
+    uint64_t n = p ? (uint64_t)bufsz / ((uint64_t)param->pkt_size * nsegs) : 0;
+    if (n == 0) {
+        printf("[%s] ERROR: block %p of %ld bytes cannot hold one packet per segment (%u segments)\n",
+               who, (void *)p, bufsz, nsegs);
+        return -1;
+    }
+    uint64_t words = (n * nsegs + 63) / 64;
+    if (words > bitmap_words) {
+        free(bitmap);
+        free(loss);
+        bitmap = (uint64_t *)malloc(words * sizeof(uint64_t));
+        loss = (uint64_t *)malloc(words * sizeof(uint64_t));
+        bitmap_words = bitmap && loss ? words : 0;
+        if (!bitmap || !loss) { printf("[%s] ERROR: failed to allocate slot bitmap\n", who); return -1; }
+    }
+    memset(bitmap, 0, words * sizeof(uint64_t));
+    block = p;
+    slots = n;
+    filled = 0;
+    return 0;
+}
+
+// 由到达位图得到丢失位图，并把连续丢失的槽位整段清零
+void RxSlotBlock::ZeroFill()
+{
+    uint64_t total = slots * nsegs;
+    uint64_t words = (total + 63) / 64;
+    for (uint64_t w = 0; w < words; w++) loss[w] = ~bitmap[w];
+    if (total & 63) loss[words - 1] &= (1ull << (total & 63)) - 1;
+    uint64_t i = 0;
+    while (i < total) {
+        uint64_t m = loss[i >> 6] >> (i & 63);
+        if (m == 0) {
+            i = (i | 63) + 1;
+            continue;
+        }
+        i += __builtin_ctzll(m);
+        uint64_t end = i;
+        while (end < total && (loss[end >> 6] >> (end & 63) & 1)) end++;
+        zero_bytes(block + i * param->pkt_size, (end - i) * param->pkt_size);
+        i = end;
+    }
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+int RxSlotBlock::Commit()
+{
+    missing += slots * nsegs - filled;
+    if (filled < slots * nsegs) ZeroFill();
+    else memset(loss, 0, (slots * nsegs + 63) / 64 * sizeof(uint64_t));
+    if (param->LossSend && param->LossSend(loss, slots * nsegs) < 0) {
+        printf("[%s] ERROR: failed to hand over the loss bitmap\n", who);
+        return -1;
+    }
+    if (param->DataSendBuff() < 0) {
+        printf("[%s] ERROR: failed to mark block as written\n", who);
+        return -1;
+    }
+    if (Open() < 0) return -1;
+    blocks++;
+    return 0;
+}
@@ -0,0 +1,138 @@
+//多流接收：一个线程轮流 poll 各路流的后端，每路写自己的 ring 并各自做 block 计数
+#include <string.h>
+#include <stdio.h>
+
+#include "rx_stream.h"
+#include "rx_thread.h"
+
+RxStreamGroup::RxStreamGroup(const RoCEv2Dada::RdmaParam * param)
+    : param(param), nstreams(0), batch_bytes((long int)param->send_n * param->pkt_size), started(false), stop(false)
+{
+    memset(streams, 0, sizeof(streams));
+}
+
+RxStreamGroup::~RxStreamGroup()
+{
+    Stop();
+    for (unsigned int i = 0; i < nstreams; i++) {
+        delete streams[i]->transport;
+        delete streams[i];
+        streams[i] = NULL;
+    }
+}
+
+int RxStreamGroup::Add(const char * name, RxTransport * transport, const RoCEv2Dada::GetBuff & get_buff,
+                       const RoCEv2Dada::DataSend & data_send, const RoCEv2Dada::PeekBuff & peek_buff)
+{
+    if (nstreams == RX_MAX_STREAMS) return -1;
+    Stream * s = new Stream();
+    strncpy(s->name, name, sizeof(s->name) - 1);
+    s->name[sizeof(s->name) - 1] = '\0';
+    s->transport = transport;
+    s->GetBuffPtr = get_buff;
+    s->DataSendBuff = data_send;
+    s->PeekBuffPtr = peek_buff;
+    s->block = NULL;
+    s->bytes = s->filled = 0;
+    s->batch_filled = 0;
+    s->packets = s->blocks = s->full = 0;
+    s->waiting = false;
+    streams[nstreams] = s;
+    return (int)nstreams++;
+}
+
+// 0：已取得下一个 block；1：ring 已满，本轮跳过这一路；<0：出错
+int RxStreamGroup::OpenBlock(Stream * s)
+{
+    long int bufsz = 0;
+    if (s->PeekBuffPtr && !s->PeekBuffPtr(0, bufsz)) {
+        if (!s->waiting) s->full++;
+        s->waiting = true;
+        return 1;
+    }
+    s->waiting = false;
+    char * p = s->GetBuffPtr(bufsz);
+    if (!p || bufsz < batch_bytes) {
+        printf("[RxStreamGroup] ERROR: %s: block %p of %ld bytes cannot hold a %ld-byte batch\n",
+               s->name, (void *)p, bufsz, batch_bytes);
+        return -1;
+    }
+    s->block = p;
+    s->bytes = bufsz / batch_bytes * batch_bytes;
+    s->filled = 0;
+    return s->transport->BeginBlock(p, s->bytes) < 0 ? -1 : 0;
+}
+
+int RxStreamGroup::Run()
+{
+    unsigned int send_n = param->send_n;
+    unsigned int pkt_len = param->pkt_size;
+    RxRate rate;
+    uint64_t packets_pre[RX_MAX_STREAMS];
+    memset(packets_pre, 0, sizeof(packets_pre));
+    while (!stop) {
+        for (unsigned int i = 0; i < nstreams; i++) {
+            Stream * s = streams[i];
+            if (!s->block) {
+                int ret = OpenBlock(s);
+                if (ret < 0) return -1;
+                if (ret == 1) continue;
+            }
+            int ret = s->transport->Recv(s->block + s->filled + (long int)s->batch_filled * pkt_len, send_n - s->batch_filled);
+            if (ret < 0) {
+                printf("[RxStreamGroup] ERROR: %s failed to recv (transport=%s)\n", s->name, s->transport->Name());
+                return -1;
+            }
+            if (ret == 0) continue;
+            s->batch_filled += ret;
+            s->packets += ret;
+            if (s->batch_filled < send_n) continue;
+            s->batch_filled = 0;
+            s->filled += batch_bytes;
+            if (s->filled < s->bytes) continue;
+            if (s->DataSendBuff() < 0) {
+                printf("[RxStreamGroup] ERROR: %s failed to mark block as written\n", s->name);
+                return -1;
+            }
+            s->blocks++;
+            s->block = NULL;
+        }
+
+        if (rate.Due()) {
+            for (unsigned int i = 0; i < nstreams; i++) {
+                Stream * s = streams[i];
+                printf("[RxStream %u] %s: %.3f Gbps, %lu blocks, ring full %lu\n", i, s->name,
+                       rate.Gbps(RxRate::Delta(s->packets, &packets_pre[i]) * pkt_len), (unsigned long)s->blocks,
+                       (unsigned long)s->full);
+            }
+        }
+    }
+    return 0;
+}
+
+void * RxStreamGroup::Thread(void * arg)
+{
+    RxStreamGroup * g = (RxStreamGroup *)arg;
+    if (g->Run() < 0) g->stop = true;
+    return NULL;
+}
+
+int RxStreamGroup::Start(const RxThreadPlace & place)
+{
+    if (nstreams == 0) return -1;
+    for (unsigned int i = 0; i < nstreams; i++) {
+        printf("[RxStreamGroup] stream %u: %s (transport=%s)\n", i, streams[i]->name, streams[i]->transport->Name());
+    }
+    if (rx_thread_start(&tid, Thread, this, place, "RxStreamGroup") < 0) {
+        printf("[RxStreamGroup] ERROR: failed to create receive thread\n");
+        return -1;
+    }
+    started = true;
+    return 0;
+}
+
+void RxStreamGroup::Stop()
+{
+    stop = true;
+    rx_thread_join(tid, &started);
+}
@@ -0,0 +1,53 @@
+//天线/通道子集抽取：按头文件模板的包几何计算要保留的字节段，拷贝时逐包聚合
+#include <string.h>
+#include <stdio.h>
+
+#include "rx_subset.h"
+
+RxSubset::RxSubset() : nruns(0), in_len(0), out_len(0) {}
+
+int RxSubset::Init(const RoCEv2Dada::RdmaParam * param)
+{
+    nruns = 0;
+    in_len = param->pkt_size;
+    out_len = param->pkt_size;
+    if (param->nant == 0) return 0;
+    uint64_t ant_bytes = (uint64_t)param->pkt_nsamp * param->sample_bytes;
+    if (param->pkt_nsamp == 0 || param->sample_bytes == 0 || param->ant_count == 0 || param->chan_count == 0
+        || param->ant_first + param->ant_count > param->nant || param->chan_first + param->chan_count > param->pkt_nsamp
+        || param->ant_count > RX_SUBSET_MAX_RUNS || PKT_HEAD_LEN + param->nant * ant_bytes > param->pkt_size) {
+        printf("[RxSubset] ERROR: antennas %u+%u of %u, channels %u+%u of %u (%u bytes each) do not fit %u-byte packets\n",
+               param->ant_first, param->ant_count, param->nant, param->chan_first, param->chan_count, param->pkt_nsamp,
+               param->sample_bytes, param->pkt_size);
+        return -1;
+    }
+    runs[0].offset = 0;
+    runs[0].len = PKT_HEAD_LEN;
+    nruns = 1;
+    out_len = PKT_HEAD_LEN;
+    uint32_t len = param->chan_count * param->sample_bytes;
+    for (unsigned int a = param->ant_first; a < param->ant_first + param->ant_count; a++) {
+        uint32_t off = PKT_HEAD_LEN + a * ant_bytes + param->chan_first * param->sample_bytes;
+        Run * last = &runs[nruns - 1];
+        if (last->offset + last->len == off) last->len += len;
+        else {
+            runs[nruns].offset = off;
+            runs[nruns].len = len;
+            nruns++;
+        }
+        out_len += len;
+    }
+    return 0;
+}
+
+void RxSubset::Gather(char * dst, const char * src, unsigned int npkts) const
+{
+    for (unsigned int p = 0; p < npkts; p++) {
+        char * d = dst + (uint64_t)p * out_len;
+        const char * s = src + (uint64_t)p * in_len;
+        for (unsigned int i = 0; i < nruns; i++) {
+            memcpy(d, s + runs[i].offset, runs[i].len);
+            d += runs[i].len;
+        }
+    }
+}
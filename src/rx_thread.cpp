@@ -0,0 +1,55 @@
+//接收线程的创建和回收：绑核 / 绑 NUMA 节点、SCHED_FIFO 在线程属性上设置，创建时即生效
+#include <stdio.h>
+#include <errno.h>
+
+#include "rx_thread.h"
+#include "rx_numa.h"
+
+int rx_thread_start(pthread_t * tid, void * (*fn)(void *), void * arg, const RxThreadPlace & place, const char * who)
+{
+    cpu_set_t mask;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    CPU_ZERO(&mask);
+    if (place.cpu >= 0) {
+        CPU_SET(place.cpu, &mask);
+        cpu_set_t node_cpus;
+        if (place.numa_node >= 0 && rx_numa_cpus(place.numa_node, &node_cpus) > 0 && !CPU_ISSET(place.cpu, &node_cpus)) {
+            printf("[%s] WARNING: core %d is not on the NIC's NUMA node %d, every packet crosses the socket interconnect\n",
+                   who, place.cpu, place.numa_node);
+        }
+        pthread_attr_setaffinity_np(&attr, sizeof(mask), &mask);
+    } else if (place.numa_node >= 0 && rx_numa_cpus(place.numa_node, &mask) > 0) {
+        printf("[%s] Setting CPU affinity to the %d cores of NUMA node %d\n", who, CPU_COUNT(&mask), place.numa_node);
+        pthread_attr_setaffinity_np(&attr, sizeof(mask), &mask);
+    }
+    bool rt = false;
+    if (place.rt_priority > 0 && place.cpu < 0) {
+        printf("[%s] WARNING: SCHED_FIFO priority %d needs a dedicated core (bind_cpu_id), thread uses normal scheduling\n",
+               who, place.rt_priority);
+    } else if (place.rt_priority > 0) {
+        rt = rx_rt_attr(&attr, place.rt_priority) == 0;
+    }
+    int ret = pthread_create(tid, &attr, fn, arg);
+    if (ret == EPERM && rt) {
+        // 没有 CAP_SYS_NICE / rtprio 限额时退回普通调度
+        printf("[%s] WARNING: no permission for SCHED_FIFO priority %d, thread uses normal scheduling\n", who, place.rt_priority);
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        rt = false;
+        ret = pthread_create(tid, &attr, fn, arg);
+    }
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        printf("[%s] ERROR: pthread_create failed: %d\n", who, ret);
+        return -1;
+    }
+    if (place.cpu >= 0) printf("[%s] Thread bound to core %d%s\n", who, place.cpu, rt ? ", SCHED_FIFO" : "");
+    return 0;
+}
+
+void rx_thread_join(pthread_t tid, bool * started)
+{
+    if (!*started) return;
+    pthread_join(tid, NULL);
+    *started = false;
+}
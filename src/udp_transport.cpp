@@ -0,0 +1,182 @@
+//内核 UDP socket 接收后端：recvmmsg (+ 可选 UDP_GRO) 批量收包，直接写入 ring block
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "udp_transport.h"
+#include "pkt_gen.h"
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define UDP_RCVBUF_BYTES (256 * 1024 * 1024)
+#define UDP_RECV_TIMEOUT_US 100000
+#define UDP_MAX_GRO_BYTES 65535
+
+UdpRxTransport::UdpRxTransport(): fd(-1), pkt_size(0), payload_size(0), batch(0), segs_per_msg(1),
+    gro(false), recv_flags(MSG_WAITFORONE), msgs(NULL), iovs(NULL), cmsg_buf(NULL), truncated(0), gso_dropped(0)
+{
+    memset(frame_hdr, 0, sizeof(frame_hdr));
+}
+
+UdpRxTransport::~UdpRxTransport()
+{
+    if (truncated || gso_dropped) {
+        printf("[UdpRxTransport] truncated datagrams: %lu, dropped for GRO segment size mismatch: %lu\n",
+               (unsigned long)truncated, (unsigned long)gso_dropped);
+    }
+    if (fd >= 0) close(fd);
+    free(msgs);
+    free(iovs);
+    free(cmsg_buf);
+}
+
+int UdpRxTransport::Open(const struct ibv_pkt_info * pkt_info, unsigned int pkt_size, unsigned int batch, bool gro,
+                         uint32_t mcast_if)
+{
+    if (pkt_size <= UDP_FRAME_HDR_LEN || batch == 0) { ibv_utils_error("Invalid UDP transport geometry."); return -1; }
+    this->pkt_size = pkt_size;
+    this->payload_size = pkt_size - UDP_FRAME_HDR_LEN;
+    this->batch = batch;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) { perror("[UdpRxTransport] socket"); return -1; }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    int rcvbuf = UDP_RCVBUF_BYTES;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        ibv_utils_warn("Failed to enlarge UDP receive buffer.");
+    }
+    // 超时返回，接收线程可以周期性地回到主循环
+    struct timeval tv = { 0, UDP_RECV_TIMEOUT_US };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (gro) {
+        if (setsockopt(fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+            ibv_utils_warn("UDP_GRO not supported by kernel, continuing without it.");
+            gro = false;
+        }
+    }
+    this->gro = gro;
+    segs_per_msg = gro ? UDP_MAX_GRO_BYTES / payload_size : 1;
+    if (segs_per_msg == 0) segs_per_msg = 1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = pkt_info->dst_ip;
+    addr.sin_port = htons(pkt_info->dst_port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { perror("[UdpRxTransport] bind"); return -2; }
+    // 绑定组地址只收该组的数据报，SO_REUSEADDR 允许同机多个接收进程各收一份
+    if (ipv4_is_multicast(pkt_info->dst_ip) && ipv4_mcast_join(fd, pkt_info->dst_ip, mcast_if) < 0) return -2;
+
+    // connect() 让内核只投递来自该源地址/端口的数据报，相当于 RAW_PACKET 路径的 flow 规则
+    if (pkt_info->src_ip != 0 && pkt_info->src_port != 0) {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = pkt_info->src_ip;
+        addr.sin_port = htons(pkt_info->src_port);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { perror("[UdpRxTransport] connect"); return -3; }
+    }
+
+    msgs = (struct mmsghdr *)calloc(batch, sizeof(struct mmsghdr));
+    iovs = (struct iovec *)calloc(batch, sizeof(struct iovec));
+    cmsg_buf = (char *)calloc(batch, CMSG_SPACE(sizeof(int)));
+    if (!msgs || !iovs || !cmsg_buf) { ibv_utils_error("Failed to allocate memory for mmsghdr."); return -4; }
+
+    // 预先生成与 RAW_PACKET 帧一致的以太网/IP/UDP 头
+    struct udp_pkt pkt;
+    memset(&pkt, 0, UDP_FRAME_HDR_LEN);
+    set_dest_mac(&pkt, (uint8_t *)pkt_info->dst_mac);
+    set_src_mac(&pkt, (uint8_t *)pkt_info->src_mac);
+    set_eth_type(&pkt, (uint8_t *)"\x08\x00");
+    set_pkt_len(&pkt, pkt_size - 34);
+    set_src_ip(&pkt, (uint8_t *)&pkt_info->src_ip);
+    set_dst_ip(&pkt, (uint8_t *)&pkt_info->dst_ip);
+    set_udp_src_port(&pkt, pkt_info->src_port);
+    set_udp_dst_port(&pkt, pkt_info->dst_port);
+    memcpy(frame_hdr, &pkt, UDP_FRAME_HDR_LEN);
+
+    printf("[UdpRxTransport] Listening on port %d (payload=%u bytes, batch=%u, GRO=%s, segs/msg=%u)\n",
+           pkt_info->dst_port, payload_size, batch, this->gro ? "on" : "off", segs_per_msg);
+    return 0;
+}
+
+int UdpRxTransport::Recv(char * dst, unsigned int pkt_num)
+{
+    if (pkt_num > batch) pkt_num = batch;
+
+    // 每个 slot 的 payload 区作为一个 iovec；GRO 时一个消息跨多个 slot，
+    // 内核把合并后的数据报依次散布到这些 slot 中
+    unsigned int nmsg = 0;
+    for (unsigned int slot = 0; slot < pkt_num; nmsg++) {
+        unsigned int n = pkt_num - slot < segs_per_msg ? pkt_num - slot : segs_per_msg;
+        for (unsigned int k = 0; k < n; k++) {
+            iovs[slot + k].iov_base = dst + (size_t)(slot + k) * pkt_size + UDP_FRAME_HDR_LEN;
+            iovs[slot + k].iov_len = payload_size;
+        }
+        struct msghdr *hdr = &msgs[nmsg].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_iov = &iovs[slot];
+        hdr->msg_iovlen = n;
+        if (gro) {
+            hdr->msg_control = cmsg_buf + nmsg * CMSG_SPACE(sizeof(int));
+            hdr->msg_controllen = CMSG_SPACE(sizeof(int));
+        }
+        slot += n;
+    }
+
+    int ret = recvmmsg(fd, msgs, nmsg, recv_flags, NULL);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+        perror("[UdpRxTransport] recvmmsg");
+        return -1;
+    }
+
+    unsigned int filled = 0;
+    for (int i = 0; i < ret; i++) {
+        struct msghdr *hdr = &msgs[i].msg_hdr;
+        unsigned int first = (unsigned int)(hdr->msg_iov - iovs);
+        unsigned int len = msgs[i].msg_len;
+        if (hdr->msg_flags & MSG_TRUNC) truncated++;
+        int gso_size = 0;
+        if (gro) {
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(hdr); cm; cm = CMSG_NXTHDR(hdr, cm)) {
+                if (cm->cmsg_level == IPPROTO_UDP && cm->cmsg_type == UDP_GRO) gso_size = *(int *)CMSG_DATA(cm);
+            }
+        }
+        // 段大小与 payload_size 不同时数据报边界和 slot 对不上，整条消息丢弃（按段数计入），不写进 block
+        if (gso_size > 0 && gso_size != (int)payload_size) {
+            gso_dropped += (len + gso_size - 1) / gso_size;
+            continue;
+        }
+        unsigned int used = (len + payload_size - 1) / payload_size;
+        if (used > hdr->msg_iovlen) used = hdr->msg_iovlen;
+        if (used == 0) continue;
+        // 短包：清掉最后一个 slot 的剩余部分
+        if (len < used * payload_size) {
+            unsigned int tail = used * payload_size - len;
+            memset(dst + (size_t)(first + used) * pkt_size - tail, 0, tail);
+        }
+        // GRO 消息未占满预留的 slot 时，把后续数据向前压实
+        if (filled != first) {
+            memmove(dst + (size_t)filled * pkt_size, dst + (size_t)first * pkt_size, (size_t)used * pkt_size);
+        }
+        filled += used;
+    }
+
+    for (unsigned int k = 0; k < filled; k++) {
+        memcpy(dst + (size_t)k * pkt_size, frame_hdr, UDP_FRAME_HDR_LEN);
+    }
+    return (int)filled;
+}
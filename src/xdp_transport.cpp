@@ -0,0 +1,380 @@
+//AF_XDP 接收后端：UMEM 直接取自 PSRDADA ring，帧由内核/网卡写入 ring block
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "xdp_transport.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+#define XDP_PACKET_HEADROOM 256
+#define XDP_MIN_CHUNK_SIZE 2048
+#define XDP_MIN_RING_SIZE 1024
+#define XDP_MAP_ENTRIES 64
+#define XDP_POLL_TIMEOUT_MS 100
+#define XDP_LOG_BUF_SIZE (64 * 1024)
+#define XDP_HUGE_PAGE (2ul << 20)
+
+static long bpf_sys(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static uint32_t round_up_pow2(uint32_t v)
+{
+    uint32_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+XdpRxTransport::XdpRxTransport(): fd(-1), map_fd(-1), prog_fd(-1), link_fd(-1), ifindex(0), queue_id(0),
+    pkt_size(0), batch(0), zero_copy(false), umem(NULL), umem_len(0), umem_owned(false), frame_size(0),
+    ring_size(0), fill_map(NULL), fill_map_len(0), fill_prod(NULL), fill_cons(NULL), fill_flags(NULL), fill_desc(NULL),
+    rx_map(NULL), rx_map_len(0), rx_prod(NULL), rx_cons(NULL), rx_desc(NULL),
+    block_begin(NULL), block_end(NULL), armed_end(NULL), bounce_slot(UINT64_MAX), misplaced(0) {}
+
+XdpRxTransport::~XdpRxTransport()
+{
+    if (fd >= 0) {
+        struct xdp_statistics stats;
+        socklen_t optlen = sizeof(stats);
+        if (getsockopt(fd, SOL_XDP, XDP_STATISTICS, &stats, &optlen) == 0) {
+            printf("[XdpRxTransport] rx_dropped=%llu rx_invalid_descs=%llu rx_ring_full=%llu fill_ring_empty=%llu misplaced=%lu\n",
+                   (unsigned long long)stats.rx_dropped, (unsigned long long)stats.rx_invalid_descs,
+                   (unsigned long long)stats.rx_ring_full, (unsigned long long)stats.rx_fill_ring_empty_descs,
+                   (unsigned long)misplaced);
+        }
+    }
+    if (link_fd >= 0) close(link_fd);  // 关闭 link 即从网卡卸载 XDP 程序
+    if (prog_fd >= 0) close(prog_fd);
+    if (map_fd >= 0) close(map_fd);
+    if (fill_map) munmap(fill_map, fill_map_len);
+    if (rx_map) munmap(rx_map, rx_map_len);
+    if (fd >= 0) close(fd);
+    if (umem && umem_owned) munmap(umem, umem_len);
+}
+
+// 生成并挂载 XDP 程序：匹配 IPv4/UDP 的源/目的 IP 和端口，命中则重定向到 XSKMAP[rx_queue_index]
+int XdpRxTransport::LoadProgram(const struct ibv_pkt_info * pkt_info)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = XDP_MAP_ENTRIES;
+    map_fd = (int)bpf_sys(BPF_MAP_CREATE, &attr);
+    if (map_fd < 0) { perror("[XdpRxTransport] BPF_MAP_CREATE"); return -1; }
+
+#define INSN(c, d, s, o, i) { (uint8_t)(c), (d), (s), (int16_t)(o), (int32_t)(i) }
+#define TO_PASS (-1)   // 跳转目标占位，生成后回填
+    struct bpf_insn prog[] = {
+        INSN(BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0),                          // r6 = ctx
+        INSN(BPF_LDX | BPF_W | BPF_MEM, 2, 1, 0, 0),                            // r2 = ctx->data
+        INSN(BPF_LDX | BPF_W | BPF_MEM, 3, 1, 4, 0),                            // r3 = ctx->data_end
+        INSN(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),
+        INSN(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, 42),
+        INSN(BPF_JMP | BPF_JGT | BPF_X, 4, 3, TO_PASS, 0),                      // 帧短于 Eth+IP+UDP
+        INSN(BPF_LDX | BPF_H | BPF_MEM, 5, 2, 12, 0),
+        INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, TO_PASS, htons(0x0800)),        // ether_type
+        INSN(BPF_LDX | BPF_B | BPF_MEM, 5, 2, 23, 0),
+        INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, TO_PASS, IPPROTO_UDP),          // ip proto
+        INSN(BPF_LDX | BPF_W | BPF_MEM, 5, 2, 26, 0),
+        INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, TO_PASS, pkt_info->src_ip),     // src ip
+        INSN(BPF_LDX | BPF_W | BPF_MEM, 5, 2, 30, 0),
+        INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, TO_PASS, pkt_info->dst_ip),     // dst ip
+        INSN(BPF_LDX | BPF_H | BPF_MEM, 5, 2, 34, 0),
+        INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, TO_PASS, htons(pkt_info->src_port)),
+        INSN(BPF_LDX | BPF_H | BPF_MEM, 5, 2, 36, 0),
+        INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, TO_PASS, htons(pkt_info->dst_port)),
+        INSN(BPF_LDX | BPF_W | BPF_MEM, 2, 6, 16, 0),                           // r2 = ctx->rx_queue_index
+        INSN(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd),       // r1 = xsk map
+        INSN(0, 0, 0, 0, 0),
+        INSN(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS),                   // map 中无 socket 时放行
+        INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        INSN(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS),                   // pass:
+        INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+#undef INSN
+    int ninsn = sizeof(prog) / sizeof(prog[0]);
+    int pass_idx = ninsn - 2;
+    for (int i = 0; i < ninsn; i++) {
+        if ((BPF_CLASS(prog[i].code) == BPF_JMP || BPF_CLASS(prog[i].code) == BPF_JMP32) && prog[i].off == TO_PASS)
+            prog[i].off = (int16_t)(pass_idx - i - 1);
+    }
+#undef TO_PASS
+
+    static char log_buf[XDP_LOG_BUF_SIZE];
+    const char license[] = "GPL";
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t)(unsigned long)prog;
+    attr.insn_cnt = ninsn;
+    attr.license = (uint64_t)(unsigned long)license;
+    attr.log_buf = (uint64_t)(unsigned long)log_buf;
+    attr.log_size = sizeof(log_buf);
+    attr.log_level = 1;
+    prog_fd = (int)bpf_sys(BPF_PROG_LOAD, &attr);
+    if (prog_fd < 0) {
+        perror("[XdpRxTransport] BPF_PROG_LOAD");
+        fprintf(stderr, "%s\n", log_buf);
+        return -2;
+    }
+    return 0;
+}
+
+int XdpRxTransport::Open(const char * ifname, unsigned int queue_id, bool skb_mode,
+                         const struct ibv_pkt_info * pkt_info, unsigned int pkt_size, unsigned int batch,
+                         char * ring_base, uint64_t ring_bytes)
+{
+    if (!ifname || pkt_size == 0 || batch == 0) { ibv_utils_error("Invalid XDP transport parameters."); return -1; }
+    ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) { fprintf(stderr, "[XdpRxTransport] Unknown interface %s\n", ifname); return -1; }
+    this->queue_id = queue_id;
+    this->pkt_size = pkt_size;
+    this->batch = batch;
+    ring_size = round_up_pow2(batch * 2);
+    if (ring_size < XDP_MIN_RING_SIZE) ring_size = XDP_MIN_RING_SIZE;
+
+    struct rlimit rlim = { RLIM_INFINITY, RLIM_INFINITY };
+    setrlimit(RLIMIT_MEMLOCK, &rlim);
+
+    fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (fd < 0) { perror("[XdpRxTransport] socket(AF_XDP)"); return -1; }
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    if (ring_base && ring_bytes) {
+        // 零拷贝：整个 ring 作为 UMEM，fill 地址可以落在任意偏移
+        if (pkt_size + XDP_PACKET_HEADROOM < XDP_MIN_CHUNK_SIZE) {
+            fprintf(stderr, "[XdpRxTransport] pkt_size %u too small for ring UMEM chunks, using internal UMEM\n", pkt_size);
+            ring_base = NULL;
+        }
+    }
+    if (ring_base && ring_bytes) {
+        zero_copy = true;
+        umem = ring_base;
+        umem_len = ring_bytes;
+        frame_size = pkt_size + XDP_PACKET_HEADROOM;
+        reg.flags = XDP_UMEM_UNALIGNED_CHUNK_FLAG;
+        reg.addr = (uint64_t)(unsigned long)umem;
+        reg.len = umem_len;
+        reg.chunk_size = frame_size;
+        if (setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+            // 大于一页的 chunk 要求 UMEM 由 HugeTLB 页支撑（内核 >= 6.6），普通的 SysV ring 不满足，退回内部 UMEM
+            fprintf(stderr, "[XdpRxTransport] ring UMEM rejected (%s, chunk=%u), using internal UMEM\n", strerror(errno), frame_size);
+            zero_copy = false;
+            memset(&reg, 0, sizeof(reg));
+        }
+    }
+    if (!zero_copy) {
+        frame_size = round_up_pow2(pkt_size + XDP_PACKET_HEADROOM);
+        if (frame_size < XDP_MIN_CHUNK_SIZE) frame_size = XDP_MIN_CHUNK_SIZE;
+        umem_len = (uint64_t)frame_size * ring_size;
+        if (frame_size > (uint32_t)getpagesize()) {
+            // chunk 大于一页：内核 6.6 起只接受 HugeTLB 支撑的 UMEM，长度按 2 MB 取整
+            umem_len = (umem_len + XDP_HUGE_PAGE - 1) & ~(XDP_HUGE_PAGE - 1);
+            umem = (char *)mmap(NULL, umem_len, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_HUGETLB, -1, 0);
+            if (umem == MAP_FAILED) {
+                umem = NULL;
+                fprintf(stderr, "[XdpRxTransport] pkt_size %u needs %u-byte UMEM chunks backed by huge pages, but %lu MB of 2 MB pages "
+                        "could not be mapped (%s).\n  Reserve them (e.g. sysctl vm.nr_hugepages=%lu) or use pkt_size <= %u\n",
+                        pkt_size, frame_size, (unsigned long)(umem_len >> 20), strerror(errno),
+                        (unsigned long)(umem_len / XDP_HUGE_PAGE), (unsigned int)getpagesize() - XDP_PACKET_HEADROOM);
+                return -2;
+            }
+        } else {
+            umem = (char *)mmap(NULL, umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            if (umem == MAP_FAILED) { umem = NULL; perror("[XdpRxTransport] mmap umem"); return -2; }
+        }
+        umem_owned = true;
+        reg.addr = (uint64_t)(unsigned long)umem;
+        reg.len = umem_len;
+        reg.chunk_size = frame_size;
+        reg.headroom = 0;
+        if (setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+            perror("[XdpRxTransport] XDP_UMEM_REG");
+            if (frame_size > (uint32_t)getpagesize())
+                fprintf(stderr, "  chunk %u > page size: kernels before 6.6 only accept chunks up to a page, use pkt_size <= %u\n",
+                        frame_size, (unsigned int)getpagesize() - XDP_PACKET_HEADROOM);
+            return -3;
+        }
+    }
+
+    if (setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) < 0 ||
+        setsockopt(fd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) < 0) {
+        perror("[XdpRxTransport] ring setup");
+        return -4;
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) { perror("[XdpRxTransport] XDP_MMAP_OFFSETS"); return -5; }
+    fill_map_len = off.fr.desc + ring_size * sizeof(uint64_t);
+    fill_map = mmap(NULL, fill_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, XDP_UMEM_PGOFF_FILL_RING);
+    if (fill_map == MAP_FAILED) { fill_map = NULL; perror("[XdpRxTransport] mmap fill ring"); return -5; }
+    fill_prod = (uint32_t *)((char *)fill_map + off.fr.producer);
+    fill_cons = (uint32_t *)((char *)fill_map + off.fr.consumer);
+    fill_flags = (uint32_t *)((char *)fill_map + off.fr.flags);
+    fill_desc = (uint64_t *)((char *)fill_map + off.fr.desc);
+    rx_map_len = off.rx.desc + ring_size * sizeof(struct xdp_desc);
+    rx_map = mmap(NULL, rx_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, XDP_PGOFF_RX_RING);
+    if (rx_map == MAP_FAILED) { rx_map = NULL; perror("[XdpRxTransport] mmap rx ring"); return -5; }
+    rx_prod = (uint32_t *)((char *)rx_map + off.rx.producer);
+    rx_cons = (uint32_t *)((char *)rx_map + off.rx.consumer);
+    rx_desc = (struct xdp_desc *)((char *)rx_map + off.rx.desc);
+
+    // 拷贝模式：内部 UMEM 的所有帧先挂到 fill ring
+    if (!zero_copy) {
+        for (uint32_t i = 0; i < ring_size; i++) FillPush((uint64_t)i * frame_size);
+    }
+
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = ifindex;
+    sxdp.sxdp_queue_id = queue_id;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (skb_mode ? XDP_COPY : 0);
+    if (bind(fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) { perror("[XdpRxTransport] bind"); return -6; }
+
+    if (LoadProgram(pkt_info) < 0) return -7;
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    uint32_t key = queue_id;
+    uint32_t value = (uint32_t)fd;
+    attr.map_fd = map_fd;
+    attr.key = (uint64_t)(unsigned long)&key;
+    attr.value = (uint64_t)(unsigned long)&value;
+    if (bpf_sys(BPF_MAP_UPDATE_ELEM, &attr) < 0) { perror("[XdpRxTransport] XSKMAP update"); return -8; }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = skb_mode ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE;
+    link_fd = (int)bpf_sys(BPF_LINK_CREATE, &attr);
+    if (link_fd < 0) { perror("[XdpRxTransport] attach XDP program"); return -9; }
+
+    printf("[XdpRxTransport] %s queue %u attached (%s mode, %s, chunk=%u, ring=%u)\n",
+           ifname, queue_id, skb_mode ? "SKB" : "driver",
+           zero_copy ? "UMEM = PSRDADA ring" : "internal UMEM + copy", frame_size, ring_size);
+    return 0;
+}
+
+int XdpRxTransport::FillPush(uint64_t addr)
+{
+    uint32_t prod = *fill_prod;
+    uint32_t cons = __atomic_load_n(fill_cons, __ATOMIC_ACQUIRE);
+    if (prod - cons >= ring_size) return -1;
+    fill_desc[prod & (ring_size - 1)] = addr;
+    __atomic_store_n(fill_prod, prod + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int XdpRxTransport::BeginBlock(char * block, long int bytes)
+{
+    if (!zero_copy) return 0;
+    if (block < umem || (uint64_t)(block - umem) + (uint64_t)bytes > umem_len || bytes < (long int)pkt_size) {
+        ibv_utils_error("XDP destination outside ring UMEM.");
+        return -1;
+    }
+    block_begin = block;
+    block_end = block + bytes / pkt_size * pkt_size;
+    armed_end = block;
+    return ArmSlots();
+}
+
+// 把 block 中尚未挂载的 slot 依次挂到 fill ring，直到 block 末尾或 fill ring 满。
+// 内核把帧写在 fill 地址 + XDP_PACKET_HEADROOM 处，所以 fill 地址取 slot 前移 headroom；
+// 覆盖的是前一个 slot 尾部，内核不会写 headroom 区域。
+// UMEM 开头的 slot 前面没有 headroom 空间，借用本 block 最后一个 slot 接收，收到后立即拷回。
+// 借出的 slot 在 bounce 帧拷回之前不挂到 fill ring，否则落到它上面的帧会覆盖还没拷走的 bounce 帧。
+int XdpRxTransport::ArmSlots()
+{
+    while (armed_end + pkt_size <= block_end) {
+        uint64_t slot = (uint64_t)(armed_end - umem);
+        uint64_t addr;
+        if (slot == bounce_slot) break;
+        if (slot >= XDP_PACKET_HEADROOM) {
+            addr = slot - XDP_PACKET_HEADROOM;
+        } else {
+            uint64_t bounce = (uint64_t)(block_end - umem) - pkt_size;
+            if (bounce == slot || bounce < XDP_PACKET_HEADROOM) { ibv_utils_error("No room for XDP bounce frame."); return -1; }
+            addr = bounce - XDP_PACKET_HEADROOM;
+        }
+        if (FillPush(addr) < 0) break;
+        if (slot < XDP_PACKET_HEADROOM) bounce_slot = addr + XDP_PACKET_HEADROOM;
+        armed_end += pkt_size;
+    }
+    return 0;
+}
+
+int XdpRxTransport::Recv(char * dst, unsigned int pkt_num)
+{
+    if (pkt_num > batch) pkt_num = batch;
+    if (zero_copy) {
+        // 调用方没有通过 BeginBlock 告知 block 时，按批次挂载
+        if (dst < block_begin || dst + (size_t)pkt_num * pkt_size > block_end) {
+            if (BeginBlock(dst, (long int)pkt_num * pkt_size) < 0) return -1;
+        } else if (ArmSlots() < 0) {
+            return -1;
+        }
+    }
+    if (__atomic_load_n(fill_flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP) {
+        recvfrom(fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    }
+
+    uint32_t cons = *rx_cons;
+    uint32_t avail = __atomic_load_n(rx_prod, __ATOMIC_ACQUIRE) - cons;
+    if (avail == 0) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        poll(&pfd, 1, XDP_POLL_TIMEOUT_MS);
+        return 0;
+    }
+    if (avail > pkt_num) avail = pkt_num;
+
+    bool bounced = false;
+    for (uint32_t i = 0; i < avail; i++) {
+        const struct xdp_desc *desc = &rx_desc[(cons + i) & (ring_size - 1)];
+        uint64_t off = (desc->addr & XSK_UNALIGNED_BUF_ADDR_MASK) + (desc->addr >> XSK_UNALIGNED_BUF_OFFSET_SHIFT);
+        char *frame = umem + off;
+        char *slot = dst + (size_t)i * pkt_size;
+        uint32_t len = desc->len < pkt_size ? desc->len : pkt_size;
+        if (frame != slot) {
+            memcpy(slot, frame, len);
+            if (zero_copy && off == bounce_slot) {
+                bounce_slot = UINT64_MAX;
+                bounced = true;
+            } else if (zero_copy) {
+                misplaced++;
+            }
+        }
+        if (len < pkt_size) memset(slot + len, 0, pkt_size - len);
+        if (!zero_copy) FillPush(off & ~(uint64_t)(frame_size - 1));
+    }
+    __atomic_store_n(rx_cons, cons + avail, __ATOMIC_RELEASE);
+    // bounce 帧已拷回：补挂之前让出的 slot
+    if (bounced && ArmSlots() < 0) return -1;
+    return (int)avail;
+}
@@ -0,0 +1,10 @@
+// test_mock_rx 不链接 psrdada：RdmaParam::Ring 为 NULL，PsrdadaSink 不会被创建，这里只补上它引用的符号
+#include <stddef.h>
+
+#include "psrdada_ringbuf.h"
+
+uint64_t PsrdadaRingBuf::GetBlockSize() { return 0; }
+uint64_t PsrdadaRingBuf::GetFreeSpace() { return 0; }
+uint64_t PsrdadaRingBuf::GetUsedSpace() { return 0; }
+char * PsrdadaRingBuf::GetWriteBuffer(uint64_t) { return NULL; }
+int PsrdadaRingBuf::MarkWritten(uint64_t) { return -1; }